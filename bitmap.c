@@ -0,0 +1,643 @@
+//
+// Created by paul on 10/19/26.
+//
+#include <stdlib.h>
+#include <string.h>
+
+#include "bitmap.h"
+
+#define kArrayMax       4096    /* the most values a chunk holds as an array */
+#define kBitsWords      (65536 / 64)
+
+typedef struct {
+    uint16_t       key;         /* the upper 16 bits of every value in the chunk */
+    bool           isBits;
+    uint32_t       count;       /* number of values in the chunk */
+    uint32_t       capacity;    /* of the array */
+    union {
+        uint16_t * array;       /* sorted, no duplicates */
+        uint64_t * bits;
+    };
+} tContainer;
+
+struct sBitmap {
+    tContainer *   container;   /* sorted by key */
+    uint32_t       count;
+    uint32_t       capacity;
+};
+
+/**
+ * @brief
+ * @return
+ */
+tBitmap * bitmapNew( void )
+{
+    return calloc( 1, sizeof( tBitmap ) );
+}
+
+/**
+ * @brief
+ * @param bitmap
+ */
+void bitmapFree( tBitmap * bitmap )
+{
+    if ( bitmap != NULL )
+    {
+        for ( uint32_t i = 0; i < bitmap->count; ++i )
+        {
+            free( bitmap->container[ i ].array );   /* same pointer as .bits */
+        }
+        free( bitmap->container );
+        free( bitmap );
+    }
+}
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+static inline unsigned int popcount( uint64_t w )
+{
+    return (unsigned int)__builtin_popcountll( w );
+}
+
+/* binary search: the index of the key if present, otherwise where it would be inserted */
+static uint32_t findKey( const tBitmap * bitmap, uint16_t key, bool * found )
+{
+    uint32_t lo = 0;
+    uint32_t hi = bitmap->count;
+
+    while ( lo < hi )
+    {
+        uint32_t mid = (lo + hi) / 2;
+        if ( bitmap->container[ mid ].key < key )
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    *found = lo < bitmap->count && bitmap->container[ lo ].key == key;
+    return lo;
+}
+
+static uint32_t findLow( const uint16_t * array, uint32_t count, uint16_t low, bool * found )
+{
+    uint32_t lo = 0;
+    uint32_t hi = count;
+
+    while ( lo < hi )
+    {
+        uint32_t mid = (lo + hi) / 2;
+        if ( array[ mid ] < low )
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    *found = lo < count && array[ lo ] == low;
+    return lo;
+}
+
+static bool containerContains( const tContainer * c, uint16_t low )
+{
+    bool found;
+
+    if ( c->isBits )
+    {
+        return ( c->bits[ low >> 6 ] >> (low & 63) ) & 1;
+    }
+    findLow( c->array, c->count, low, &found );
+    return found;
+}
+
+static bool toBits( tContainer * c )
+{
+    uint64_t * bits = calloc( kBitsWords, sizeof( uint64_t ) );
+
+    if ( bits == NULL )
+    {
+        return false;
+    }
+    for ( uint32_t i = 0; i < c->count; ++i )
+    {
+        bits[ c->array[ i ] >> 6 ] |= 1ULL << (c->array[ i ] & 63);
+    }
+    free( c->array );
+    c->bits     = bits;
+    c->isBits   = true;
+    c->capacity = 0;
+    return true;
+}
+
+/* a bitset that's become sparse enough goes back to being an array */
+static bool normalize( tContainer * c )
+{
+    if ( c->isBits && c->count <= kArrayMax )
+    {
+        uint16_t * array = malloc( ( c->count ? c->count : 1 ) * sizeof( uint16_t ) );
+        uint32_t   n     = 0;
+
+        if ( array == NULL )
+        {
+            return false;
+        }
+        for ( uint32_t w = 0; w < kBitsWords; ++w )
+        {
+            for ( uint64_t word = c->bits[ w ]; word != 0; word &= word - 1 )
+            {
+                array[ n++ ] = (uint16_t)( w * 64 + __builtin_ctzll( word ) );
+            }
+        }
+        free( c->bits );
+        c->array    = array;
+        c->isBits   = false;
+        c->capacity = c->count ? c->count : 1;
+    }
+    return true;
+}
+
+static bool containerAdd( tContainer * c, uint16_t low )
+{
+    if ( c->isBits )
+    {
+        uint64_t bit = 1ULL << (low & 63);
+        c->count += ( c->bits[ low >> 6 ] & bit ) == 0;
+        c->bits[ low >> 6 ] |= bit;
+        return true;
+    }
+
+    bool     found;
+    uint32_t pos = ( c->count == 0 || c->array[ c->count - 1 ] < low )
+                   ? c->count      /* the usual case: values added in order */
+                   : findLow( c->array, c->count, low, &found );
+
+    if ( pos < c->count && c->array[ pos ] == low )
+    {
+        return true;
+    }
+    if ( c->count == kArrayMax )
+    {
+        return toBits( c ) && containerAdd( c, low );
+    }
+    if ( c->count == c->capacity )
+    {
+        uint32_t   capacity = c->capacity ? c->capacity * 2 : 4;
+        uint16_t * array;
+
+        if ( capacity > kArrayMax ) capacity = kArrayMax;
+        array = realloc( c->array, capacity * sizeof( uint16_t ) );
+        if ( array == NULL )
+        {
+            return false;
+        }
+        c->array    = array;
+        c->capacity = capacity;
+    }
+    memmove( &c->array[ pos + 1 ], &c->array[ pos ], (c->count - pos) * sizeof( uint16_t ) );
+    c->array[ pos ] = low;
+    c->count++;
+    return true;
+}
+
+/* add a container to the end of the bitmap, taking ownership of its storage */
+static bool appendContainer( tBitmap * bitmap, tContainer * c )
+{
+    if ( c->count == 0 )
+    {
+        free( c->array );
+        return true;
+    }
+    if ( bitmap->count == bitmap->capacity )
+    {
+        uint32_t     capacity  = bitmap->capacity ? bitmap->capacity * 2 : 4;
+        tContainer * container = realloc( bitmap->container, capacity * sizeof( tContainer ) );
+        if ( container == NULL )
+        {
+            free( c->array );
+            return false;
+        }
+        bitmap->container = container;
+        bitmap->capacity  = capacity;
+    }
+    bitmap->container[ bitmap->count++ ] = *c;
+    return true;
+}
+
+/**
+ * @brief
+ * @param bitmap
+ * @param value
+ * @return false if out of memory
+ */
+bool bitmapAdd( tBitmap * bitmap, uint32_t value )
+{
+    uint16_t key = (uint16_t)( value >> 16 );
+    bool     found;
+    uint32_t pos;
+
+    /* the usual case: values added in order */
+    if ( bitmap->count > 0 && bitmap->container[ bitmap->count - 1 ].key == key )
+    {
+        return containerAdd( &bitmap->container[ bitmap->count - 1 ], (uint16_t)value );
+    }
+
+    pos = findKey( bitmap, key, &found );
+    if ( ! found )
+    {
+        tContainer c;
+        memset( &c, 0, sizeof( c ) );
+        c.key = key;
+        if ( ! containerAdd( &c, (uint16_t)value ) || ! appendContainer( bitmap, &c ) )
+        {
+            return false;
+        }
+        /* move it from the end to where it belongs */
+        c = bitmap->container[ bitmap->count - 1 ];
+        memmove( &bitmap->container[ pos + 1 ], &bitmap->container[ pos ],
+                 (bitmap->count - 1 - pos) * sizeof( tContainer ) );
+        bitmap->container[ pos ] = c;
+        return true;
+    }
+    return containerAdd( &bitmap->container[ pos ], (uint16_t)value );
+}
+
+/**
+ * @brief
+ * @param bitmap
+ * @param value
+ * @return
+ */
+bool bitmapContains( const tBitmap * bitmap, uint32_t value )
+{
+    bool     found;
+    uint32_t pos = findKey( bitmap, (uint16_t)( value >> 16 ), &found );
+
+    return found && containerContains( &bitmap->container[ pos ], (uint16_t)value );
+}
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+static bool copyContainer( const tContainer * c, tContainer * out )
+{
+    size_t size = c->isBits ? kBitsWords * sizeof( uint64_t ) : c->count * sizeof( uint16_t );
+
+    *out = *c;
+    out->array = malloc( size ? size : 1 );
+    if ( out->array == NULL )
+    {
+        return false;
+    }
+    memcpy( out->array, c->array, size );
+    if ( ! c->isBits )
+    {
+        out->capacity = c->count;
+    }
+    return true;
+}
+
+/* the container as a bitset, copying it if need be */
+static uint64_t * bitsOf( const tContainer * c )
+{
+    uint64_t * bits = calloc( kBitsWords, sizeof( uint64_t ) );
+
+    if ( bits != NULL )
+    {
+        if ( c->isBits )
+        {
+            memcpy( bits, c->bits, kBitsWords * sizeof( uint64_t ) );
+        }
+        else
+        {
+            for ( uint32_t i = 0; i < c->count; ++i )
+            {
+                bits[ c->array[ i ] >> 6 ] |= 1ULL << (c->array[ i ] & 63);
+            }
+        }
+    }
+    return bits;
+}
+
+static bool newArray( tContainer * out, uint16_t key, uint32_t capacity )
+{
+    memset( out, 0, sizeof( tContainer ) );
+    out->key      = key;
+    out->capacity = capacity ? capacity : 1;
+    out->array    = malloc( out->capacity * sizeof( uint16_t ) );
+    return out->array != NULL;
+}
+
+static bool andContainers( const tContainer * a, const tContainer * b, tContainer * out )
+{
+    if ( a->isBits && b->isBits )
+    {
+        memset( out, 0, sizeof( tContainer ) );
+        out->key    = a->key;
+        out->isBits = true;
+        out->bits   = malloc( kBitsWords * sizeof( uint64_t ) );
+        if ( out->bits == NULL )
+        {
+            return false;
+        }
+        for ( uint32_t w = 0; w < kBitsWords; ++w )
+        {
+            out->bits[ w ] = a->bits[ w ] & b->bits[ w ];
+            out->count    += popcount( out->bits[ w ] );
+        }
+        return normalize( out );
+    }
+    if ( a->isBits )
+    {
+        const tContainer * t = a; a = b; b = t;     /* so 'a' is the array */
+    }
+    if ( ! newArray( out, a->key, a->count ) )
+    {
+        return false;
+    }
+    if ( b->isBits )
+    {
+        for ( uint32_t i = 0; i < a->count; ++i )
+        {
+            out->array[ out->count ] = a->array[ i ];
+            out->count += ( b->bits[ a->array[ i ] >> 6 ] >> (a->array[ i ] & 63) ) & 1;
+        }
+    }
+    else
+    {
+        uint32_t i = 0, j = 0;
+        while ( i < a->count && j < b->count )
+        {
+            uint16_t x = a->array[ i ];
+            uint16_t y = b->array[ j ];
+            if ( x == y )
+            {
+                out->array[ out->count++ ] = x;
+            }
+            i += ( x <= y );
+            j += ( y <= x );
+        }
+    }
+    return true;
+}
+
+static bool orContainers( const tContainer * a, const tContainer * b, tContainer * out )
+{
+    if ( ! a->isBits && ! b->isBits && a->count + b->count <= kArrayMax )
+    {
+        uint32_t i = 0, j = 0;
+
+        if ( ! newArray( out, a->key, a->count + b->count ) )
+        {
+            return false;
+        }
+        while ( i < a->count || j < b->count )
+        {
+            if ( j == b->count || ( i < a->count && a->array[ i ] < b->array[ j ] ) )
+            {
+                out->array[ out->count++ ] = a->array[ i++ ];
+            }
+            else if ( i == a->count || b->array[ j ] < a->array[ i ] )
+            {
+                out->array[ out->count++ ] = b->array[ j++ ];
+            }
+            else
+            {
+                out->array[ out->count++ ] = a->array[ i++ ];
+                j++;
+            }
+        }
+        return true;
+    }
+
+    memset( out, 0, sizeof( tContainer ) );
+    out->key    = a->key;
+    out->isBits = true;
+    out->bits   = bitsOf( a );
+    if ( out->bits == NULL )
+    {
+        return false;
+    }
+    if ( b->isBits )
+    {
+        for ( uint32_t w = 0; w < kBitsWords; ++w )
+        {
+            out->bits[ w ] |= b->bits[ w ];
+        }
+    }
+    else
+    {
+        for ( uint32_t i = 0; i < b->count; ++i )
+        {
+            out->bits[ b->array[ i ] >> 6 ] |= 1ULL << (b->array[ i ] & 63);
+        }
+    }
+    for ( uint32_t w = 0; w < kBitsWords; ++w )
+    {
+        out->count += popcount( out->bits[ w ] );
+    }
+    return normalize( out );
+}
+
+static bool andNotContainers( const tContainer * a, const tContainer * b, tContainer * out )
+{
+    if ( ! a->isBits )
+    {
+        if ( ! newArray( out, a->key, a->count ) )
+        {
+            return false;
+        }
+        for ( uint32_t i = 0; i < a->count; ++i )
+        {
+            out->array[ out->count ] = a->array[ i ];
+            out->count += ! containerContains( b, a->array[ i ] );
+        }
+        return true;
+    }
+
+    if ( ! copyContainer( a, out ) )
+    {
+        return false;
+    }
+    if ( b->isBits )
+    {
+        for ( uint32_t w = 0; w < kBitsWords; ++w )
+        {
+            out->bits[ w ] &= ~b->bits[ w ];
+        }
+    }
+    else
+    {
+        for ( uint32_t i = 0; i < b->count; ++i )
+        {
+            out->bits[ b->array[ i ] >> 6 ] &= ~( 1ULL << (b->array[ i ] & 63) );
+        }
+    }
+    out->count = 0;
+    for ( uint32_t w = 0; w < kBitsWords; ++w )
+    {
+        out->count += popcount( out->bits[ w ] );
+    }
+    return normalize( out );
+}
+
+typedef enum { kOpAnd, kOpOr, kOpAndNot } tBitmapOp;
+
+static tBitmap * combine( const tBitmap * left, const tBitmap * right, tBitmapOp op )
+{
+    tBitmap * result = bitmapNew();
+    uint32_t  i = 0, j = 0;
+    bool      ok = ( result != NULL );
+
+    while ( ok && ( i < left->count || ( op == kOpOr && j < right->count ) ) )
+    {
+        const tContainer * a = i < left->count  ? &left->container[ i ]  : NULL;
+        const tContainer * b = j < right->count ? &right->container[ j ] : NULL;
+        tContainer         out;
+
+        if ( b == NULL || ( a != NULL && a->key < b->key ) )
+        {
+            /* only in the left */
+            ++i;
+            if ( op != kOpAnd )
+            {
+                ok = copyContainer( a, &out ) && appendContainer( result, &out );
+            }
+        }
+        else if ( a == NULL || b->key < a->key )
+        {
+            /* only in the right */
+            ++j;
+            if ( op == kOpOr )
+            {
+                ok = copyContainer( b, &out ) && appendContainer( result, &out );
+            }
+        }
+        else
+        {
+            ++i;
+            ++j;
+            switch ( op )
+            {
+            case kOpAnd:    ok = andContainers( a, b, &out );    break;
+            case kOpOr:     ok = orContainers( a, b, &out );     break;
+            case kOpAndNot: ok = andNotContainers( a, b, &out ); break;
+            }
+            ok = ok && appendContainer( result, &out );
+        }
+    }
+
+    if ( ! ok )
+    {
+        bitmapFree( result );
+        return NULL;
+    }
+    return result;
+}
+
+/**
+ * @brief
+ * @param left
+ * @param right
+ * @return a new bitmap of the values in both, or NULL if out of memory
+ */
+tBitmap * bitmapAnd( const tBitmap * left, const tBitmap * right )
+{
+    return combine( left, right, kOpAnd );
+}
+
+/**
+ * @brief
+ * @param left
+ * @param right
+ * @return a new bitmap of the values in either, or NULL if out of memory
+ */
+tBitmap * bitmapOr( const tBitmap * left, const tBitmap * right )
+{
+    return combine( left, right, kOpOr );
+}
+
+/**
+ * @brief
+ * @param left
+ * @param right
+ * @return a new bitmap of the values in the left but not the right, or NULL if out of memory
+ */
+tBitmap * bitmapAndNot( const tBitmap * left, const tBitmap * right )
+{
+    return combine( left, right, kOpAndNot );
+}
+
+/**
+ * @brief
+ * @param bitmap
+ * @return the number of values in the bitmap
+ */
+size_t bitmapCardinality( const tBitmap * bitmap )
+{
+    size_t count = 0;
+
+    for ( uint32_t i = 0; i < bitmap->count; ++i )
+    {
+        count += bitmap->container[ i ].count;
+    }
+    return count;
+}
+
+/**
+ * @brief
+ * @param bitmap
+ * @return roughly how much memory the bitmap occupies
+ */
+size_t bitmapBytes( const tBitmap * bitmap )
+{
+    size_t bytes = sizeof( tBitmap ) + bitmap->capacity * sizeof( tContainer );
+
+    for ( uint32_t i = 0; i < bitmap->count; ++i )
+    {
+        const tContainer * c = &bitmap->container[ i ];
+        bytes += c->isBits ? kBitsWords * sizeof( uint64_t ) : c->capacity * sizeof( uint16_t );
+    }
+    return bytes;
+}
+
+/**
+ * @brief visit every value in the bitmap, in ascending order
+ * @param bitmap
+ * @param iter      return false to stop early
+ * @param udata
+ */
+void bitmapForEach( const tBitmap * bitmap, tBitmapIter iter, void * udata )
+{
+    for ( uint32_t i = 0; i < bitmap->count; ++i )
+    {
+        const tContainer * c    = &bitmap->container[ i ];
+        uint32_t           high = (uint32_t)c->key << 16;
+
+        if ( c->isBits )
+        {
+            for ( uint32_t w = 0; w < kBitsWords; ++w )
+            {
+                for ( uint64_t word = c->bits[ w ]; word != 0; word &= word - 1 )
+                {
+                    if ( ! iter( high | ( w * 64 + __builtin_ctzll( word ) ), udata ) )
+                    {
+                        return;
+                    }
+                }
+            }
+        }
+        else
+        {
+            for ( uint32_t v = 0; v < c->count; ++v )
+            {
+                if ( ! iter( high | c->array[ v ], udata ) )
+                {
+                    return;
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,39 @@
+//
+// Created by paul on 10/19/26.
+//
+
+#ifndef MUNGEM3U_BITMAP_H
+#define MUNGEM3U_BITMAP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Compressed bitmaps of 32-bit values, in the style of Roaring bitmaps. The
+ * values are split into chunks of 65536 by their upper 16 bits, and each
+ * chunk is stored whichever way is smaller: as a sorted array of the lower
+ * 16 bits while it has no more than 4096 values, otherwise as a bitset of
+ * 65536 bits. Intersections, unions and differences work a chunk at a time,
+ * so sparse and dense posting lists both combine quickly.
+ */
+
+typedef struct sBitmap tBitmap;
+
+typedef bool (*tBitmapIter)( uint32_t value, void * udata );
+
+tBitmap * bitmapNew( void );
+void bitmapFree( tBitmap * bitmap );
+
+bool bitmapAdd( tBitmap * bitmap, uint32_t value );
+bool bitmapContains( const tBitmap * bitmap, uint32_t value );
+
+tBitmap * bitmapAnd( const tBitmap * left, const tBitmap * right );
+tBitmap * bitmapOr( const tBitmap * left, const tBitmap * right );
+tBitmap * bitmapAndNot( const tBitmap * left, const tBitmap * right );
+
+size_t bitmapCardinality( const tBitmap * bitmap );
+size_t bitmapBytes( const tBitmap * bitmap );
+void bitmapForEach( const tBitmap * bitmap, tBitmapIter iter, void * udata );
+
+#endif //MUNGEM3U_BITMAP_H
@@ -0,0 +1,271 @@
+//
+// Created by paul on 10/19/26.
+//
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_AVX2_KERNEL 1
+#endif
+
+#include "catalog.h"
+
+/**
+ * @brief allocate the columns for 'count' rows, zeroing any padding at the end
+ * @param catalog
+ * @param count
+ * @return false if out of memory
+ */
+bool catalogInit( tCatalog * catalog, size_t count )
+{
+    memset( catalog, 0, sizeof( tCatalog ) );
+
+    catalog->count    = count;
+    catalog->capacity = (count + 31) & ~(size_t)31;
+
+    size_t capacity = catalog->capacity ? catalog->capacity : 32;
+
+    catalog->country    = aligned_alloc( 32, capacity );
+    catalog->genre      = aligned_alloc( 32, capacity );
+    catalog->language   = aligned_alloc( 32, capacity );
+    catalog->resolution = aligned_alloc( 32, capacity );
+    catalog->city       = aligned_alloc( 32, capacity );
+    catalog->type       = aligned_alloc( 32, capacity );
+    catalog->flags      = aligned_alloc( 32, capacity );
+    catalog->station    = aligned_alloc( 32, capacity * sizeof( uint16_t ) );
+
+    if ( catalog->country == NULL || catalog->genre == NULL || catalog->language == NULL
+      || catalog->resolution == NULL || catalog->city == NULL || catalog->type == NULL
+      || catalog->flags == NULL || catalog->station == NULL )
+    {
+        catalogFree( catalog );
+        return false;
+    }
+
+    size_t pad = capacity - count;
+    memset( catalog->country    + count, 0, pad );
+    memset( catalog->genre      + count, 0, pad );
+    memset( catalog->language   + count, 0, pad );
+    memset( catalog->resolution + count, 0, pad );
+    memset( catalog->city       + count, 0, pad );
+    memset( catalog->type       + count, 0, pad );
+    memset( catalog->flags      + count, 0, pad );
+    memset( catalog->station    + count, 0, pad * sizeof( uint16_t ) );
+
+    return true;
+}
+
+/**
+ * @brief
+ * @param catalog
+ */
+void catalogFree( tCatalog * catalog )
+{
+    free( catalog->country );
+    free( catalog->genre );
+    free( catalog->language );
+    free( catalog->resolution );
+    free( catalog->city );
+    free( catalog->type );
+    free( catalog->flags );
+    free( catalog->station );
+    memset( catalog, 0, sizeof( tCatalog ) );
+}
+
+static inline bool rowRejected( const tCatalog * catalog, const tFilterPolicy * policy, size_t row )
+{
+    uint8_t genre   = catalog->genre[ row ];
+    uint8_t country = catalog->country[ row ];
+
+    if ( genre < 16 && (policy->rejectGenres & (1u << genre)) != 0 )        return true;
+    if ( (catalog->flags[ row ] & policy->rejectFlags) != 0 )               return true;
+    if ( policy->language != 0 && catalog->language[ row ] != policy->language ) return true;
+    if ( policy->rejectResolution != 0 && catalog->resolution[ row ] == policy->rejectResolution ) return true;
+    if ( catalog->resolution[ row ] < policy->minResolution )              return true;
+    if ( policy->linearOnly && catalog->type[ row ] != 0 )                  return true;
+
+    if ( policy->keepCountryCount > 0 )
+    {
+        bool keep = false;
+        for ( unsigned int i = 0; i < policy->keepCountryCount; ++i )
+        {
+            keep |= ( country == policy->keepCountry[ i ] );
+        }
+        if ( ! keep ) return true;
+    }
+
+    if ( policy->keepGenreCount > 0 )
+    {
+        bool keep = false;
+        for ( unsigned int i = 0; i < policy->keepGenreCount; ++i )
+        {
+            keep |= ( genre == policy->keepGenre[ i ] );
+        }
+        if ( ! keep ) return true;
+    }
+
+    if ( policy->localGenre != 0 && genre == policy->localGenre )
+    {
+        bool keep = false;
+        for ( unsigned int i = 0; i < policy->keepLocalCount; ++i )
+        {
+            keep |= ( country == policy->keepLocal[ i ].country
+                      && ( policy->keepLocal[ i ].city == 0 || catalog->city[ row ] == policy->keepLocal[ i ].city ) );
+        }
+        if ( ! keep ) return true;
+    }
+
+    return false;
+}
+
+/**
+ * @brief reference implementation of the filter kernel, one row at a time
+ * @param catalog
+ * @param policy
+ * @param selection  receives the row numbers that passed; must have room for catalog->count entries
+ * @return the number of rows selected
+ */
+size_t catalogFilterScalar( const tCatalog * catalog, const tFilterPolicy * policy, uint32_t * selection )
+{
+    size_t selected = 0;
+
+    for ( size_t row = 0; row < catalog->count; ++row )
+    {
+        if ( ! rowRejected( catalog, policy, row ) )
+        {
+            selection[ selected++ ] = (uint32_t)row;
+        }
+    }
+    return selected;
+}
+
+#ifdef HAVE_AVX2_KERNEL
+
+__attribute__(( target( "avx2" ) ))
+static size_t catalogFilterAVX2( const tCatalog * catalog, const tFilterPolicy * policy, uint32_t * selection )
+{
+    size_t  selected = 0;
+    __m256i zero     = _mm256_setzero_si256();
+    __m256i ones     = _mm256_set1_epi8( -1 );
+
+    /* a byte per genre 0..15 - all ones if that genre is rejected - for use with vpshufb */
+    uint8_t genreTable[ 16 ];
+    for ( unsigned int i = 0; i < 16; ++i )
+    {
+        genreTable[ i ] = ( policy->rejectGenres & (1u << i) ) ? 0xFF : 0x00;
+    }
+    __m256i genreLUT = _mm256_broadcastsi128_si256( _mm_loadu_si128( (const __m128i *)genreTable ) );
+    __m256i highNibble = _mm256_set1_epi8( (char)0xF0 );
+
+    __m256i rejectFlags = _mm256_set1_epi8( (char)policy->rejectFlags );
+    __m256i language    = _mm256_set1_epi8( (char)policy->language );
+    __m256i resolution  = _mm256_set1_epi8( (char)policy->rejectResolution );
+    __m256i minResolution = _mm256_set1_epi8( (char)policy->minResolution );
+    __m256i localGenre  = _mm256_set1_epi8( (char)policy->localGenre );
+
+    for ( size_t row = 0; row < catalog->count; row += 32 )
+    {
+        __m256i genre   = _mm256_load_si256( (const __m256i *)( catalog->genre   + row ) );
+        __m256i country = _mm256_load_si256( (const __m256i *)( catalog->country + row ) );
+        __m256i flags   = _mm256_load_si256( (const __m256i *)( catalog->flags   + row ) );
+
+        /* genres past 15 can't be in the table, so are never rejected by it */
+        __m256i small  = _mm256_cmpeq_epi8( _mm256_and_si256( genre, highNibble ), zero );
+        __m256i reject = _mm256_and_si256( small, _mm256_shuffle_epi8( genreLUT, genre ) );
+
+        reject = _mm256_or_si256( reject,
+                     _mm256_andnot_si256( _mm256_cmpeq_epi8( _mm256_and_si256( flags, rejectFlags ), zero ), ones ) );
+
+        if ( policy->language != 0 )
+        {
+            __m256i lang = _mm256_load_si256( (const __m256i *)( catalog->language + row ) );
+            reject = _mm256_or_si256( reject, _mm256_andnot_si256( _mm256_cmpeq_epi8( lang, language ), ones ) );
+        }
+        if ( policy->rejectResolution != 0 )
+        {
+            __m256i res = _mm256_load_si256( (const __m256i *)( catalog->resolution + row ) );
+            reject = _mm256_or_si256( reject, _mm256_cmpeq_epi8( res, resolution ) );
+        }
+        if ( policy->minResolution != 0 )
+        {
+            /* there's no unsigned byte compare: res >= min exactly when max( res, min ) == res */
+            __m256i res = _mm256_load_si256( (const __m256i *)( catalog->resolution + row ) );
+            reject = _mm256_or_si256( reject,
+                         _mm256_andnot_si256( _mm256_cmpeq_epi8( _mm256_max_epu8( res, minResolution ), res ), ones ) );
+        }
+        if ( policy->linearOnly )
+        {
+            __m256i type = _mm256_load_si256( (const __m256i *)( catalog->type + row ) );
+            reject = _mm256_or_si256( reject, _mm256_andnot_si256( _mm256_cmpeq_epi8( type, zero ), ones ) );
+        }
+        if ( policy->keepCountryCount > 0 )
+        {
+            __m256i keep = zero;
+            for ( unsigned int i = 0; i < policy->keepCountryCount; ++i )
+            {
+                keep = _mm256_or_si256( keep, _mm256_cmpeq_epi8( country, _mm256_set1_epi8( (char)policy->keepCountry[ i ] ) ) );
+            }
+            reject = _mm256_or_si256( reject, _mm256_andnot_si256( keep, ones ) );
+        }
+        if ( policy->keepGenreCount > 0 )
+        {
+            __m256i keep = zero;
+            for ( unsigned int i = 0; i < policy->keepGenreCount; ++i )
+            {
+                keep = _mm256_or_si256( keep, _mm256_cmpeq_epi8( genre, _mm256_set1_epi8( (char)policy->keepGenre[ i ] ) ) );
+            }
+            reject = _mm256_or_si256( reject, _mm256_andnot_si256( keep, ones ) );
+        }
+        if ( policy->localGenre != 0 )
+        {
+            __m256i city = _mm256_load_si256( (const __m256i *)( catalog->city + row ) );
+            __m256i keep = zero;
+            for ( unsigned int i = 0; i < policy->keepLocalCount; ++i )
+            {
+                __m256i match = _mm256_cmpeq_epi8( country, _mm256_set1_epi8( (char)policy->keepLocal[ i ].country ) );
+                if ( policy->keepLocal[ i ].city != 0 )
+                {
+                    match = _mm256_and_si256( match, _mm256_cmpeq_epi8( city, _mm256_set1_epi8( (char)policy->keepLocal[ i ].city ) ) );
+                }
+                keep = _mm256_or_si256( keep, match );
+            }
+            __m256i isLocal = _mm256_cmpeq_epi8( genre, localGenre );
+            reject = _mm256_or_si256( reject, _mm256_andnot_si256( keep, isLocal ) );
+        }
+
+        uint32_t pass = ~(uint32_t)_mm256_movemask_epi8( reject );
+        if ( catalog->count - row < 32 )
+        {
+            /* ignore the padding past the last row */
+            pass &= (1u << (catalog->count - row)) - 1;
+        }
+        /* turn the bitmask into row numbers */
+        while ( pass != 0 )
+        {
+            selection[ selected++ ] = (uint32_t)( row + __builtin_ctz( pass ) );
+            pass &= pass - 1;
+        }
+    }
+    return selected;
+}
+
+#endif
+
+/**
+ * @brief apply the policy to every row in the catalog, using AVX2 if the CPU has it
+ * @param catalog
+ * @param policy
+ * @param selection  receives the row numbers that passed, in order; must have room for catalog->count entries
+ * @return the number of rows selected
+ */
+size_t catalogFilter( const tCatalog * catalog, const tFilterPolicy * policy, uint32_t * selection )
+{
+#ifdef HAVE_AVX2_KERNEL
+    if ( __builtin_cpu_supports( "avx2" ) )
+    {
+        return catalogFilterAVX2( catalog, policy, selection );
+    }
+#endif
+    return catalogFilterScalar( catalog, policy, selection );
+}
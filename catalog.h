@@ -0,0 +1,71 @@
+//
+// Created by paul on 10/19/26.
+//
+
+#ifndef MUNGEM3U_CATALOG_H
+#define MUNGEM3U_CATALOG_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * A columnar ('structure of arrays') copy of the channel attributes that the
+ * filtering policy looks at - one contiguous array per attribute, indexed by
+ * row - so a policy can be evaluated 32 channels at a time with AVX2.
+ */
+
+#define kCatalogFlagPlus1       0x01
+#define kCatalogFlagVIP         0x02
+#define kCatalogFlagNoStream    0x04    /* no stream, or the preferred stream is a file */
+#define kCatalogFlagGroupOff    0x08    /* the channel's group has been disabled */
+
+typedef struct {
+    size_t      count;
+    size_t      capacity;       /* always a multiple of 32, so the kernel never reads past the end */
+
+    uint8_t *   country;
+    uint8_t *   genre;
+    uint8_t *   language;
+    uint8_t *   resolution;     /* of the preferred stream */
+    uint8_t *   city;
+    uint8_t *   type;
+    uint8_t *   flags;
+    uint16_t *  station;        /* US callsign index */
+} tCatalog;
+
+#define kPolicyMaxValues    8
+
+/*
+ * A filtering policy, reduced to tests that can be evaluated without branching.
+ * A row is kept only if it passes every test.
+ */
+typedef struct {
+    uint16_t    rejectGenres;       /* bit n set: reject genre n (genres 0 to 15) */
+    uint8_t     rejectFlags;        /* reject if any of these flags are set */
+    uint8_t     language;           /* keep only this language (0: any) */
+    uint8_t     rejectResolution;   /* reject this resolution (0: none) */
+    uint8_t     minResolution;      /* reject any resolution lower than this (0: none) */
+    bool        linearOnly;         /* reject any type other than 0 (linear) */
+
+    unsigned int keepCountryCount;  /* keep only these countries (0: any) */
+    uint8_t     keepCountry[ kPolicyMaxValues ];
+
+    unsigned int keepGenreCount;    /* keep only these genres (0: any) */
+    uint8_t     keepGenre[ kPolicyMaxValues ];
+
+    uint8_t     localGenre;         /* the genre the local rules apply to (0: none) */
+    unsigned int keepLocalCount;    /* ...which keeps only these countries/cities */
+    struct {
+        uint8_t country;
+        uint8_t city;               /* 0: any city in the country */
+    } keepLocal[ kPolicyMaxValues ];
+} tFilterPolicy;
+
+bool catalogInit( tCatalog * catalog, size_t count );
+void catalogFree( tCatalog * catalog );
+
+size_t catalogFilter( const tCatalog * catalog, const tFilterPolicy * policy, uint32_t * selection );
+size_t catalogFilterScalar( const tCatalog * catalog, const tFilterPolicy * policy, uint32_t * selection );
+
+#endif //MUNGEM3U_CATALOG_H
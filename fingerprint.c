@@ -0,0 +1,111 @@
+//
+// Created by paul on 10/19/26.
+//
+#include <string.h>
+
+#include "fingerprint.h"
+
+#define kPrime1     0x9E3779B185EBCA87ULL
+#define kPrime2     0xC2B2AE3D27D4EB4FULL
+#define kPrime3     0x165667B19E3779F9ULL
+#define kPrime4     0x85EBCA77C2B2AE63ULL
+#define kPrime5     0x27D4EB2F165667C5ULL
+
+static inline uint64_t rotl64( uint64_t x, unsigned int r )
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+/* little-endian loads, whatever the host */
+static inline uint64_t read64( const uint8_t * p )
+{
+    return  (uint64_t)p[0]        | (uint64_t)p[1] << 8  | (uint64_t)p[2] << 16 | (uint64_t)p[3] << 24
+          | (uint64_t)p[4] << 32  | (uint64_t)p[5] << 40 | (uint64_t)p[6] << 48 | (uint64_t)p[7] << 56;
+}
+
+static inline uint32_t read32( const uint8_t * p )
+{
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static inline uint64_t round64( uint64_t acc, uint64_t input )
+{
+    acc += input * kPrime2;
+    acc  = rotl64( acc, 31 );
+    return acc * kPrime1;
+}
+
+static inline uint64_t mergeRound( uint64_t acc, uint64_t value )
+{
+    acc ^= round64( 0, value );
+    return acc * kPrime1 + kPrime4;
+}
+
+/**
+ * @brief XXH64 of a block of memory
+ * @param data
+ * @param length
+ * @param seed
+ * @return
+ */
+tFingerprint fingerprint( const void * data, size_t length, uint64_t seed )
+{
+    const uint8_t * p   = data;
+    const uint8_t * end = p + length;
+    uint64_t        h;
+
+    if ( length >= 32 )
+    {
+        uint64_t v1 = seed + kPrime1 + kPrime2;
+        uint64_t v2 = seed + kPrime2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - kPrime1;
+
+        do {
+            v1 = round64( v1, read64( p ) );      p += 8;
+            v2 = round64( v2, read64( p ) );      p += 8;
+            v3 = round64( v3, read64( p ) );      p += 8;
+            v4 = round64( v4, read64( p ) );      p += 8;
+        } while ( p <= end - 32 );
+
+        h = rotl64( v1, 1 ) + rotl64( v2, 7 ) + rotl64( v3, 12 ) + rotl64( v4, 18 );
+        h = mergeRound( h, v1 );
+        h = mergeRound( h, v2 );
+        h = mergeRound( h, v3 );
+        h = mergeRound( h, v4 );
+    }
+    else
+    {
+        h = seed + kPrime5;
+    }
+
+    h += (uint64_t)length;
+
+    while ( p + 8 <= end )
+    {
+        h ^= round64( 0, read64( p ) );
+        h  = rotl64( h, 27 ) * kPrime1 + kPrime4;
+        p += 8;
+    }
+    if ( p + 4 <= end )
+    {
+        h ^= (uint64_t)read32( p ) * kPrime1;
+        h  = rotl64( h, 23 ) * kPrime2 + kPrime3;
+        p += 4;
+    }
+    while ( p < end )
+    {
+        h ^= (uint64_t)*p * kPrime5;
+        h  = rotl64( h, 11 ) * kPrime1;
+        p++;
+    }
+
+    /* avalanche */
+    h ^= h >> 33;
+    h *= kPrime2;
+    h ^= h >> 29;
+    h *= kPrime3;
+    h ^= h >> 32;
+
+    return h;
+}
@@ -0,0 +1,21 @@
+//
+// Created by paul on 10/19/26.
+//
+
+#ifndef MUNGEM3U_FINGERPRINT_H
+#define MUNGEM3U_FINGERPRINT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Stable 64-bit fingerprints. The algorithm is XXH64, so a fingerprint only
+ * depends on the bytes hashed, and is the same from run to run and machine
+ * to machine - it can be saved and compared later.
+ */
+
+typedef uint64_t tFingerprint;
+
+tFingerprint fingerprint( const void * data, size_t length, uint64_t seed );
+
+#endif //MUNGEM3U_FINGERPRINT_H
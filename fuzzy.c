@@ -0,0 +1,394 @@
+//
+// Created by paul on 10/19/26.
+//
+#include <stdlib.h>
+#include <string.h>
+
+#include "fingerprint.h"
+#include "fuzzy.h"
+
+/* only the first few characters of each string generate deletion variants (as SymSpell does),
+ * which keeps the index small. The full strings are compared before anything is returned. */
+#define kFuzzyPrefix        7
+#define kFuzzyMaxLength     255
+#define kFuzzyMaxVariants   64      /* 1 + 7 + 21 + 35, for kFuzzyMaxDistance of 3 */
+#define kFuzzySeenBits      12
+#define kFuzzySeenSize      (1u << kFuzzySeenBits)
+
+typedef struct {
+    uint32_t    offset;     /* of the normalized string in 'text' */
+    uint16_t    length;
+    uint32_t    value;
+} tFuzzyEntry;
+
+typedef struct {
+    uint32_t    check;      /* high bits of the variant's hash */
+    uint32_t    entry;
+} tFuzzyPosting;
+
+struct sFuzzyIndex {
+    unsigned int    maxDistance;
+
+    char *          text;
+    size_t          textLength;
+    size_t          textSize;
+
+    tFuzzyEntry *   entry;
+    uint32_t        entryCount;
+    uint32_t        entrySize;
+
+    /* built by fuzzyBuild(): the postings for each bucket are contiguous */
+    uint32_t *      bucket;     /* start of each bucket's postings; bucketMask + 2 of them */
+    uint32_t        bucketMask;
+    tFuzzyPosting * posting;
+};
+
+typedef struct {
+    unsigned int    count;
+    uint64_t        hash[ kFuzzyMaxVariants ];
+} tVariants;
+
+static size_t normalize( const char * string, size_t length, char * result )
+{
+    size_t n = 0;
+
+    for ( size_t i = 0; i < length && n < kFuzzyMaxLength; ++i )
+    {
+        unsigned char c = (unsigned char)string[ i ];
+        if ( c >= 'A' && c <= 'Z' )
+        {
+            result[ n++ ] = (char)( c + ('a' - 'A') );
+        }
+        else if ( ( c >= 'a' && c <= 'z' ) || ( c >= '0' && c <= '9' ) || c >= 0x80 )
+        {
+            result[ n++ ] = (char)c;
+        }
+    }
+    return n;
+}
+
+static void addVariant( tVariants * variants, const char * s, size_t length )
+{
+    uint64_t hash = fingerprint( s, length, 0 );
+
+    for ( unsigned int i = 0; i < variants->count; ++i )
+    {
+        if ( variants->hash[ i ] == hash )
+        {
+            return;
+        }
+    }
+    if ( variants->count < kFuzzyMaxVariants )
+    {
+        variants->hash[ variants->count++ ] = hash;
+    }
+}
+
+/* every way of deleting up to 'budget' characters at or after 'from' */
+static void deletions( tVariants * variants, char * s, size_t length, size_t from, unsigned int budget )
+{
+    addVariant( variants, s, length );
+    if ( budget == 0 )
+    {
+        return;
+    }
+    for ( size_t i = from; i < length; ++i )
+    {
+        char t[ kFuzzyPrefix ];
+        memcpy( t, s, i );
+        memcpy( t + i, s + i + 1, length - i - 1 );
+        deletions( variants, t, length - 1, i, budget - 1 );
+    }
+}
+
+static void variantsOf( tVariants * variants, const char * s, size_t length, unsigned int maxDistance )
+{
+    char prefix[ kFuzzyPrefix ];
+    size_t n = length < kFuzzyPrefix ? length : kFuzzyPrefix;
+
+    memcpy( prefix, s, n );
+    variants->count = 0;
+    deletions( variants, prefix, n, 0, maxDistance );
+}
+
+/* optimal string alignment distance, giving up once it must exceed 'limit'.
+ * Only cells within 'limit' of the diagonal can be that close, so only those are computed. */
+static unsigned int boundedDistance( const char * a, size_t la, const char * b, size_t lb, unsigned int limit )
+{
+    unsigned int row[ 3 ][ kFuzzyMaxLength + 2 ];
+    unsigned int * prev2 = row[ 0 ], * prev = row[ 1 ], * cur = row[ 2 ];
+    unsigned int   big   = limit + 1;
+
+    if ( ( la > lb ? la - lb : lb - la ) > limit )
+    {
+        return big;
+    }
+
+    for ( size_t j = 0; j <= lb + 1; ++j )
+    {
+        prev[ j ] = ( j <= limit ) ? (unsigned int)j : big;
+    }
+    for ( size_t i = 1; i <= la; ++i )
+    {
+        size_t lo = ( i > limit ) ? i - limit : 1;
+        size_t hi = ( i + limit < lb ) ? i + limit : lb;
+
+        cur[ lo - 1 ] = ( lo == 1 ) ? (unsigned int)i : big;
+        unsigned int best = cur[ lo - 1 ];
+
+        for ( size_t j = lo; j <= hi; ++j )
+        {
+            unsigned int d = prev[ j - 1 ] + ( a[ i - 1 ] != b[ j - 1 ] );
+            if ( prev[ j ] + 1 < d )    d = prev[ j ] + 1;
+            if ( cur[ j - 1 ] + 1 < d ) d = cur[ j - 1 ] + 1;
+            if ( i > 1 && j > 1 && a[ i - 1 ] == b[ j - 2 ] && a[ i - 2 ] == b[ j - 1 ] && prev2[ j - 2 ] + 1 < d )
+            {
+                d = prev2[ j - 2 ] + 1;
+            }
+            cur[ j ] = ( d < big ) ? d : big;
+            if ( d < best ) best = d;
+        }
+        /* so the next row sees the edge of the band */
+        cur[ hi + 1 ] = big;
+
+        if ( best > limit )
+        {
+            return big;
+        }
+        unsigned int * t = prev2; prev2 = prev; prev = cur; cur = t;
+    }
+    return prev[ lb ];
+}
+
+static inline uint32_t bucketOf( const tFuzzyIndex * index, uint64_t hash )
+{
+    return (uint32_t)hash & index->bucketMask;
+}
+
+/**
+ * @brief
+ * @param maxDistance  the largest edit distance that will be matched, up to kFuzzyMaxDistance
+ * @return
+ */
+tFuzzyIndex * fuzzyNew( unsigned int maxDistance )
+{
+    tFuzzyIndex * index = calloc( 1, sizeof( tFuzzyIndex ) );
+
+    if ( index != NULL )
+    {
+        index->maxDistance = maxDistance < kFuzzyMaxDistance ? maxDistance : kFuzzyMaxDistance;
+    }
+    return index;
+}
+
+/**
+ * @brief
+ * @param index
+ */
+void fuzzyFree( tFuzzyIndex * index )
+{
+    if ( index != NULL )
+    {
+        free( index->text );
+        free( index->entry );
+        free( index->bucket );
+        free( index->posting );
+        free( index );
+    }
+}
+
+/**
+ * @brief add a string to be matched against. Must be called before fuzzyBuild().
+ * @param index
+ * @param string
+ * @param length
+ * @param value   returned by fuzzyFind() when this string is the best match
+ * @return false if out of memory
+ */
+bool fuzzyAdd( tFuzzyIndex * index, const char * string, size_t length, uint32_t value )
+{
+    if ( index->textLength + kFuzzyMaxLength > index->textSize )
+    {
+        size_t size = index->textSize ? index->textSize * 2 : 65536;
+        char * text = realloc( index->text, size );
+        if ( text == NULL )
+        {
+            return false;
+        }
+        index->text     = text;
+        index->textSize = size;
+    }
+    if ( index->entryCount == index->entrySize )
+    {
+        uint32_t      size  = index->entrySize ? index->entrySize * 2 : 1024;
+        tFuzzyEntry * entry = realloc( index->entry, size * sizeof( tFuzzyEntry ) );
+        if ( entry == NULL )
+        {
+            return false;
+        }
+        index->entry     = entry;
+        index->entrySize = size;
+    }
+
+    tFuzzyEntry * e = &index->entry[ index->entryCount++ ];
+    e->offset = (uint32_t)index->textLength;
+    e->length = (uint16_t)normalize( string, length, index->text + index->textLength );
+    e->value  = value;
+    index->textLength += e->length;
+
+    return true;
+}
+
+/**
+ * @brief generate the deletion variants of every string added, and index them
+ * @param index
+ * @return false if out of memory
+ */
+bool fuzzyBuild( tFuzzyIndex * index )
+{
+    tVariants variants;
+    size_t    total = 0;
+
+    /* about four postings per bucket */
+    size_t estimate = (size_t)index->entryCount * ( 1 + kFuzzyPrefix * index->maxDistance );
+    uint32_t buckets = 1024;
+    while ( buckets < estimate / 4 )
+    {
+        buckets <<= 1;
+    }
+    index->bucketMask = buckets - 1;
+
+    free( index->bucket );
+    free( index->posting );
+    index->bucket = calloc( buckets + 1, sizeof( uint32_t ) );
+    if ( index->bucket == NULL )
+    {
+        return false;
+    }
+
+    /* count the postings in each bucket... */
+    for ( uint32_t e = 0; e < index->entryCount; ++e )
+    {
+        variantsOf( &variants, index->text + index->entry[ e ].offset, index->entry[ e ].length, index->maxDistance );
+        for ( unsigned int v = 0; v < variants.count; ++v )
+        {
+            index->bucket[ bucketOf( index, variants.hash[ v ] ) + 1 ]++;
+        }
+        total += variants.count;
+    }
+    for ( uint32_t b = 0; b < buckets; ++b )
+    {
+        index->bucket[ b + 1 ] += index->bucket[ b ];
+    }
+
+    /* ...then fill them in */
+    index->posting = malloc( total * sizeof( tFuzzyPosting ) + 1 );
+    uint32_t * next = malloc( buckets * sizeof( uint32_t ) );
+    if ( index->posting == NULL || next == NULL )
+    {
+        free( next );
+        return false;
+    }
+    memcpy( next, index->bucket, buckets * sizeof( uint32_t ) );
+
+    for ( uint32_t e = 0; e < index->entryCount; ++e )
+    {
+        variantsOf( &variants, index->text + index->entry[ e ].offset, index->entry[ e ].length, index->maxDistance );
+        for ( unsigned int v = 0; v < variants.count; ++v )
+        {
+            tFuzzyPosting * p = &index->posting[ next[ bucketOf( index, variants.hash[ v ] ) ]++ ];
+            p->check = (uint32_t)( variants.hash[ v ] >> 32 );
+            p->entry = e;
+        }
+    }
+    free( next );
+
+    return true;
+}
+
+/**
+ * @brief find the closest string, within the index's maximum edit distance
+ * @param index
+ * @param string
+ * @param length
+ * @param value     set to the value of the best match
+ * @param distance  set to its edit distance, after normalization. May be NULL.
+ * @return false if nothing was close enough. Ties go to the string added first.
+ */
+bool fuzzyFind( tFuzzyIndex * index, const char * string, size_t length,
+                uint32_t * value, unsigned int * distance )
+{
+    char         query[ kFuzzyMaxLength ];
+    tVariants    variants;
+    unsigned int bestDistance = index->maxDistance + 1;
+    uint32_t     bestEntry    = 0;
+
+    if ( index->posting == NULL )
+    {
+        return false;
+    }
+
+    size_t n = normalize( string, length, query );
+    variantsOf( &variants, query, n, index->maxDistance );
+
+    /* an entry is usually found through several variants, but only needs comparing once */
+    uint32_t     seen[ kFuzzySeenSize ];
+    unsigned int seenCount = 0;
+    memset( seen, 0, sizeof( seen ) );
+
+    for ( unsigned int v = 0; v < variants.count && bestDistance > 0; ++v )
+    {
+        uint32_t b     = bucketOf( index, variants.hash[ v ] );
+        uint32_t check = (uint32_t)( variants.hash[ v ] >> 32 );
+
+        for ( uint32_t p = index->bucket[ b ]; p < index->bucket[ b + 1 ]; ++p )
+        {
+            if ( index->posting[ p ].check != check )
+            {
+                continue;
+            }
+            uint32_t            e     = index->posting[ p ].entry;
+            const tFuzzyEntry * entry = &index->entry[ e ];
+
+            /* once the set is half full, just compare any repeats again */
+            if ( seenCount < kFuzzySeenSize / 2 )
+            {
+                uint32_t h = ( e * 0x9E3779B1u ) >> ( 32 - kFuzzySeenBits );
+                while ( seen[ h ] != 0 && seen[ h ] != e + 1 )
+                {
+                    h = ( h + 1 ) & ( kFuzzySeenSize - 1 );
+                }
+                if ( seen[ h ] == e + 1 )
+                {
+                    continue;
+                }
+                seen[ h ] = e + 1;
+                seenCount++;
+            }
+
+            /* only a strictly closer match, or an earlier one as close, can improve on the best so far */
+            unsigned int limit = ( e < bestEntry ) ? bestDistance : bestDistance - 1;
+            if ( bestDistance > index->maxDistance )
+            {
+                limit = index->maxDistance;
+            }
+            unsigned int d = boundedDistance( query, n, index->text + entry->offset, entry->length, limit );
+            if ( d < bestDistance || ( d == bestDistance && e < bestEntry ) )
+            {
+                bestDistance = d;
+                bestEntry    = e;
+            }
+        }
+    }
+
+    if ( bestDistance > index->maxDistance )
+    {
+        return false;
+    }
+    *value = index->entry[ bestEntry ].value;
+    if ( distance != NULL )
+    {
+        *distance = bestDistance;
+    }
+    return true;
+}
@@ -0,0 +1,37 @@
+//
+// Created by paul on 10/19/26.
+//
+
+#ifndef MUNGEM3U_FUZZY_H
+#define MUNGEM3U_FUZZY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Approximate string lookup, using a SymSpell-style symmetric deletion index.
+ * Each string is normalized (ASCII letters and digits only, lower case), then
+ * every variant of its first few characters with up to 'maxDistance' of them
+ * deleted is indexed. A query generates the same variants, so only strings
+ * sharing a variant are candidates, and only the candidates have their edit
+ * distance computed - there's no scan over the whole set.
+ *
+ * Strings are added, then the index is built once. Lookups don't modify the
+ * index, so they may run on several threads.
+ */
+
+typedef struct sFuzzyIndex tFuzzyIndex;
+
+#define kFuzzyMaxDistance   3
+
+tFuzzyIndex * fuzzyNew( unsigned int maxDistance );
+void fuzzyFree( tFuzzyIndex * index );
+
+bool fuzzyAdd( tFuzzyIndex * index, const char * string, size_t length, uint32_t value );
+bool fuzzyBuild( tFuzzyIndex * index );
+
+bool fuzzyFind( tFuzzyIndex * index, const char * string, size_t length,
+                uint32_t * value, unsigned int * distance );
+
+#endif //MUNGEM3U_FUZZY_H
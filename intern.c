@@ -0,0 +1,362 @@
+//
+// Created by paul on 10/19/26.
+//
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "intern.h"
+
+/* the header that precedes every interned string */
+typedef struct {
+    uint64_t      hash;
+    atomic_uint   refs;
+    uint32_t      length;
+    char          text[];
+} tInterned;
+
+typedef struct {
+    pthread_mutex_t  lock;
+    tInterned **     slot;      /* open addressing, linear probing. NULL is empty */
+    size_t           mask;      /* slot count is always a power of two */
+    size_t           count;
+} tInternShard;
+
+struct sInternTable {
+    tInternShard *   shard;
+    unsigned int     count;     /* always a power of two */
+
+    atomic_ulong     requests;  /* calls to internString() */
+    atomic_ulong     requested; /* bytes that would have been allocated without interning */
+    atomic_ulong     stored;    /* bytes actually allocated for the strings, with their headers */
+    atomic_ulong     suffixes;  /* bytes allocated for the URL suffixes that aren't interned */
+};
+
+static inline tInterned * headerOf( const char * interned )
+{
+    return (tInterned *)( interned - offsetof( tInterned, text ) );
+}
+
+/* FNV-1a, folded so the shard and slot are picked from different bits */
+static uint64_t hashBytes( const char * string, size_t length )
+{
+    uint64_t h = 0xcbf29ce484222325UL;
+
+    for ( size_t i = 0; i < length; ++i )
+    {
+        h ^= (unsigned char)string[ i ];
+        h *= 0x100000001b3UL;
+    }
+    return h ^ (h >> 29);
+}
+
+/**
+ * @brief
+ * @param shards   rounded up to a power of two
+ * @return
+ */
+tInternTable * internNew( unsigned int shards )
+{
+    tInternTable * table = calloc( 1, sizeof( tInternTable ) );
+
+    if ( table != NULL )
+    {
+        unsigned int count = 1;
+        while ( count < shards )
+        {
+            count <<= 1;
+        }
+        table->count = count;
+        table->shard = calloc( count, sizeof( tInternShard ) );
+        if ( table->shard == NULL )
+        {
+            free( table );
+            return NULL;
+        }
+        for ( unsigned int i = 0; i < count; ++i )
+        {
+            pthread_mutex_init( &table->shard[ i ].lock, NULL );
+            table->shard[ i ].mask = 255;
+            table->shard[ i ].slot = calloc( 256, sizeof( tInterned * ) );
+            if ( table->shard[ i ].slot == NULL )
+            {
+                table->count = i + 1;
+                internFree( table );
+                return NULL;
+            }
+        }
+    }
+    return table;
+}
+
+/**
+ * @brief release the table, and every string still in it
+ * @param table
+ */
+void internFree( tInternTable * table )
+{
+    if ( table != NULL )
+    {
+        for ( unsigned int i = 0; i < table->count; ++i )
+        {
+            tInternShard * shard = &table->shard[ i ];
+            if ( shard->slot != NULL )
+            {
+                for ( size_t j = 0; j <= shard->mask; ++j )
+                {
+                    free( shard->slot[ j ] );
+                }
+                free( shard->slot );
+            }
+            pthread_mutex_destroy( &shard->lock );
+        }
+        free( table->shard );
+        free( table );
+    }
+}
+
+static bool shardGrow( tInternShard * shard )
+{
+    size_t       mask = shard->mask * 2 + 1;
+    tInterned ** slot = calloc( mask + 1, sizeof( tInterned * ) );
+
+    if ( slot == NULL )
+    {
+        return false;
+    }
+    for ( size_t i = 0; i <= shard->mask; ++i )
+    {
+        tInterned * s = shard->slot[ i ];
+        if ( s != NULL )
+        {
+            size_t j = (s->hash >> 8) & mask;
+            while ( slot[ j ] != NULL )
+            {
+                j = (j + 1) & mask;
+            }
+            slot[ j ] = s;
+        }
+    }
+    free( shard->slot );
+    shard->slot = slot;
+    shard->mask = mask;
+
+    return true;
+}
+
+/**
+ * @brief find or add a string, taking a reference to it
+ * @param table
+ * @param string  need not be nul-terminated
+ * @param length
+ * @return the interned copy, valid until the matching internRelease(). NULL if out of memory
+ */
+const char * internString( tInternTable * table, const char * string, size_t length )
+{
+    uint64_t       hash   = hashBytes( string, length );
+    tInternShard * shard  = &table->shard[ hash & (table->count - 1) ];
+    tInterned *    result = NULL;
+
+    atomic_fetch_add_explicit( &table->requests, 1, memory_order_relaxed );
+    atomic_fetch_add_explicit( &table->requested, length + 1, memory_order_relaxed );
+
+    pthread_mutex_lock( &shard->lock );
+
+    size_t i = (hash >> 8) & shard->mask;
+    for ( tInterned * s; (s = shard->slot[ i ]) != NULL; i = (i + 1) & shard->mask )
+    {
+        if ( s->hash == hash && s->length == length && memcmp( s->text, string, length ) == 0 )
+        {
+            atomic_fetch_add_explicit( &s->refs, 1, memory_order_relaxed );
+            result = s;
+            break;
+        }
+    }
+
+    if ( result == NULL )
+    {
+        /* keep the shard no more than three quarters full. Probes stay short,
+         * and it takes half the slots that keeping it half full did */
+        if ( 4 * (shard->count + 1) <= 3 * shard->mask || shardGrow( shard ) )
+        {
+            result = malloc( sizeof( tInterned ) + length + 1 );
+            if ( result != NULL )
+            {
+                result->hash   = hash;
+                result->length = (uint32_t)length;
+                atomic_init( &result->refs, 1 );
+                memcpy( result->text, string, length );
+                result->text[ length ] = '\0';
+
+                i = (hash >> 8) & shard->mask;
+                while ( shard->slot[ i ] != NULL )
+                {
+                    i = (i + 1) & shard->mask;
+                }
+                shard->slot[ i ] = result;
+                shard->count++;
+
+                atomic_fetch_add_explicit( &table->stored, sizeof( tInterned ) + length + 1, memory_order_relaxed );
+            }
+        }
+    }
+
+    pthread_mutex_unlock( &shard->lock );
+
+    return result != NULL ? result->text : NULL;
+}
+
+/**
+ * @brief take another reference to an interned string
+ * @param interned  may be NULL
+ * @return 'interned'
+ */
+const char * internRetain( const char * interned )
+{
+    if ( interned != NULL )
+    {
+        atomic_fetch_add_explicit( &headerOf( interned )->refs, 1, memory_order_relaxed );
+    }
+    return interned;
+}
+
+/**
+ * @brief drop a reference, removing the string from the table when it was the last
+ * @param table
+ * @param interned  may be NULL
+ */
+void internRelease( tInternTable * table, const char * interned )
+{
+    if ( interned == NULL )
+    {
+        return;
+    }
+
+    tInterned *    s     = headerOf( interned );
+    tInternShard * shard = &table->shard[ s->hash & (table->count - 1) ];
+
+    pthread_mutex_lock( &shard->lock );
+
+    /* decremented under the lock, so it can't race a lookup that's about to retain it */
+    if ( atomic_fetch_sub_explicit( &s->refs, 1, memory_order_acq_rel ) == 1 )
+    {
+        size_t i = (s->hash >> 8) & shard->mask;
+        while ( shard->slot[ i ] != s )
+        {
+            i = (i + 1) & shard->mask;
+        }
+        shard->slot[ i ] = NULL;
+        shard->count--;
+
+        /* backward-shift the rest of the probe run into the hole */
+        size_t hole = i;
+        for ( i = (i + 1) & shard->mask; shard->slot[ i ] != NULL; i = (i + 1) & shard->mask )
+        {
+            size_t home = (shard->slot[ i ]->hash >> 8) & shard->mask;
+            if ( ((i - home) & shard->mask) >= ((i - hole) & shard->mask) )
+            {
+                shard->slot[ hole ] = shard->slot[ i ];
+                shard->slot[ i ]    = NULL;
+                hole = i;
+            }
+        }
+
+        atomic_fetch_sub_explicit( &table->stored, sizeof( tInterned ) + s->length + 1, memory_order_relaxed );
+        free( s );
+    }
+
+    pthread_mutex_unlock( &shard->lock );
+}
+
+/**
+ * @brief split a URL after its last '/', interning the front part
+ *
+ * Stream URLs from one provider typically differ only in the final path
+ * component, e.g. 'http://host:port/user/password/12345.ts', so the prefix
+ * is stored once and each stream keeps only its own suffix.
+ *
+ * @param table
+ * @param url
+ * @param length
+ * @param result
+ * @return false if out of memory
+ */
+bool internFrontCoded( tInternTable * table, const char * url, size_t length, tFrontCoded * result )
+{
+    size_t split = length;
+    while ( split > 0 && url[ split - 1 ] != '/' )
+    {
+        --split;
+    }
+
+    char * suffix = malloc( length - split + 1 );
+    if ( suffix != NULL )
+    {
+        memcpy( suffix, url + split, length - split );
+        suffix[ length - split ] = '\0';
+
+        /* the prefix is counted by internString() */
+        atomic_fetch_add_explicit( &table->requested, length - split, memory_order_relaxed );
+        atomic_fetch_add_explicit( &table->suffixes, length - split + 1, memory_order_relaxed );
+    }
+    result->prefix = internString( table, url, split );
+    result->suffix = suffix;
+
+    if ( result->prefix == NULL || result->suffix == NULL )
+    {
+        internFrontCodedRelease( table, result );
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief
+ * @param table
+ * @param url
+ */
+void internFrontCodedRelease( tInternTable * table, tFrontCoded * url )
+{
+    internRelease( table, url->prefix );
+    if ( url->suffix != NULL )
+    {
+        atomic_fetch_sub_explicit( &table->suffixes, strlen( url->suffix ) + 1, memory_order_relaxed );
+    }
+    free( (void *)url->suffix );
+    url->prefix = NULL;
+    url->suffix = NULL;
+}
+
+/**
+ * @brief
+ * @param output
+ * @param name
+ * @param table
+ */
+void internReport( FILE * output, const char * name, tInternTable * table )
+{
+    size_t unique = 0;
+    size_t slots  = 0;
+
+    for ( unsigned int i = 0; i < table->count; ++i )
+    {
+        pthread_mutex_lock( &table->shard[ i ].lock );
+        unique += table->shard[ i ].count;
+        slots  += table->shard[ i ].mask + 1;
+        pthread_mutex_unlock( &table->shard[ i ].lock );
+    }
+
+    unsigned long requested = atomic_load( &table->requested );
+    unsigned long stored    = atomic_load( &table->stored );
+    unsigned long suffixes  = atomic_load( &table->suffixes );
+    unsigned long tables    = slots * sizeof( tInterned * ) + table->count * sizeof( tInternShard );
+    unsigned long total     = stored + suffixes + tables;
+
+    /* neither side counts malloc's own overhead, which is per allocation, so favours interning */
+    fprintf( output, "%s: %lu strings interned as %lu unique, %lu bytes without interning, %lu with "
+                     "(%lu strings, %lu URL suffixes, %lu tables) (%.1fx)\n",
+             name, atomic_load( &table->requests ), unique, requested, total,
+             stored, suffixes, tables,
+             total > 0 ? (double)requested / (double)total : 0.0 );
+}
@@ -0,0 +1,40 @@
+//
+// Created by paul on 10/19/26.
+//
+
+#ifndef MUNGEM3U_INTERN_H
+#define MUNGEM3U_INTERN_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * A table of reference-counted, de-duplicated strings. Interning the same text
+ * twice returns the same pointer, so the thousands of entries that share a
+ * logo or a stream URL prefix share one copy of it. The table is split into
+ * independently-locked shards so several threads can intern at once.
+ */
+
+typedef struct sInternTable tInternTable;
+
+/* a URL split into a shared, interned prefix and the remainder */
+typedef struct {
+    const char *  prefix;   /* scheme, host, port and any credentials - interned */
+    const char *  suffix;   /* everything after the last '/' - owned */
+} tFrontCoded;
+
+tInternTable * internNew( unsigned int shards );
+void internFree( tInternTable * table );
+
+const char * internString( tInternTable * table, const char * string, size_t length );
+const char * internRetain( const char * interned );
+void internRelease( tInternTable * table, const char * interned );
+
+bool internFrontCoded( tInternTable * table, const char * url, size_t length, tFrontCoded * result );
+void internFrontCodedRelease( tInternTable * table, tFrontCoded * url );
+
+void internReport( FILE * output, const char * name, tInternTable * table );
+
+#endif //MUNGEM3U_INTERN_H
@@ -0,0 +1,423 @@
+//
+// Created by paul on 10/19/26.
+//
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "fingerprint.h"
+#include "fuzzy.h"
+#include "mapping.h"
+
+/* don't bother splitting the parse across threads for less than this much of a file */
+#define kMappingChunkMin    (1024 * 1024)
+#define kMappingMaxThreads  8
+
+typedef struct {
+    const char *   name;        /* points into the mapped file, not nul-terminated */
+    uint32_t       length;
+    uint32_t       callsignLength;
+    const char *   callsign;    /* ditto */
+    long           id;
+    uint64_t       hash;
+} tMappingRow;
+
+typedef struct {
+    const char *   data;
+    size_t         size;
+} tMappedFile;
+
+typedef struct {
+    tMappingRow *  row;
+    size_t         count;
+    size_t         size;
+} tMappingRows;
+
+struct sMapping {
+    tMappedFile *  file;
+    unsigned int   fileCount;
+
+    tMappingRows   rows;
+
+    uint32_t *     slot;        /* 1 + the row number, or 0 if empty */
+    size_t         mask;        /* slot count is always a power of two */
+
+    tFuzzyIndex *  fuzzy;       /* for names that don't match exactly. May be NULL */
+};
+
+static bool appendRow( tMappingRows * rows, const tMappingRow * row )
+{
+    if ( rows->count == rows->size )
+    {
+        size_t        size = rows->size ? rows->size * 2 : 1024;
+        tMappingRow * r    = realloc( rows->row, size * sizeof( tMappingRow ) );
+        if ( r == NULL )
+        {
+            return false;
+        }
+        rows->row  = r;
+        rows->size = size;
+    }
+    rows->row[ rows->count++ ] = *row;
+    return true;
+}
+
+/**
+ * @brief
+ * @return
+ */
+tMapping * mappingNew( void )
+{
+    return calloc( 1, sizeof( tMapping ) );
+}
+
+/**
+ * @brief
+ * @param mapping
+ */
+void mappingFree( tMapping * mapping )
+{
+    if ( mapping != NULL )
+    {
+        for ( unsigned int i = 0; i < mapping->fileCount; ++i )
+        {
+            munmap( (void *)mapping->file[ i ].data, mapping->file[ i ].size );
+        }
+        free( mapping->file );
+        free( mapping->rows.row );
+        free( mapping->slot );
+        fuzzyFree( mapping->fuzzy );
+        free( mapping );
+    }
+}
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+typedef struct {
+    const char *   start;
+    const char *   end;
+    tMappingRows   rows;
+    bool           oom;
+} tMappingChunk;
+
+/* 'name<tab>field<tab>id' - rows without an ID are skipped, as are comments */
+static void * parseChunk( void * arg )
+{
+    tMappingChunk * chunk = arg;
+    const char *    p     = chunk->start;
+
+    while ( p < chunk->end && ! chunk->oom )
+    {
+        const char * eol = memchr( p, '\n', chunk->end - p );
+        if ( eol == NULL )
+        {
+            eol = chunk->end;
+        }
+
+        if ( *p != '#' && *p != '\n' && *p != '\r' )
+        {
+            const char * tab1 = memchr( p, '\t', eol - p );
+            const char * tab2 = tab1 != NULL ? memchr( tab1 + 1, '\t', eol - (tab1 + 1) ) : NULL;
+
+            if ( tab2 != NULL )
+            {
+                tMappingRow  row;
+                long         id   = 0;
+                long         sign = 1;
+                const char * q    = tab2 + 1;
+
+                /* like strtol(), but the field isn't nul-terminated */
+                while ( q < eol && ( *q == ' ' || *q == '\t' ) ) { ++q; }
+                if ( q < eol && ( *q == '-' || *q == '+' ) )
+                {
+                    sign = ( *q++ == '-' ) ? -1 : 1;
+                }
+                for ( ; q < eol && *q >= '0' && *q <= '9'; ++q )
+                {
+                    id = id * 10 + (*q - '0');
+                }
+                id *= sign;
+                row.name   = p;
+                row.length = (uint32_t)( tab1 - p );
+                row.callsign       = tab1 + 1;
+                row.callsignLength = (uint32_t)( tab2 - (tab1 + 1) );
+                row.id     = id;
+                row.hash   = fingerprint( row.name, row.length, 0 );
+
+                chunk->oom = ! appendRow( &chunk->rows, &row );
+            }
+        }
+        p = eol + 1;
+    }
+    return NULL;
+}
+
+static bool growSlots( tMapping * mapping )
+{
+    size_t     mask = mapping->mask ? mapping->mask * 2 + 1 : 1023;
+    uint32_t * slot = calloc( mask + 1, sizeof( uint32_t ) );
+
+    if ( slot == NULL )
+    {
+        return false;
+    }
+    for ( size_t i = 0; i <= mapping->mask && mapping->slot != NULL; ++i )
+    {
+        if ( mapping->slot[ i ] != 0 )
+        {
+            size_t s = mapping->rows.row[ mapping->slot[ i ] - 1 ].hash & mask;
+            while ( slot[ s ] != 0 )
+            {
+                s = (s + 1) & mask;
+            }
+            slot[ s ] = mapping->slot[ i ];
+        }
+    }
+    free( mapping->slot );
+    mapping->slot = slot;
+    mapping->mask = mask;
+
+    return true;
+}
+
+static uint32_t * findSlot( tMapping * mapping, const char * name, size_t length, uint64_t hash )
+{
+    size_t s = hash & mapping->mask;
+
+    while ( mapping->slot[ s ] != 0 )
+    {
+        const tMappingRow * row = &mapping->rows.row[ mapping->slot[ s ] - 1 ];
+        if ( row->hash == hash && row->length == length && memcmp( row->name, name, length ) == 0 )
+        {
+            break;
+        }
+        s = (s + 1) & mapping->mask;
+    }
+    return &mapping->slot[ s ];
+}
+
+/* rows must be added in file order, so a later duplicate replaces an earlier one */
+static bool indexRows( tMapping * mapping, const tMappingRows * rows )
+{
+    for ( size_t i = 0; i < rows->count; ++i )
+    {
+        /* keep the table no more than half full */
+        if ( 2 * (mapping->rows.count + 1) > mapping->mask && ! growSlots( mapping ) )
+        {
+            return false;
+        }
+        if ( ! appendRow( &mapping->rows, &rows->row[ i ] ) )
+        {
+            return false;
+        }
+        const tMappingRow * row  = &rows->row[ i ];
+        uint32_t *          slot = findSlot( mapping, row->name, row->length, row->hash );
+        *slot = (uint32_t)mapping->rows.count;
+    }
+    return true;
+}
+
+/**
+ * @brief map a mapping file into memory and add its rows to the index.
+ *        Large files are parsed on several threads at once.
+ * @param mapping
+ * @param path
+ * @return 0, or a negative errno
+ */
+int mappingLoad( tMapping * mapping, const char * path )
+{
+    int         result = 0;
+    struct stat st;
+
+    int fd = open( path, O_RDONLY );
+    if ( fd < 0 || fstat( fd, &st ) != 0 )
+    {
+        result = -errno;
+        fprintf( stderr, "### unable to open \'%s\' (%d: %s)\n", path, errno, strerror(errno) );
+        if ( fd >= 0 ) close( fd );
+        return result;
+    }
+    if ( st.st_size == 0 )
+    {
+        close( fd );
+        return 0;
+    }
+
+    tMappedFile * file = realloc( mapping->file, (mapping->fileCount + 1) * sizeof( tMappedFile ) );
+    if ( file == NULL )
+    {
+        close( fd );
+        return -ENOMEM;
+    }
+    mapping->file = file;
+
+    const char * data = mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    close( fd );
+    if ( data == MAP_FAILED )
+    {
+        result = -errno;
+        fprintf( stderr, "### unable to map \'%s\' (%d: %s)\n", path, errno, strerror(errno) );
+        return result;
+    }
+    madvise( (void *)data, st.st_size, MADV_WILLNEED );
+    file[ mapping->fileCount ].data = data;
+    file[ mapping->fileCount ].size = st.st_size;
+    mapping->fileCount++;
+
+    /* split the file into chunks, each starting at the beginning of a line */
+    long cpus = sysconf( _SC_NPROCESSORS_ONLN );
+    unsigned int threads = (unsigned int)( st.st_size / kMappingChunkMin ) + 1;
+    if ( threads > kMappingMaxThreads ) threads = kMappingMaxThreads;
+    if ( cpus > 0 && threads > (unsigned int)cpus ) threads = (unsigned int)cpus;
+
+    tMappingChunk chunk[ kMappingMaxThreads ];
+    pthread_t     thread[ kMappingMaxThreads ];
+    const char *  end = data + st.st_size;
+    const char *  p   = data;
+
+    memset( chunk, 0, sizeof( chunk ) );
+    for ( unsigned int i = 0; i < threads; ++i )
+    {
+        const char * e = ( i == threads - 1 ) ? end : data + (st.st_size / threads) * (i + 1);
+        if ( e < p ) e = p;
+        const char * eol = memchr( e, '\n', end - e );
+        chunk[ i ].start = p;
+        chunk[ i ].end   = ( eol != NULL ) ? eol + 1 : end;
+        p = chunk[ i ].end;
+    }
+
+    for ( unsigned int i = 1; i < threads; ++i )
+    {
+        if ( pthread_create( &thread[ i ], NULL, parseChunk, &chunk[ i ] ) != 0 )
+        {
+            /* do it on this thread instead */
+            parseChunk( &chunk[ i ] );
+            thread[ i ] = pthread_self();
+        }
+    }
+    parseChunk( &chunk[ 0 ] );
+
+    for ( unsigned int i = 0; i < threads; ++i )
+    {
+        if ( i > 0 && ! pthread_equal( thread[ i ], pthread_self() ) )
+        {
+            pthread_join( thread[ i ], NULL );
+        }
+        if ( chunk[ i ].oom || ( result == 0 && ! indexRows( mapping, &chunk[ i ].rows ) ) )
+        {
+            result = -ENOMEM;
+        }
+        free( chunk[ i ].rows.row );
+    }
+
+    if ( result != 0 )
+    {
+        fprintf( stderr, "### out of memory loading \'%s\'\n", path );
+    }
+    return result;
+}
+
+/**
+ * @brief allow names to match approximately, if there's no exact match.
+ *        Call after the last mapping file is loaded.
+ * @param mapping
+ * @param maxDistance  most edits allowed, after ignoring case, spaces and punctuation
+ * @return 0, or a negative errno
+ */
+int mappingApproximate( tMapping * mapping, unsigned int maxDistance )
+{
+    fuzzyFree( mapping->fuzzy );
+    mapping->fuzzy = fuzzyNew( maxDistance );
+    if ( mapping->fuzzy == NULL )
+    {
+        return -ENOMEM;
+    }
+
+    for ( size_t r = 0; r < mapping->rows.count; ++r )
+    {
+        const tMappingRow * row = &mapping->rows.row[ r ];
+
+        /* skip the rows that a later duplicate replaced */
+        if ( mapping->slot != NULL && *findSlot( mapping, row->name, row->length, row->hash ) == r + 1
+          && ! fuzzyAdd( mapping->fuzzy, row->name, row->length, (uint32_t)r ) )
+        {
+            return -ENOMEM;
+        }
+    }
+    return fuzzyBuild( mapping->fuzzy ) ? 0 : -ENOMEM;
+}
+
+/**
+ * @brief
+ * @param mapping   may be NULL
+ * @param name
+ * @param length
+ * @return the TMS ID for the name, or 0 if there isn't one
+ */
+long mappingFind( tMapping * mapping, const char * name, size_t length )
+{
+    if ( mapping == NULL || mapping->slot == NULL )
+    {
+        return 0;
+    }
+
+    uint32_t * slot = findSlot( mapping, name, length, fingerprint( name, length, 0 ) );
+    if ( *slot != 0 )
+    {
+        return mapping->rows.row[ *slot - 1 ].id;
+    }
+
+    uint32_t row;
+    if ( mapping->fuzzy != NULL && fuzzyFind( mapping->fuzzy, name, length, &row, NULL ) )
+    {
+        return mapping->rows.row[ row ].id;
+    }
+    return 0;
+}
+
+/**
+ * @brief
+ * @param mapping
+ * @return the number of rows loaded, including any duplicates
+ */
+size_t mappingCount( tMapping * mapping )
+{
+    return mapping != NULL ? mapping->rows.count : 0;
+}
+
+/**
+ * @brief visit every row loaded, in the order they were loaded
+ * @param mapping  may be NULL
+ * @param iter
+ * @param udata
+ */
+void mappingForEach( tMapping * mapping, tMappingIter iter, void * udata )
+{
+    if ( mapping != NULL )
+    {
+        for ( size_t r = 0; r < mapping->rows.count; ++r )
+        {
+            const tMappingRow * row = &mapping->rows.row[ r ];
+            iter( row->name, row->length, row->callsign, row->callsignLength, row->id, udata );
+        }
+    }
+}
+
+/**
+ * @brief
+ * @param output
+ * @param mapping
+ */
+void mappingReport( FILE * output, tMapping * mapping )
+{
+    fprintf( output, "mapping: %lu rows from %u files\n",
+             mappingCount( mapping ), mapping != NULL ? mapping->fileCount : 0 );
+}
@@ -0,0 +1,38 @@
+//
+// Created by paul on 10/19/26.
+//
+
+#ifndef MUNGEM3U_MAPPING_H
+#define MUNGEM3U_MAPPING_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+/*
+ * The channel name to Gracenote/TMS station ID mapping. Mapping files are
+ * tab-separated: the channel name, the station's callsign (may be empty),
+ * then the TMS ID. They're
+ * mmap'd and parsed in place - rows point into the mapped file - and the names
+ * are indexed by a flat open-addressing hash table. If a name appears more
+ * than once, the last row wins. Optionally, names that don't match exactly
+ * can fall back to the closest name within a given edit distance.
+ */
+
+typedef struct sMapping tMapping;
+
+typedef void (*tMappingIter)( const char * name, size_t nameLength,
+                              const char * callsign, size_t callsignLength,
+                              long id, void * udata );
+
+tMapping * mappingNew( void );
+void mappingFree( tMapping * mapping );
+
+int mappingLoad( tMapping * mapping, const char * path );
+int mappingApproximate( tMapping * mapping, unsigned int maxDistance );
+long mappingFind( tMapping * mapping, const char * name, size_t length );
+size_t mappingCount( tMapping * mapping );
+void mappingForEach( tMapping * mapping, tMappingIter iter, void * udata );
+
+void mappingReport( FILE * output, tMapping * mapping );
+
+#endif //MUNGEM3U_MAPPING_H
@@ -17,9 +17,16 @@
 #include <dlfcn.h>
 #include <fcntl.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <time.h>
+#include <fnmatch.h>
+#include <limits.h>
 
 #include <argtable3.h>
-#include <btree/btree.h>
 
 #include <libhashstrings.h>
 
@@ -39,6 +46,27 @@
 #include "languages.h"
 #include "countryCodes.h"
 #include "usstationdata.h"
+#include "phrases.h"
+#include "phrase.h"
+#include "utf8.h"
+#include "queue.h"
+#include "shard.h"
+#include "table.h"
+#include "catalog.h"
+#include "intern.h"
+#include "fingerprint.h"
+#include "mapping.h"
+#include "fuzzy.h"
+#include "xmltv.h"
+#include "split.h"
+#include "topk.h"
+#include "bitmap.h"
+#include "query.h"
+#include "snapshot.h"
+#include "numbering.h"
+#include "tally.h"
+#include "url.h"
+#include "probe.h"
 
 #define kHashExtAVI     0x0002dbe9
 #define kHashExtFLV     0x00031386
@@ -53,6 +81,8 @@
 #define kHashExtWMV     0x00037548
 #define kHashPeriod     0x0000002e
 
+#define kIndexShards    16
+
 
 /* first pass parsing the line */
 
@@ -63,24 +93,44 @@
  * unless the channel name itself has keywords to override that.
  */
 
+typedef enum { kLinear = 0, kPPV, kVOD, k24x7, kLive } tType;
+
+/*
+ * The 'hot' attributes - the ones the filtering and sorting look at - are
+ * packed into 16 bytes, so a pass over the whole catalog touches as little
+ * memory as possible. The strings live in a separate 'cold' table (see tCold),
+ * which is only touched when a name is compared or a channel is exported.
+ */
+typedef struct {
+    uint32_t          cold;         /* index of this item's tCold record */
+    uint16_t          usStation;    /* tUSCallsignIndex */
+    uint8_t           country;      /* tCountryIndex */
+    uint8_t           region;       /* tRegionIndex */
+    uint8_t           language;     /* tLanguage */
+    uint8_t           genre;        /* tGenreIndex */
+    uint8_t           affiliate;    /* tAffiliateIndex */
+    uint8_t           city;         /* tCityIndex */
+    uint8_t           resolution;   /* tResolutionIndex */
+    uint8_t           type;         /* tType */
+    bool              disabled : 1;
+    bool              isVIP    : 1;
+    bool              isPlus1  : 1;
+} tCommon;
+
+_Static_assert( sizeof( tCommon ) == 16, "tCommon should pack into 16 bytes" );
+
+/* the strings that go with a tCommon, kept out of the way of the hot attributes */
 typedef struct {
-    const char *      originalName;
     const char *      name;
-    bool              disabled;
 
-    tResolutionIndex  resolution;
-    bool              isVIP;
-    bool              isPlus1;
-    enum { kLinear = 0, kPPV, kVOD, k24x7, kLive } type;
-
-    tCityIndex        city;
-    tCountryIndex     country;
-    tRegionIndex      region;
-    tLanguage         language;
-    tGenreIndex       genre;
-    tAffiliateIndex   affiliate;
-    tUSCallsignIndex  usStation;
-} tCommon;
+    /* channels only */
+    const char *      xui;
+    const char *      id;
+    const char *      logo;
+    const char *      number;       /* the provider's tvg-chno */
+    const char *      extra;        /* the attributes that aren't understood, exactly as given */
+    uint32_t          numbered;     /* the number we gave it, or 0 */
+} tCold;
 
 const char * lookupTypeAsString[] =
 {
@@ -91,45 +141,150 @@ const char * lookupTypeAsString[] =
      [kLive]   = "Live Event"
 };
 
-typedef struct sTMSChannel {
-    const char * name;
-    long id;
-} tTMSChannel;
-
 typedef struct sStream {
-    struct sStream *  next;
-    const char     *  url;
+    tFrontCoded       url;
 
-    tResolutionIndex  resolution;
+    tHostIndex        host;         /* in global.hosts */
+    uint16_t          latency;      /* when probed, in ms. kProbeUnknown if not */
+    uint8_t           resolution;   /* tResolutionIndex */
     bool              isVIP;
     bool              isFile;
 } tStream;
 
+_Static_assert( sizeof( tStream ) == 24, "tStream should pack into 24 bytes" );
+
+#define kInlineStreams  1
+
+/* a channel's streams, best first. Most channels have just the one, so it's
+ * stored in the channel itself, and the streams only move to the heap if
+ * there are more. That keeps a tChannel to 72 bytes, where a linked list cost
+ * 32 bytes plus a heap node for each stream */
+typedef struct {
+    uint32_t          count;
+    uint32_t          capacity;
+    tStream *         spill;        /* NULL while the streams fit in 'local' */
+    tStream           local[ kInlineStreams ];
+} tStreams;
+
 typedef struct sChannel {
     tCommon           common;
+    tFingerprint      fingerprint;  /* of the country and canonical name */
 
-    const char *      xui;
-    const char *      id;
-    const char *      logo;
-
-    struct sStream *  stream;
     struct sGroup *   group;
+    tStreams          streams;
 } tChannel;
 
+_Static_assert( sizeof( tChannel ) == 72, "tChannel should pack into 72 bytes" );
+
 typedef struct sGroup {
     tCommon           common;
+    tFingerprint      fingerprint;  /* of the country and canonical name */
+    const char *      originalName; /* the group-title, as given */
 } tGroup;
 
+/* one #EXTINF entry, parsed and classified but not yet merged into the indexes */
+typedef struct sEntry {
+    unsigned long     sequence;
+    tGroup *          group;
+    tChannel *        channel;
+    tStream           stream;
+    bool              hasStream;
+} tEntry;
+
+/* what each thread that parses entries keeps to itself, until it's done */
+typedef struct {
+    tProbeCounts      probes;
+    tHostCache        hosts;
+    unsigned long     dropped;      /* entries with more unknown attributes than fit in kMaxPassthrough */
+} tParser;
+
+/* the attribute used to split the output into several files */
+typedef enum {
+    kSplitNone,
+    kSplitCountry,
+    kSplitGenre,
+    kSplitRegion,
+    kSplitDMA,
+    kSplitGroup     /* by which group-title pattern matches first */
+} tSplitKey;
+
 struct {
     const char *       executableName;
     FILE *             outputFile;
     int                debugLevel;
 
     struct {
-        struct btree * channel;
-        struct btree * group;
-        struct btree * mapping;
-    } tree;
+        tShardIndex *  channel;
+        tShardIndex *  group;
+    } index;
+    tMapping *         mapping;     /* channel name to TMS ID */
+    long *             callsignTMS; /* TMS ID for each tUSCallsignIndex, or 0 */
+    tXMLTV *           guide;       /* XMLTV guide data, joined on tvg-id */
+    const char *       guideOutput; /* where to write the guide for just the channels kept. May be NULL */
+    struct {
+        unsigned long  kept;
+        unsigned long  guided;      /* of those kept, how many the guide has data for */
+        unsigned long  programmes;
+    } joined;                       /* the channels from every input joined to the guide so far */
+    struct {
+        tSplitKey      key;
+        char **        pattern;     /* for kSplitGroup */
+        unsigned int   patternCount;
+        const char *   prefix;      /* NULL to name the files after the input file */
+        const char *   extension;
+        unsigned int   cap;         /* most channels per file, or 0 for no limit */
+        tSplit *       output;      /* NULL when not splitting */
+    } split;
+    struct {
+        size_t         k;           /* most channels to output, or 0 for no limit */
+        struct {
+            int        resolution;
+            int        tms;         /* has a TMS ID, so Channels DVR can find its guide data */
+            int        language;    /* in the language the filters keep */
+            int        affiliate;   /* of a network */
+            int        streams;     /* per stream, up to kScoreMaxStreams */
+        } weight;
+        uint8_t        language;    /* the filter policy's, or kLanguageUnset for any */
+        tTopK *        heap;        /* while exporting */
+        size_t         offered;
+        int64_t        threshold;   /* lowest score kept */
+    } top;
+    struct {
+        const char *   path;        /* --output, or NULL for stdout */
+        char *         temporary;   /* written, then renamed over 'path' if anything changed */
+        bool           started;     /* the #EXTM3U header has been written */
+    } output;
+    struct {
+        const char *   path;        /* of the snapshot, or NULL when not comparing */
+        tSnapshot *    previous;
+        tSnapshot *    current;     /* the channels written so far */
+        FILE *         render;      /* each channel is written here first, so it can be hashed */
+        char *         buffer;
+        size_t         size;
+        bool           failed;
+    } delta;
+    struct {
+        tNumbering *   table;       /* NULL when not numbering the channels */
+        char **        pattern;     /* the group-title pattern for each range */
+        unsigned int * range;
+        unsigned int   count;
+        unsigned int   fallback;    /* for the groups no pattern matches */
+    } numbering;
+    struct sProfile *  profile;     /* each written to its own file, instead of the usual output */
+    unsigned int       profileCount;
+    struct {
+        const char **  expression;  /* answered instead of the usual output */
+        unsigned int   count;
+        int            format;      /* tQueryFormat */
+    } query;
+    tPhraseMatcher *   phrases;
+    tTable *           cold;        /* tCold records */
+    tInternTable *     strings;     /* ids, logos and stream URL prefixes */
+    tTally *           unknownFields;   /* #EXTINF attributes passed through without being understood */
+    tTally *           unknownExtensions;   /* stream URL extensions that aren't recognized */
+    atomic_ulong       droppedFields;   /* entries whose unknown attributes didn't all fit */
+    tHostTable *       hosts;       /* that the streams are served from */
+    tProbes *          probes;      /* how quickly each stream started, if known */
     struct {
         tChannel *     channel;
         tGroup *       group;
@@ -137,10 +292,31 @@ struct {
     } head;
 } global;
 
+static inline tCold * coldOf( const tCommon * common )
+{
+    return (tCold *)tableGet( global.cold, common->cold, sizeof( tCold ) );
+}
+
+static inline const char * nameOf( const tCommon * common )
+{
+    return coldOf( common )->name;
+}
+
+static inline tStream * streamsData( tStreams * streams )
+{
+    return streams->spill != NULL ? streams->spill : streams->local;
+}
+
+/* the best of the channel's streams, or NULL if it has none */
+static inline tStream * headStream( tChannel * channel )
+{
+    return channel->streams.count > 0 ? streamsData( &channel->streams ) : NULL;
+}
+
 void dumpCommon(  FILE * output, tCommon  * common );
 void dumpChannel( FILE * output, tChannel * channel );
 void dumpGroup(   FILE * output, tGroup   * group );
-void dumpStreams( FILE * output, tStream  * stream );
+void dumpStreams( FILE * output, tStreams * streams );
 
 
 #undef DEBUG_REJECTION
@@ -263,7 +439,9 @@ bool isChannelDisabled( tChannel * channel )
     tCommon * common = &channel->common;
 
 
-    if ( channel->stream == NULL || channel->stream->isFile == true )
+    tStream * stream = headStream( channel );
+
+    if ( stream == NULL || stream->isFile == true )
     {
         result = true;
 #ifdef DEBUG_REJECTION
@@ -379,7 +557,7 @@ bool isChannelDisabled( tChannel * channel )
 
     if ( ! result)
     {
-        if ( channel->stream != NULL && channel->stream->resolution == kResolutionSD )
+        if ( stream != NULL && stream->resolution == kResolutionSD )
         {
             result = true;
 #ifdef DEBUG_REJECTION
@@ -392,6 +570,47 @@ bool isChannelDisabled( tChannel * channel )
     return result;
 }
 
+/* the genres rejected below must fit in tFilterPolicy.rejectGenres */
+_Static_assert( kGenreAdult < 16 && kGenreCivic < 16 && kGenreReligious < 16
+             && kGenreShopping < 16 && kGenreSports < 16, "genre won't fit in rejectGenres" );
+
+/**
+ * @brief the policy of isChannelDisabled() and isGroupDisabled(), in a form the
+ *        columnar filter kernel can evaluate. Keep the two in step.
+ * @param policy
+ */
+void initFilterPolicy( tFilterPolicy * policy )
+{
+    memset( policy, 0, sizeof( tFilterPolicy ) );
+
+    /* genres I never record */
+    policy->rejectGenres = (1u << kGenreAdult)    | (1u << kGenreCivic)
+                         | (1u << kGenreReligious) | (1u << kGenreShopping)
+                         | (1u << kGenreSports);
+
+    policy->rejectFlags = kCatalogFlagNoStream | kCatalogFlagPlus1 | kCatalogFlagGroupOff;
+    policy->linearOnly  = true;
+    policy->language    = kLanguageEnglish;
+    policy->rejectResolution = kResolutionSD;
+
+    /* trim down to just UK, US and Canadian channels */
+    policy->keepCountry[ policy->keepCountryCount++ ] = kCountryUnset;
+    policy->keepCountry[ policy->keepCountryCount++ ] = kCountryCanada;
+    policy->keepCountry[ policy->keepCountryCount++ ] = kCountryUnitedKingdom;
+    policy->keepCountry[ policy->keepCountryCount++ ] = kCountryUnitedStates;
+
+    /* remove redundant regional channels */
+    policy->localGenre = kGenreLocal;
+    policy->keepLocal[ policy->keepLocalCount   ].country = kCountryUnitedStates;
+    policy->keepLocal[ policy->keepLocalCount++ ].city    = 0;
+    policy->keepLocal[ policy->keepLocalCount   ].country = kCountryCanada;
+    policy->keepLocal[ policy->keepLocalCount++ ].city    = kCityToronto;
+    policy->keepLocal[ policy->keepLocalCount   ].country = kCountryCanada;
+    policy->keepLocal[ policy->keepLocalCount++ ].city    = kCityVancouver;
+    policy->keepLocal[ policy->keepLocalCount   ].country = kCountryUnitedKingdom;
+    policy->keepLocal[ policy->keepLocalCount++ ].city    = kCityLondon;
+}
+
 /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
 static inline int min( int a, int b )
@@ -422,8 +641,16 @@ char * seperatePlus1( char * str )
     /* if a '+' was found, and it is followed by a '1', but NOT preceded by a ' '...  */
     if ( s != NULL && s[ 1 ] == '1' && s[ -1 ] != ' ' )
     {
-        /* enlarge the string to make room for the extra char */
-        str = realloc( (void *)str, strlen( str ) + 2 );
+        /* enlarge the string to make room for the extra char,
+         * which may move it, so 's' has to move with it */
+        size_t plus = s - str;
+        char * grown = realloc( (void *)str, strlen( str ) + 2 );
+        if ( grown == NULL )
+        {
+            return str;
+        }
+        str = grown;
+        s   = &str[ plus ];
 
         /* find the end of the string */
         while ( *s != '\0' ) { s++; }
@@ -471,22 +698,90 @@ void trimAppendQuote( char * p )
 
 /* in hindsight, I probably should have used C++ instead... */
 /**
- * @brief
- * @return
+ * @brief release what the stream refers to. The stream itself is stored by value.
+ * @param stream
  */
-tStream * newStream( void )
+void releaseStream( tStream * stream )
+{
+    internFrontCodedRelease( global.strings, &stream->url );
+}
+
+/* higher is better: resolution first, then the quickest to start, then VIP.
+ * Streams that weren't probed rank below those that were, but above those that failed.
+ * Before streams were ranked by VIP, the first of several with the same resolution
+ * was the one written. Now a VIP stream is written ahead of them, wherever it came. */
+static inline unsigned int streamRank( const tStream * stream )
 {
-    return (tStream *) calloc( 1, sizeof( tStream ));
+    return ( (unsigned int)stream->resolution << 17 )
+         | ( (unsigned int)(kProbeFailed - stream->latency) << 1 )
+         | stream->isVIP;
+}
+
+static bool growStreams( tStreams * streams )
+{
+    uint32_t  capacity = streams->capacity * 2;
+    tStream * spill    = malloc( capacity * sizeof( tStream ) );
+
+    if ( spill == NULL )
+    {
+        return false;
+    }
+    memcpy( spill, streamsData( streams ), streams->count * sizeof( tStream ) );
+    free( streams->spill );
+    streams->spill    = spill;
+    streams->capacity = capacity;
+
+    return true;
 }
 
 /**
- * @brief
+ * @brief add a copy of the stream, keeping the streams in order, best first.
+ *        Streams that rank equally stay in the order they were added.
+ * @param streams
  * @param stream
+ * @return false if out of memory
+ */
+bool insertStream( tStreams * streams, const tStream * stream )
+{
+    if ( streams->count == streams->capacity && !growStreams( streams ) )
+    {
+        return false;
+    }
+
+    tStream *    data = streamsData( streams );
+    unsigned int rank = streamRank( stream );
+    uint32_t     position = 0;
+
+    /* the streams are sorted, so the ones ranked at least as high form a prefix.
+     * Counting them needs no branches. */
+    for ( uint32_t i = 0; i < streams->count; ++i )
+    {
+        position += ( streamRank( &data[ i ] ) >= rank );
+    }
+    memmove( &data[ position + 1 ], &data[ position ], (streams->count - position) * sizeof( tStream ) );
+    data[ position ] = *stream;
+    streams->count++;
+
+    return true;
+}
+
+/**
+ * @brief free the strings in an item's cold record, and release the record for reuse
+ * @param common
  */
-void freeStream( tStream * stream )
+void releaseCold( tCommon * common )
 {
-    free( (void *)stream->url );
-    free( (void *)stream );
+    tCold * cold = coldOf( common );
+
+    free( (void *)cold->name );
+    internRelease( global.strings, cold->xui );
+    internRelease( global.strings, cold->id );
+    internRelease( global.strings, cold->logo );
+    internRelease( global.strings, cold->number );
+    internRelease( global.strings, cold->extra );
+
+    tableRelease( global.cold, common->cold );
+    common->cold = 0;
 }
 
 /**
@@ -495,7 +790,18 @@ void freeStream( tStream * stream )
  */
 tChannel * newChannel(void)
 {
-    return (tChannel *) calloc(1,sizeof( tChannel ));
+    tChannel * channel = (tChannel *) calloc(1,sizeof( tChannel ));
+    if ( channel != NULL )
+    {
+        channel->streams.capacity = kInlineStreams;
+        channel->common.cold = tableAppend( global.cold );
+        if ( channel->common.cold == kTableError )
+        {
+            free( channel );
+            channel = NULL;
+        }
+    }
+    return channel;
 }
 
 /**
@@ -507,15 +813,14 @@ tChannel * freeChannel( tChannel * channel )
 {
     if (channel != NULL)
     {
-        tStream * stream = channel->stream;
-        channel->stream = NULL;
-        while ( stream != NULL )
+        tStream * data = streamsData( &channel->streams );
+        for ( uint32_t i = 0; i < channel->streams.count; ++i )
         {
-            tStream * next = stream->next;
-            freeStream( stream );
-            stream = next;
+            releaseStream( &data[ i ] );
         }
+        free( channel->streams.spill );
 
+        releaseCold( &channel->common );
         free( channel );
     }
     return NULL;
@@ -527,7 +832,17 @@ tChannel * freeChannel( tChannel * channel )
  */
 tGroup * newGroup( void )
 {
-    return (tGroup *) calloc( 1, sizeof( tGroup ) );
+    tGroup * group = (tGroup *) calloc( 1, sizeof( tGroup ) );
+    if ( group != NULL )
+    {
+        group->common.cold = tableAppend( global.cold );
+        if ( group->common.cold == kTableError )
+        {
+            free( group );
+            group = NULL;
+        }
+    }
+    return group;
 }
 
 /**
@@ -538,7 +853,8 @@ void freeGroup( tGroup * group )
 {
     if (group != NULL)
     {
-        free( (void *) group->common.name );
+        releaseCold( &group->common );
+        free( (void *) group->originalName );
         free( (void *) group );
     }
 }
@@ -598,15 +914,16 @@ void dumpCommon( FILE * output, tCommon * common)
  * @param output
  * @param stream
  */
-void dumpStreams( FILE * output, tStream * stream )
+void dumpStreams( FILE * output, tStreams * streams )
 {
-    while ( stream != NULL )
+    tStream * stream = streamsData( streams );
+
+    for ( uint32_t i = 0; i < streams->count; ++i, ++stream )
     {
-        fprintf( output, "   stream: rez: %s, isvip: %d, url: %s\n",
+        fprintf( output, "   stream: rez: %s, isvip: %d, url: %s%s\n",
                  lookupResolutionAsString[ stream->resolution ],
                  stream->isVIP,
-                 stream->url );
-        stream = stream->next;
+                 stream->url.prefix, stream->url.suffix );
     }
 }
 
@@ -618,9 +935,9 @@ void dumpStreams( FILE * output, tStream * stream )
 void dumpChannel( FILE * output, tChannel * channel )
 {
     fprintf( output, "  channel " );
-    if ( channel->common.name != NULL )
+    if ( nameOf( &channel->common ) != NULL )
     {
-        fprintf( output, "name: %s", channel->common.name );
+        fprintf( output, "name: %s", nameOf( &channel->common ) );
     }
     if ( channel->common.country != kCountryUnset )
     {
@@ -643,9 +960,9 @@ void dumpChannel( FILE * output, tChannel * channel )
 void dumpGroup( FILE * output, tGroup * group )
 {
     fprintf( output, "    group " );
-    if ( group->common.name != NULL )
+    if ( nameOf( &group->common ) != NULL )
     {
-        fprintf( output, "name: %s", group->common.name );
+        fprintf( output, "name: %s", nameOf( &group->common ) );
     }
     if ( group->common.country != kCountryUnset )
     {
@@ -664,12 +981,28 @@ void dumpGroup( FILE * output, tGroup * group )
 
 /**
  * @brief
+ * @param index
+ * @param setting
+ * @return
+ */
+bool assignIndex( tIndex index, uint8_t * setting )
+{
+    if ( index != kIndexUnset && *setting == kIndexUnset )
+    {
+        *setting = index;
+    }
+    return (index != kIndexUnset);
+}
+
+/**
+ * @brief as assignIndex(), for the attributes with more than 255 values,
+ *        looking the hash up first
  * @param skipTable
  * @param hash
  * @param setting
  * @return
  */
-bool assignHash( tRecord skipTable[], tHash hash, tIndex * setting )
+bool assignHashWide( tRecord skipTable[], tHash hash, uint16_t * setting )
 {
     tIndex index = findHash( skipTable, hash );
     if ( index != kIndexUnset && *setting == kIndexUnset )
@@ -679,17 +1012,67 @@ bool assignHash( tRecord skipTable[], tHash hash, tIndex * setting )
     return (index != kIndexUnset);
 }
 
+/* what a word or phrase of a name stands for, in each of the keyword dictionaries */
+typedef struct {
+    tHash                 hash;           /* of a single word, for the US callsign lookup. 0 for a phrase */
+    tCountryIndex         country;
+    tNameIndex            name;
+    tResolutionIndex      resolution;
+    tCityIndex            city;
+    tGenreIndex           genre;
+    tCapitalizationIndex  capitalization;
+} tKeywordMatch;
+
 /**
- * @brief
+ * @brief look a single word up in each of the keyword dictionaries
  * @param hash
+ * @param match
+ */
+void matchWord( tHash hash, tKeywordMatch * match )
+{
+    match->hash           = hash;
+    match->country        = findHash( mapCountrySearch,        hash );
+    match->name           = findHash( mapNameSearch,           hash );
+    match->resolution     = findHash( mapResolutionSearch,     hash );
+    match->city           = findHash( mapCitySearch,           hash );
+    match->genre          = findHash( mapGenreSearch,          hash );
+    match->capitalization = findHash( mapCapitalizationSearch, hash );
+}
+
+/**
+ * @brief the keyword a multi-word phrase stands for
+ * @param phrase
+ * @param match
+ */
+void matchPhrase( const tMultiWordPhrase * phrase, tKeywordMatch * match )
+{
+    memset( match, 0, sizeof( tKeywordMatch ) );
+    switch ( phrase->category )
+    {
+    case kMatchCountry:        match->country        = phrase->index; break;
+    case kMatchName:           match->name           = phrase->index; break;
+    case kMatchResolution:     match->resolution     = phrase->index; break;
+    case kMatchCity:           match->city           = phrase->index; break;
+    case kMatchGenre:          match->genre          = phrase->index; break;
+    case kMatchCapitalization: match->capitalization = phrase->index; break;
+
+    default:
+        /* callsigns are single words */
+        break;
+    }
+}
+
+/**
+ * @brief
+ * @param match
  * @param common
  * @return true - swallow the string
  */
-bool processCommonHash( tHash hash, tCommon * common )
+bool processCommonMatch( const tKeywordMatch * match, tCommon * common )
 {
     bool swallow = false;
 
-    if ( common->country == kCountryUnset && assignHash( mapCountrySearch, hash, &common->country ) )
+    if ( common->country == kCountryUnset && assignIndex( match->country, &common->country ) )
     {
         swallow = true;
         if ( common->region == kRegionUnset )
@@ -702,7 +1085,7 @@ bool processCommonHash( tHash hash, tCommon * common )
             common->language = countryToLanguage[ common->country ];
         }
     } else {
-        switch ( findHash( mapCountrySearch, hash ) )
+        switch ( match->country )
         {
         case kCountryCanada:
             if ( common->country == kCountryFrance )
@@ -723,7 +1106,7 @@ bool processCommonHash( tHash hash, tCommon * common )
         }
     }
 
-    switch (findHash( mapNameSearch, hash ))
+    switch ( match->name )
     {
     case kNameVIP:
         common->isVIP = true;
@@ -757,16 +1140,22 @@ bool processCommonHash( tHash hash, tCommon * common )
     case kNameLatino:
         common->language = kLanguageSpanish;
         break;
+
+    default:
+        break;
     }
 
-    if ( assignHash( mapResolutionSearch, hash, &common->resolution ) )
+    if ( assignIndex( match->resolution, &common->resolution ) )
     {
         swallow = true;
     }
 
     if ( common->country == kCountryUnitedStates || common->country == kCountryCanada )
     {
-        assignHash( mapUSCallsignSearch, hash, &common->usStation );
+        if ( match->hash != 0 )
+        {
+            assignHashWide( mapUSCallsignSearch, match->hash, &common->usStation );
+        }
         if ( common->usStation != kUSCallsignUnset )
         {
             common->country   = kCountryUnitedStates;
@@ -775,7 +1164,7 @@ bool processCommonHash( tHash hash, tCommon * common )
         }
     }
 
-    if ( common->genre == kGenreUnset && assignHash( mapCitySearch, hash, &common->city ) )
+    if ( common->genre == kGenreUnset && assignIndex( match->city, &common->city ) )
     {
         common->genre = kGenreLocal;
     }
@@ -785,7 +1174,7 @@ bool processCommonHash( tHash hash, tCommon * common )
     /* Allow a second genre to override 'sports', since group names of 'sports and entertainment' are common*/
     if ( common->genre == kGenreUnset || common->genre == kGenreSports )
     {
-        assignHash( mapGenreSearch, hash, &common->genre );
+        assignIndex( match->genre, &common->genre );
     }
 
     /* This is a stronger indication of a station's language than the country, e.g. hispanic networks in the U.S. */
@@ -877,299 +1266,662 @@ void inheritGroup( tChannel * channel, tGroup * group )
 
 /**
  * @brief
- * @param url
+ * @param stream  filled in
+ * @param url     need not be nul-terminated
+ * @param length
  * @param channel
- * @return
+ * @param parser  the calling thread's
+ * @return false if out of memory
  */
-tStream * processStream( const char * url, tChannel * channel )
+bool processStream( tStream * stream, const char * url, size_t length, tChannel * channel, tParser * parser )
 {
-    tStream * stream = newStream();
-    if ( stream != NULL)
+    memset( stream, 0, sizeof( tStream ) );
+    stream->latency = kProbeUnknown;
+    inheritChannel( stream, channel );
+
+    if ( url != NULL && !internFrontCoded( global.strings, url, length, &stream->url ) )
     {
-        stream->url = url;
-        inheritChannel( stream, channel );
+        return false;
+    }
+
+    if ( url != NULL)
+    {
+        if ( global.probes != NULL )
+        {
+            stream->latency = probesLatency( global.probes, url, length, &parser->probes );
+        }
+
+        tURL parts;
+        if ( urlParse( url, length, &parts ) && global.hosts != NULL )
+        {
+            stream->host = hostInternCached( global.hosts, &parser->hosts, url + parts.hostStart, parts.hostLength );
+        }
 
-        if ( url != NULL)
+        /* the extension ends the path, so a query string doesn't hide it */
+        const char * path = url + parts.pathStart;
+        const char * end  = path + parts.pathLength;
+        const char * ext  = end;
+        for ( int i = 5; ext > path && i > 0; --i )
         {
-            const char * ext;
-            for ( ext = url; *ext != '\0'; ++ext ) { /* find the end-of-string */ }
-            for ( int i = 5; ext > url && *ext != '.' && i > 0; --i )
+            /* scan backwards up to 5 characters, looking for a period */
+            if ( *--ext == '.' || *ext == '/' )
             {
-                /* scan backwards up to 5 characters, looking for a period */
-                --ext;
+                break;
             }
+        }
+
+        if ( ext < end && *ext == '.' )
+        {
+            char extension[ 8 ];
+            memcpy( extension, ext, end - ext );
+            extension[ end - ext ] = '\0';
+            ext = extension;
 
-            if ( *ext == '.' )
+            tHash hash = hashString( ext, gNameCharMap );
+            switch ( hash )
             {
-                tHash hash = hashString( ext, gNameCharMap );
-                switch ( hash )
-                {
-                case kHashExtAVI:
-                case kHashExtFLV:
-                case kHashExtM4V:
-                case kHashExtMK:
-                case kHashExtMKV:
-                case kHashExtMP41:
-                case kHashExtMP4:
-                case kHashExtMPG:
-                case kHashExtWMV:
-                    stream->isFile = true;
-                    break;
+            case kHashExtAVI:
+            case kHashExtFLV:
+            case kHashExtM4V:
+            case kHashExtMK:
+            case kHashExtMKV:
+            case kHashExtMP41:
+            case kHashExtMP4:
+            case kHashExtMPG:
+            case kHashExtWMV:
+                stream->isFile = true;
+                break;
 
-                case kHashExtTS:  /* valid streams may have a .ts extension */
-                case kHashExtM3U8: /* ...or a .m3u8 extension */
-                case kHashPeriod: /* some URLs have trailing periods? */
-                    break;
+            case kHashExtTS:  /* valid streams may have a .ts extension */
+            case kHashExtM3U8: /* ...or a .m3u8 extension */
+            case kHashPeriod: /* some URLs have trailing periods? */
+                break;
 
-                default:
-                    if ( hash != 0 ) {
-                        fprintf( stderr, "%s = 0x%08lx (%s)\n", ext, hash, url );
-                    }
-                    break;
+            default:
+                if ( hash != 0 && global.unknownExtensions != NULL )
+                {
+                    /* VOD-heavy providers have hundreds of thousands of these, so they're reported once at the end */
+                    tallyAdd( global.unknownExtensions, ext, strlen( ext ), url, length );
                 }
+                break;
             }
         }
-
-        // dumpChannel( stderr, channel );
     }
 
-    return stream;
+    // dumpChannel( stderr, channel );
+
+    return true;
 }
 
+/* the most words in a phrase */
+#define kMaxPhraseTokens    16
+
 /**
- * @brief
- * @param name
- * @param common
+ * @brief build the multi-word phrase matcher from the phrases in phrases.h
+ * @return
  */
-void processName( const char * name, tCommon * common )
+tPhraseMatcher * buildPhraseMatcher( void )
 {
-    tMappedChar   mappedC;
-    const char *  p;
-    char *        sp;
-    char *        dp;
-    int           dl;
-    char          temp[256];
-
-    /* first extract any attributes embedded in the channel name,
-     * tags like 'VIP', 'UK', 'HD', etc. See name.hash */
+    tPhraseMatcher * matcher = phraseNew();
 
-    if ( name == NULL || strlen(name) == 0 )
+    if ( matcher != NULL )
     {
-        common->name = strdup( "(none)" );
-        return;
+        for ( const tMultiWordPhrase * phrase = multiWordPhrases; phrase->phrase != NULL; ++phrase )
+        {
+            tHash        token[ kMaxPhraseTokens ];
+            unsigned int count = 0;
+            bool         fits  = true;
+            tHash        word  = 0;   /* hash of the current word */
+            tMappedChar  mappedC;
+            const char * p = phrase->phrase;
+
+            do {
+                mappedC = remapChar( gNameCharMap, *p++ );
+                if ( mappedC != kNameSeparator && mappedC != '\0' )
+                {
+                    word = hashChar( word, mappedC );
+                }
+                else if ( word != 0 )
+                {
+                    fits &= ( count < kMaxPhraseTokens );
+                    if ( fits )
+                    {
+                        token[ count++ ] = word;
+                    }
+                    word = 0;
+                }
+            } while ( mappedC != '\0' );
+
+            if ( ! fits )
+            {
+                /* matching only the first few words would match names it shouldn't */
+                fprintf( stderr, "### phrase \'%s\' has more than %d words\n", phrase->phrase, kMaxPhraseTokens );
+            }
+            else if ( ! phraseAdd( matcher, token, count, (int)(phrase - multiWordPhrases) ) )
+            {
+                fprintf( stderr, "### error: out of memory adding phrase \'%s\'\n", phrase->phrase );
+            }
+        }
+        phraseBuild( matcher );
     }
 
-    p = name;
-    common->originalName = strdup( p );
+    return matcher;
+}
 
-    sp = temp;
-    dp = sp;
+#define kMaxNameTokens  64
 
-    dp[0] = '\0';
-    dl = sizeof( temp ) - 1;
+/* a name, broken into separator-delimited tokens of remapped characters */
+typedef struct {
+    char          text[ 256 ];
+    bool          utf8;         /* text[] holds valid UTF-8, rather than arbitrary bytes */
+    unsigned int  count;
+    struct {
+        unsigned short  start;      /* offset into text[] */
+        unsigned short  length;
+        unsigned short  alpha;      /* number of alphabetic chars in the token */
+    } token[ kMaxNameTokens ];
+    tHash         hash[ kMaxNameTokens ];
 
-    tHash hash = 0;
-    bool first = true;
-    int alpha = 0;
+    /* the longest phrase that starts at each token */
+    struct {
+        unsigned int    count;
+        int             tag;        /* index into multiWordPhrases[] */
+    } phrase[ kMaxNameTokens ];
+} tNameTokens;
+
+/**
+ * @brief split the name into tokens in a single pass, hashing each one as we go
+ * @param name
+ * @param tokens
+ * @param decode    fold multi-byte UTF-8 characters, checking them as they're decoded
+ * @return false if decoding and the name turned out not to be valid UTF-8
+ */
+bool scanName( const char * name, tNameTokens * tokens, bool decode )
+{
+    tMappedChar   mappedC;
+    const char *  p = name;
+    unsigned int  len = 0;
+    tHash         hash = 0;
+    unsigned int  start = 0;
+    unsigned int  alpha = 0;
+
+    tokens->utf8  = false;
+    tokens->count = 0;
     do {
-        mappedC = remapChar( gNameCharMap, *p++ );
-        if ( mappedC != kNameSeparator && mappedC != '\0' )
+        if ( decode && (unsigned char)*p >= 0x80 )
         {
-            hash = hashChar( hash, mappedC );
-            *dp++ = mappedC;
-            if ( isalpha( mappedC ) )
+            tCodePoint   cp;
+            unsigned int consumed = utf8DecodeChecked( p, &cp );
+            if ( consumed == 0 )
             {
-                ++alpha;
+                return false;
             }
-        }
-        else
-        {
-            if ( hash != 0 )
+            p += consumed;
+            cp = utf8ToLower( cp );
+            mappedC = 0x80; /* anything that isn't a separator or the end of the string */
+            tokens->utf8 = true;
+
+            char d[4];
+            unsigned int n = utf8Encode( cp, d );
+            if ( len + n < sizeof( tokens->text ) )
             {
-                if ( processCommonHash( hash, common ) )
+                char base = utf8BaseLetter( cp );
+                if ( base != '\0' )
                 {
-                    /* swallow the string - back up to the beginning of this hash run */
-                    dp = sp;
+                    hash = hashChar( hash, remapChar( gNameCharMap, base ) );
                 }
                 else
                 {
-                    tCapitalizationIndex capitalize = findHash( mapCapitalizationSearch, hash );
-                    if ( capitalize != kCapitalizationUnset )
-                    {
-                        const char * p = lookupCapitalizationAsString[ capitalize ];
-                        dp = stpcpy( sp, p );
-                        if ( mappedC != '\0' )
-                        {
-                            *dp++ = ' ';
-                        }
-                        sp = dp;
-                    }
-                    else
+                    for ( unsigned int i = 0; i < n; ++i )
                     {
-                        for ( char * q = sp; q < dp; q++ )
-                        {
-                            if ( first )
-                            {
-                                *q = toupper( *q );
-                            }
-                            if ( isalpha( *q ) && alpha > 3 )
-                            {
-                                first = false;
-                            }
-                        }
-                        /* if we're not at the end of the string, add a separator */
-                        if ( mappedC != '\0' )
-                        {
-                            *dp++ = ' ';
-                        }
-                        /* remember the start of the next hash run */
-                        sp = dp;
+                        hash = hashChar( hash, (tMappedChar)d[ i ] );
                     }
                 }
-                *dp = '\0';
-
-                hash = 0;
+                memcpy( &tokens->text[ len ], d, n );
+                len += n;
+                if ( utf8IsAlpha( cp ) )
+                {
+                    ++alpha;
+                }
             }
-            first = true;
-            alpha = 0;
+            continue;
         }
-    } while ( mappedC != '\0' );
-
-    /* nuke the trailing space, if there is one */
-    if ( dp[-1] == ' ' )
-    {
-        *(--dp) = '\0';
-        dl++;
-    }
 
-    /* if we extracted a country, append it to the name */
-    if ( common->country != kCountryUnset )
-    {
-        int len = strlen( temp );
-        if ( len != 0 )
+        mappedC = remapChar( gNameCharMap, *p++ );
+        if ( mappedC != kNameSeparator && mappedC != '\0' )
         {
-            snprintf( &temp[ len ], sizeof( temp ) - len, " (%s)", lookupCountryAsString[ common->country ] );
+            if ( len < sizeof( tokens->text ) - 1 )
+            {
+                hash = hashChar( hash, mappedC );
+                tokens->text[ len++ ] = mappedC;
+                if ( asciiIsAlpha( mappedC ) )
+                {
+                    ++alpha;
+                }
+            }
         }
         else
         {
-            const char * fullCountry = lookupFullCountryAsString[ common->country ];
-            if ( fullCountry != NULL )
+            if ( hash != 0 && tokens->count < kMaxNameTokens )
             {
-                strncpy( temp, fullCountry, sizeof(temp) );
-                if ( common->genre == kGenreUnset )
-                {
-                    common->genre = kGenreCountry;
-                }
+                unsigned int i = tokens->count++;
+                tokens->token[ i ].start  = start;
+                tokens->token[ i ].length = len - start;
+                tokens->token[ i ].alpha  = alpha;
+                tokens->hash[ i ]         = hash;
+                tokens->phrase[ i ].count = 0;
+            }
+            else
+            {
+                /* drop the chars of a token we can't keep */
+                len = start;
             }
+            start = len;
+            hash  = 0;
+            alpha = 0;
         }
-    }
-
-    if ( common->resolution != kResolutionUnset )
-    {
-        int len = strlen( temp );
-        snprintf( &temp[ len ], sizeof( temp ) - len, " [%s]",
-                  lookupResolutionAsString[ common->resolution ] );
-    }
+    } while ( mappedC != '\0' );
 
-    common->name = strdup( temp );
+    return true;
 }
 
 /**
- * @brief
- * @param stream
+ * @brief split the name into tokens, hashing each one as we go
+ *
+ * Multi-byte UTF-8 characters are folded to lower case, and latin letters are
+ * hashed without their diacritics, so 'MÚSICA' hashes the same as 'musica'.
+ * Most names are plain ASCII, which a vector check spots up front, so they're
+ * tokenized without looking for sequences to decode. Otherwise each sequence
+ * is checked as it's decoded, and a name that turns out not to be valid UTF-8
+ * is scanned again, as a sequence of bytes, as before.
+ *
  * @param name
- * @return
+ * @param length    of the name, not counting the terminating nul
+ * @param tokens
  */
-tChannel * processChannelName( const char * name, tGroup * group )
+void tokenizeName( const char * name, size_t length, tNameTokens * tokens )
 {
-    tChannel * channel = newChannel();
-    if ( channel != NULL )
+    if ( utf8IsAscii( name, length ) )
     {
-        // fprintf( stderr, "channel: %p name: %s\n", channel, name );
-        channel->group = group;
-        processName( name, &channel->common );
-        inheritGroup( channel, group );
+        scanName( name, tokens, false );
+    }
+    else if ( ! scanName( name, tokens, true ) )
+    {
+        scanName( name, tokens, false );
+    }
+}
+
+/**
+ * @brief phraseScan() callback - remember the longest phrase starting at each token
+ * @param match
+ * @param udata
+ */
+void longestPhrase( const tPhraseMatch * match, void * udata )
+{
+    tNameTokens * tokens = (tNameTokens *)udata;
+
+    if ( match->count > tokens->phrase[ match->first ].count )
+    {
+        tokens->phrase[ match->first ].count = match->count;
+        tokens->phrase[ match->first ].tag   = match->tag;
+    }
+}
 
-        /* Let's see if we already have a matching channel */
-        tChannel ** chan = btree_get( global.tree.channel, &channel );
+/**
+ * @brief append a token to the name being built, capitalizing it, followed by a separator
+ * @param dp
+ * @param end
+ * @param tokens
+ * @param i
+ * @return
+ */
+char * appendToken( char * dp, const char * end, tNameTokens * tokens, unsigned int i )
+{
+    const char * q     = &tokens->text[ tokens->token[ i ].start ];
+    const char * qEnd  = q + tokens->token[ i ].length;
+    unsigned int alpha = tokens->token[ i ].alpha;
+    bool         first = true;
 
-        if ( chan == NULL )
+    while ( q < qEnd && dp < end - 4 )
+    {
+        if ( tokens->utf8 && (unsigned char)*q >= 0x80 )
         {
-            if ( btree_set( global.tree.channel, &channel ) == NULL )
+            tCodePoint cp;
+            q += utf8Decode( q, &cp );
+            if ( first )
             {
-                if  ( btree_oom( global.tree.channel ) )
-                {
-//                    fprintf( stderr, "channel btree_set() failed - out of memory\n" );
-                }
-                else {
-//                    fprintf( stderr, "new channel added: %s\n", channel->common.name );
-                }
+                cp = utf8ToUpper( cp );
             }
-            else
+            if ( utf8IsAlpha( cp ) && alpha > 3 )
             {
-                fprintf( stderr, "### error: channel replaced: %s\n", channel->common.name );
+                first = false;
             }
+            dp += utf8Encode( cp, dp );
         }
         else
         {
-            /* group already exists, so discard the local one */
-            freeChannel( channel );
-            /* and switch to the existing one */
-            channel = *chan;
-//            fprintf( stderr, "existing channel: %s\n", channel->common.name );
+            char c = *q++;
+            if ( first )
+            {
+                c = asciiToUpper( c );
+            }
+            if ( asciiIsAlpha( c ) && alpha > 3 )
+            {
+                first = false;
+            }
+            *dp++ = c;
         }
     }
-
-    return channel;
+    if ( dp < end - 1 )
+    {
+        *dp++ = ' ';
+    }
+    return dp;
 }
 
 /**
  * @brief
  * @param name
- * @return
+ * @param common
  */
-tGroup * processGroupName( const char * name )
+void processName( const char * name, tCommon * common )
 {
-    tGroup * group = newGroup();
-    if ( group != NULL )
+    tNameTokens   tokens;
+    char *        dp;
+    char          temp[256];
+    const char *  end = &temp[ sizeof( temp ) ];
+
+    /* first extract any attributes embedded in the channel name,
+     * tags like 'VIP', 'UK', 'HD', etc. See name.hash */
+
+    size_t length = ( name != NULL ) ? strlen( name ) : 0;
+    if ( length == 0 )
     {
-        // fprintf( stderr, "  group: %p name: %s\n", group, name );
-        processName( name, &group->common );
+        coldOf( common )->name = strdup( "(none)" );
+        return;
+    }
+
+    tokenizeName( name, length, &tokens );
+    if ( global.phrases != NULL )
+    {
+        phraseScan( global.phrases, tokens.hash, tokens.count, longestPhrase, &tokens );
+    }
+
+    dp = temp;
+    unsigned int span;
+    for ( unsigned int i = 0; i < tokens.count; i += span )
+    {
+        tKeywordMatch match;
+
+        /* a multi-word phrase takes precedence over the individual words within it */
+        if ( tokens.phrase[ i ].count > 0 )
+        {
+            matchPhrase( &multiWordPhrases[ tokens.phrase[ i ].tag ], &match );
+            span = tokens.phrase[ i ].count;
+        }
+        else
+        {
+            matchWord( tokens.hash[ i ], &match );
+            span = 1;
+        }
+
+        if ( processCommonMatch( &match, common ) )
+        {
+            /* swallow the string */
+            continue;
+        }
+
+        if ( match.capitalization != kCapitalizationUnset )
+        {
+            const char * p = lookupCapitalizationAsString[ match.capitalization ];
+            size_t len = strlen( p );
+            if ( dp + len + 1 < end )
+            {
+                dp = stpcpy( dp, p );
+                *dp++ = ' ';
+            }
+        }
+        else
+        {
+            for ( unsigned int j = i; j < i + span; ++j )
+            {
+                dp = appendToken( dp, end, &tokens, j );
+            }
+        }
+    }
 
-        /* Let's see if we already have a matching group */
-        tGroup ** grp = btree_get( global.tree.group, &group );
+    /* nuke the trailing space, if there is one */
+    if ( dp > temp && dp[-1] == ' ' )
+    {
+        --dp;
+    }
+    *dp = '\0';
 
-        if ( grp != NULL)
+    /* if we extracted a country, append it to the name */
+    if ( common->country != kCountryUnset )
+    {
+        int len = strlen( temp );
+        if ( len != 0 )
         {
-            /* group already exists, so discard the local one */
-            freeGroup( group );
-            /* and switch to the existing one */
-            group = *grp;
-//            fprintf( stderr, "group exists: %s\n", group->common.name );
+            snprintf( &temp[ len ], sizeof( temp ) - len, " (%s)", lookupCountryAsString[ common->country ] );
         }
         else
         {
-            /* didn't find it, so add new group */
-            if ( btree_set( global.tree.group, &group ) == NULL)
+            const char * fullCountry = lookupFullCountryAsString[ common->country ];
+            if ( fullCountry != NULL )
             {
-                if  ( btree_oom( global.tree.group ) )
+                strncpy( temp, fullCountry, sizeof(temp) );
+                if ( common->genre == kGenreUnset )
                 {
-                    fprintf( stderr, "group btree_set() failed - out of memory\n" );
-                }
-                else {
-//                    fprintf( stderr, "new group added: %s\n", group->common.name );
+                    common->genre = kGenreCountry;
                 }
             }
-            else
+        }
+    }
+
+    if ( common->resolution != kResolutionUnset )
+    {
+        int len = strlen( temp );
+        snprintf( &temp[ len ], sizeof( temp ) - len, " [%s]",
+                  lookupResolutionAsString[ common->resolution ] );
+    }
+
+    coldOf( common )->name = strdup( temp );
+}
+
+/**
+ * @brief the identity of a channel or group: a fingerprint of the same fields
+ *        compareChannels() and compareGroups() test for equality. The country's
+ *        symbol is hashed rather than its index, so the fingerprint stays the
+ *        same if country.hash is re-ordered.
+ * @param common
+ * @return
+ */
+tFingerprint fingerprintCommon( const tCommon * common )
+{
+    const char * country = lookupCountryAsString[ common->country ];
+    const char * name    = nameOf( common );
+
+    if ( country == NULL )
+    {
+        country = "";
+    }
+    return fingerprint( name, strlen( name ), fingerprint( country, strlen( country ), 0 ) );
+}
+
+/**
+ * @brief
+ * @param name
+ * @return
+ */
+tChannel * processChannelName( const char * name )
+{
+    tChannel * channel = newChannel();
+    if ( channel != NULL )
+    {
+        // fprintf( stderr, "channel: %p name: %s\n", channel, name );
+        processName( name, &channel->common );
+    }
+
+    return channel;
+}
+
+/* an entry's contributions to the channel it indexes as */
+typedef struct {
+    tGroup *          group;
+    tStream *         stream;   /* may be NULL. Set to NULL once the channel owns it */
+} tChannelMerge;
+
+/**
+ * @brief shardGetOrInsert() callback: fold an entry into the indexed channel,
+ *        which may be the entry's own. Called with the channel's shard locked.
+ * @param stored    the indexed channel
+ * @param item      the entry's channel
+ * @param inserted  the entry's channel is the indexed one
+ * @param udata     the tChannelMerge
+ */
+void mergeChannel( void * stored, const void * item, bool inserted, void * udata )
+{
+    tChannelMerge * merge    = udata;
+    tChannel *      existing = *(tChannel **)stored;
+    tChannel *      channel  = *(tChannel * const *)item;
+    tStream *       stream   = merge->stream;
+
+    if ( ! inserted )
+    {
+        /* the most recent entry's attributes win */
+        tCold * cold = coldOf( &channel->common );
+        tCold * keep = coldOf( &existing->common );
+        internRelease( global.strings, keep->xui );
+        internRelease( global.strings, keep->id );
+        internRelease( global.strings, keep->logo );
+        internRelease( global.strings, keep->number );
+        internRelease( global.strings, keep->extra );
+        keep->xui    = cold->xui;
+        keep->id     = cold->id;
+        keep->logo   = cold->logo;
+        keep->number = cold->number;
+        keep->extra  = cold->extra;
+        cold->xui = cold->id = cold->logo = cold->number = cold->extra = NULL;
+        if ( merge->group != NULL )
+        {
+            existing->group = merge->group;
+        }
+    }
+
+    if ( stream != NULL )
+    {
+        inheritChannel( stream, existing );
+
+        if ( global.hosts != NULL && stream->host != kHostUnset )
+        {
+            bool      newChannel = true;
+            tStream * data       = streamsData( &existing->streams );
+            for ( uint32_t i = 0; i < existing->streams.count && newChannel; ++i )
             {
-                fprintf( stderr, "### error: group replaced: %s\n", group->common.name );
+                newChannel = ( data[ i ].host != stream->host );
             }
+            hostTally( global.hosts, stream->host, newChannel, stream->isVIP, stream->resolution );
+        }
+
+        if ( insertStream( &existing->streams, stream ) )
+        {
+            /* the channel owns it now */
+            merge->stream = NULL;
         }
     }
 
+#if 1
+    existing->common.disabled = isChannelDisabled( existing );
+#endif
+}
+
+/**
+ * @brief find the channel in the index, adding it if it's not already there,
+ *        and give it the entry's stream. Both are done with the channel's shard
+ *        locked, so this may be called from several threads.
+ * @param channel
+ * @param group
+ * @param stream    may be NULL. Set to NULL if the channel took it.
+ * @return the indexed channel, which may not be the one passed in
+ */
+tChannel * indexChannel( tChannel * channel, tGroup * group, tStream ** stream )
+{
+    tChannelMerge merge = { group, *stream };
+
+    channel->group = group;
+    inheritGroup( channel, group );
+
+    /* the country may have just been inherited, so this can't be done any earlier */
+    channel->fingerprint = fingerprintCommon( &channel->common );
+
+    /* Let's see if we already have a matching channel, adding this one if not */
+    bool       inserted;
+    tChannel * indexed = channel;
+
+    if ( ! shardGetOrInsert( global.index.channel, &indexed, mergeChannel, &merge, &inserted ) )
+    {
+        fprintf( stderr, "channel index insert failed - out of memory\n" );
+        freeChannel( channel );
+        indexed = NULL;
+    }
+    else if ( ! inserted )
+    {
+        /* channel already exists, so discard the local one */
+        freeChannel( channel );
+    }
+
+    *stream = merge.stream;
+    return indexed;
+}
+
+/**
+ * @brief
+ * @param name
+ * @return
+ */
+tGroup * processGroupName( const char * name )
+{
+    tGroup * group = newGroup();
+    if ( group != NULL )
+    {
+        // fprintf( stderr, "  group: %p name: %s\n", group, name );
+        group->originalName = strdup( name );
+        processName( name, &group->common );
+        group->fingerprint = fingerprintCommon( &group->common );
+    }
+
     return group;
 }
 
+/**
+ * @brief find the group in the index, adding it if it's not already there
+ * @param group
+ * @return the indexed group, which may not be the one passed in
+ */
+tGroup * indexGroup( tGroup * group )
+{
+    /* Let's see if we already have a matching group, adding this one if not */
+    bool     inserted;
+    tGroup * indexed = group;
+
+    /* a group never changes once it's indexed, so there's nothing to merge */
+    group->common.disabled = isGroupDisabled( group );
+    if ( ! shardGetOrInsert( global.index.group, &indexed, NULL, NULL, &inserted ) )
+    {
+        fprintf( stderr, "group index insert failed - out of memory\n" );
+        indexed = group;
+    }
+    else if ( ! inserted )
+    {
+        /* group already exists, so discard the local one */
+        freeGroup( group );
+//        fprintf( stderr, "group exists: %s\n", nameOf( &indexed->common ) );
+    }
+
+    return indexed;
+}
+
 /**
  * @brief convert tvg_id into a legal identifier
  * @param tvg_id
@@ -1196,29 +1948,40 @@ char * tvgidToIdentifier( const char * tvg_id )
 
 #undef DEBUG_FIELDS
 
+/* the most bytes of unknown attributes passed through for one entry */
+#define kMaxPassthrough 1024
+
 /**
- * @brief
- * @param inputFile
- * @return
+ * @brief parse and classify one entry. Doesn't touch the indexes, so may run on any thread:
+ *        the string pool, host table and tallies it does share are safe to use from several.
+ * @param p
+ * @param parser  the calling thread's
+ * @return the group, channel and stream described by the entry, not yet indexed
  */
-void importM3Uentry( const char * p )
+tEntry * parseM3Uentry( const char * p, tParser * parser )
 {
     const char * xui_id 	 = NULL;
     const char * tvg_id 	 = NULL;
     const char * tvg_name 	 = NULL;
-    const char * tvg_type 	 = NULL;
     const char * tvg_logo 	 = NULL;
     const char * group_title = NULL;
+    const char * tvg_chno    = NULL;
     const char * url 		 = NULL;
-
-    tGroup   * group   = NULL;
-    tChannel * channel = NULL;
-    tStream  * stream  = NULL;
+    size_t       urlLength   = 0;
+    char         extra[ kMaxPassthrough ];
+    size_t       extraLength = 0;
+    bool         dropped     = false;
 
     const char * keyStart = p;
     tHash hash = 0;
     const char * valueStart;
 
+    tEntry * entry = calloc( 1, sizeof( tEntry ) );
+    if ( entry == NULL )
+    {
+        return NULL;
+    }
+
     for ( ; *p != '\0'; ++p )
     {
         tMappedChar w = remapChar( gKeywordCharMap, *p );
@@ -1235,7 +1998,13 @@ void importM3Uentry( const char * p )
 
         case kKeywordAssign:
             {
-                char * key = strndup( keyStart, p - keyStart );
+                const char * key = keyStart;
+                while ( key < p && *key == ' ' )
+                {
+                    /* follows an unquoted value */
+                    ++key;
+                }
+                size_t keyLength = p - key;
 
                 ++p; /* skip over the equals sign */
                 if ( *p == '"' )
@@ -1259,27 +2028,71 @@ void importM3Uentry( const char * p )
                     while ( *p != ' ' && *p != '\0' ) { ++p; }
                 }
 
-                char * value = strndup( valueStart, p - valueStart );
+                size_t length = p - valueStart;
 
 #ifdef DEBUG_FIELDS
-                fprintf( stderr, "key: \'%s\', value: \'%s\'\n", key, value );
+                fprintf( stderr, "key: \'%.*s\', value: \'%.*s\'\n", (int)keyLength, key, (int)length, valueStart );
 #endif
+                /* ids, logos and URLs repeat across many entries, so are interned rather than copied */
                 switch ( findHash( mapKeywordSearch, hash ))
                 {
-                case kKeywordXUI:    xui_id = value;       break;
-                case kKeywordID:     tvg_id = value;       break;
-                case kKeywordName:   tvg_name = seperatePlus1((char *)value );  break;
-                case kKeywordType:   tvg_type = value;     break;
-                case kKeywordLogo:   tvg_logo = value;     break;
-                case kKeywordGroup:  group_title = value;  break;
-                case kKeywordURL:    url = value;          break;
+                case kKeywordXUI:
+                    internRelease( global.strings, xui_id );
+                    xui_id = internString( global.strings, valueStart, length );
+                    break;
+
+                case kKeywordID:
+                    internRelease( global.strings, tvg_id );
+                    tvg_id = internString( global.strings, valueStart, length );
+                    break;
+
+                case kKeywordLogo:
+                    internRelease( global.strings, tvg_logo );
+                    tvg_logo = internString( global.strings, valueStart, length );
+                    break;
+
+                case kKeywordName:
+                    free( (void *)tvg_name );
+                    tvg_name = seperatePlus1( strndup( valueStart, length ) );
+                    break;
+
+                case kKeywordType:   /* not used */                                break;
+
+                case kKeywordGroup:
+                    free( (void *)group_title );
+                    group_title = strndup( valueStart, length );
+                    break;
+
+                case kKeywordURL:    url = valueStart; urlLength = length;         break;
+
+                case kKeywordNumber:
+                    internRelease( global.strings, tvg_chno );
+                    tvg_chno = internString( global.strings, valueStart, length );
+                    break;
 
                 default:
-                    fprintf( stderr, "Warning: unknown field \'%s\'\n", key );
+                    {
+                        /* kept exactly as given, closing quote and all, to be written back out */
+                        size_t span = ( *p == '"' ? p + 1 : p ) - key;
+                        if ( extraLength + 1 + span <= sizeof( extra ) )
+                        {
+                            extra[ extraLength++ ] = ' ';
+                            memcpy( &extra[ extraLength ], key, span );
+                            extraLength += span;
+                        }
+                        else if ( ! dropped )
+                        {
+                            dropped = true;
+                            parser->dropped++;
+                        }
+                        if ( global.unknownFields != NULL )
+                        {
+                            tallyAdd( global.unknownFields, key, keyLength, NULL, 0 );
+                        }
+                    }
                     break;
                 }
 
-                free( key );
                 keyStart = p;
                 hash = 0;
                 break;
@@ -1291,38 +2104,37 @@ void importM3Uentry( const char * p )
     /* post-process the fields, now that we have collected them all */
     if ( group_title != NULL)
     {
-        group = processGroupName( group_title );
+        entry->group = processGroupName( group_title );
+        free( (void *)group_title );
     }
     if ( tvg_name != NULL)
     {
-        channel = processChannelName( tvg_name, group );
-        if ( channel != NULL)
+        entry->channel = processChannelName( tvg_name );
+        free( (void *)tvg_name );
+        if ( entry->channel != NULL)
         {
-            channel->xui  = xui_id;
-            channel->id   = tvg_id;
-            channel->logo = tvg_logo;
-            if ( group != NULL )
+            tCold * cold = coldOf( &entry->channel->common );
+            cold->xui    = xui_id;
+            cold->id     = tvg_id;
+            cold->logo   = tvg_logo;
+            cold->number = tvg_chno;
+            if ( extraLength > 0 )
             {
-                channel->group = group;
+                /* providers repeat the same few (catchup, tvg-shift...) on every entry */
+                cold->extra = internString( global.strings, extra, extraLength );
             }
+            xui_id = tvg_id = tvg_logo = tvg_chno = NULL;
         }
     }
-    if ( channel != NULL && url != NULL)
+    /* release any that weren't handed over to a channel */
+    internRelease( global.strings, xui_id );
+    internRelease( global.strings, tvg_id );
+    internRelease( global.strings, tvg_logo );
+    internRelease( global.strings, tvg_chno );
+
+    if ( entry->channel != NULL && url != NULL)
     {
-        stream = processStream( url, channel );
-        /* insertion sort keeps higher resolution streams earlier in the list */
-        tStream  * strm;
-        tStream ** prev = &channel->stream;
-        for ( strm = channel->stream; strm != NULL; strm = strm->next )
-        {
-            if ( stream->resolution > strm->resolution )
-            {
-                stream->next = strm;
-                break;
-            }
-            prev = &strm->next;
-        }
-        *prev = stream;
+        entry->hasStream = processStream( &entry->stream, url, urlLength, NULL, parser );
     }
 
 #if 0
@@ -1334,34 +2146,97 @@ void importM3Uentry( const char * p )
             fprintf( stderr, "    \"%s,%s\", %*c /* %s */\n",
                      id_tvg, tvg_id,
                      (int)(60 - 2 * strlen(tvg_id)), ' ',
-                     channel->common.name );
+                     nameOf( &entry->channel->common ) );
             free( id_tvg );
         }
     }
 #endif
 
-#if 1
-    if ( group != NULL )
+    return entry;
+}
+
+/**
+ * @brief merge a parsed entry into the channel and group indexes. Entries are
+ *        merged with the index locked, but must be merged in input order for the
+ *        most recent entry's attributes to win.
+ * @param entry - consumed
+ */
+void indexM3Uentry( tEntry * entry )
+{
+    tGroup   * group   = NULL;
+    tStream  * stream  = entry->hasStream ? &entry->stream : NULL;
+
+    if ( entry->group != NULL )
     {
-        group->common.disabled = isGroupDisabled( group );
+        group = indexGroup( entry->group );
     }
-    if ( channel != NULL )
+    if ( entry->channel != NULL )
     {
-        channel->common.disabled = isChannelDisabled( channel );
+        indexChannel( entry->channel, group, &stream );
     }
-#endif
+    if ( stream != NULL )
+    {
+        releaseStream( stream );
+    }
+
+    free( entry );
 }
 
 /**
- * @brief parse the M3U file into a linked list of tEntry structures
- * @param inputFile
+ * @brief free a parsed entry without merging it into the indexes
+ * @param entry - consumed
  */
-int importM3U( FILE * inputFile )
+void discardEntry( tEntry * entry )
 {
-    int result = 0;
-    static char buffer[32768];
-    char * p;
-
+    if ( entry->hasStream )
+    {
+        releaseStream( &entry->stream );
+    }
+    freeChannel( entry->channel );
+    freeGroup( entry->group );
+    free( entry );
+}
+
+/**
+ * @brief add what a thread counted while it parsed entries to the totals
+ * @param parser
+ */
+void endParser( const tParser * parser )
+{
+    if ( global.probes != NULL )
+    {
+        probesAddCounts( global.probes, &parser->probes );
+    }
+    atomic_fetch_add( &global.droppedFields, parser->dropped );
+}
+
+/**
+ * @brief
+ * @param p
+ * @param parser
+ */
+void importM3Uentry( const char * p, tParser * parser )
+{
+    tEntry * entry = parseM3Uentry( p, parser );
+    if ( entry != NULL )
+    {
+        indexM3Uentry( entry );
+    }
+}
+
+/**
+ * @brief parse the M3U file into a linked list of tEntry structures
+ * @param inputFile
+ */
+int importM3U( FILE * inputFile )
+{
+    int result = 0;
+    static char buffer[32768];
+    char * p;
+    tParser parser;
+
+    memset( &parser, 0, sizeof( parser ) );
+
     while ( (p = fgets( buffer, sizeof( buffer ), inputFile )) != NULL && result == 0 )
     {
         trimTrailingEOL( p );
@@ -1383,7 +2258,7 @@ int importM3U( FILE * inputFile )
             if ( url != NULL)
             {
                 trimAppendQuote( &p[ l ] );
-                importM3Uentry( p );
+                importM3Uentry( p, &parser );
             } else
             {
                 result = errno;
@@ -1399,24 +2274,148 @@ int importM3U( FILE * inputFile )
         result = errno;
         fprintf( stderr, "### read failure (%d: %s)\n", errno, strerror(errno));
     }
+    endParser( &parser );
 
     return result;
 }
 
-long findTMSID( const char * name )
+#define kUSStationCount     ( sizeof( USStationData ) / sizeof( USStationData[0] ) )
+
+/**
+ * @brief note the TMS ID for a mapping row's callsign, if it's a station we recognize.
+ *        The whole callsign is the key, so a subchannel such as WCBS-DT2 isn't taken
+ *        for the station's main channel
+ */
+void indexMappingCallsign( const char * name, size_t nameLength,
+                           const char * callsign, size_t callsignLength,
+                           long id, void * udata )
+{
+    long * callsignTMS = udata;
+    tHash  hash = 0;
+
+    (void)name;
+    (void)nameLength;
+
+    /* hashed the same way as a word of a channel name, so it matches the same keywords */
+    for ( size_t i = 0; i < callsignLength; ++i )
+    {
+        tMappedChar mappedC = remapChar( gNameCharMap, callsign[ i ] );
+        if ( mappedC != kNameSeparator && mappedC != '\0' )
+        {
+            hash = hashChar( hash, mappedC );
+        }
+    }
+
+    tIndex station = findHash( mapUSCallsignSearch, hash );
+    if ( station != kIndexUnset && station < kUSStationCount )
+    {
+        if ( callsignTMS[ station ] != 0 && callsignTMS[ station ] != id )
+        {
+            fprintf( stderr, "Warning: callsign \'%.*s\' has TMS IDs %ld and %ld, using %ld\n",
+                     (int)callsignLength, callsign, callsignTMS[ station ], id, id );
+        }
+        /* as with names, the last row wins */
+        callsignTMS[ station ] = id;
+    }
+}
+
+/**
+ * @brief build the array that maps a tUSCallsignIndex straight to a TMS ID
+ * @return 0, or -ENOMEM
+ */
+int indexCallsigns( void )
 {
-    long result = 0;
-    tTMSChannel tmschan;
-    tmschan.name = name;
-    if ( global.tree.mapping != NULL )
+    free( global.callsignTMS );
+    global.callsignTMS = calloc( kUSStationCount, sizeof( long ) );
+    if ( global.callsignTMS == NULL )
     {
-        tTMSChannel * found  = (tTMSChannel *)btree_get( global.tree.mapping, &tmschan );
+        return -ENOMEM;
+    }
+    mappingForEach( global.mapping, indexMappingCallsign, global.callsignTMS );
+
+    return 0;
+}
+
+/**
+ * @brief a channel is looked up by name, and a recognized US station that isn't
+ *        in the mapping by name is then looked up by its callsign
+ * @param channel
+ * @return the channel's TMS ID, or 0 if the mapping doesn't have it
+ */
+long findTMSID( const tChannel * channel )
+{
+    const char * name  = nameOf( &channel->common );
+    long         tmsid = mappingFind( global.mapping, name, strlen( name ) );
 
-        if ( found != NULL)
-            result = found->id;
+    uint16_t station = channel->common.usStation;
+    if ( tmsid == 0 && station != kUSCallsignUnset && global.callsignTMS != NULL && station < kUSStationCount )
+    {
+        tmsid = global.callsignTMS[ station ];
     }
+    return tmsid;
+}
 
-    return result;
+#define kChannelNumberMax   99999
+
+/**
+ * @brief the channel's number, from the range for its group if it hasn't been given one before
+ * @param channel
+ * @return the number, or 0 if the channels aren't being numbered or the range is full
+ */
+uint32_t channelNumber( const tChannel * channel )
+{
+    if ( global.numbering.table == NULL )
+    {
+        return 0;
+    }
+
+    const char * title = nameOf( &channel->group->common );
+    unsigned int range = global.numbering.fallback;
+
+    for ( unsigned int i = 0; i < global.numbering.count; ++i )
+    {
+        if ( title != NULL && fnmatch( global.numbering.pattern[ i ], title, FNM_CASEFOLD ) == 0 )
+        {
+            range = global.numbering.range[ i ];
+            break;
+        }
+    }
+    return numberingAssign( global.numbering.table, channel->fingerprint, range );
+}
+
+/**
+ * @brief give the channel its number before it's written. Only ever called from
+ *        one thread at a time, in export order, so the same channels get the same
+ *        numbers from run to run
+ * @param channel
+ */
+void numberChannel( tChannel * channel )
+{
+    coldOf( &channel->common )->numbered = channelNumber( channel );
+}
+
+bool numberKeptChannel( const void * item, void * udata )
+{
+    (void)udata;
+
+    tChannel * channel = *(tChannel **)item;
+
+    if ( ! channel->common.disabled && ! channel->group->common.disabled )
+    {
+        numberChannel( channel );
+    }
+    return true;
+}
+
+/**
+ * @brief number every channel the filters keep, in export order
+ */
+void numberKeptChannels( void )
+{
+    if ( global.numbering.table != NULL )
+    {
+        shardAscend( global.index.channel, numberKeptChannel, NULL );
+    }
 }
 
 /**
@@ -1429,227 +2428,2767 @@ void exportChannel( FILE * output, tChannel * channel )
 #if 0
     dumpGroup( output, channel->group );
     dumpChannel( output, channel );
-    dumpStreams( output, channel->stream );
+    dumpStreams( output, &channel->streams );
 #else
     fprintf( output, "#EXTINF:-1");
 
-    if (channel->xui != NULL) {
-        fprintf( output, " xui_id=\"%s\"", channel->xui);
+    tCold * cold = coldOf( &channel->common );
+
+    if (cold->xui != NULL) {
+        fprintf( output, " xui_id=\"%s\"", cold->xui);
     }
-    long tmsid = findTMSID( channel->common.name );
+    long tmsid = findTMSID( channel );
     if ( tmsid != 0 )
     {
         fprintf( output, " tvc-guide-stationid=%ld", tmsid );
     }
+    if ( cold->numbered != 0 )
+    {
+        fprintf( output, " tvg-chno=\"%u\"", cold->numbered );
+    }
+    else if ( cold->number != NULL && global.numbering.table == NULL )
+    {
+        /* when we're numbering the channels, the provider's numbers could clash with ours */
+        fprintf( output, " tvg-chno=\"%s\"", cold->number );
+    }
 
     fprintf( output, " tvg-id=\"%s\" tvg-name=\"%s\" tvg-logo=\"%s\" group-title=\"%s\"",
-             channel->id, channel->common.name, channel->logo, channel->group->common.name);
+             cold->id, cold->name, cold->logo, nameOf( &channel->group->common ));
+    if ( cold->extra != NULL )
+    {
+        fputs( cold->extra, output );
+    }
 
-    fprintf( output, ",%s\n", channel->common.name);
+    fprintf( output, ",%s\n", cold->name);
 
-    fprintf( output, "%s\n", channel->stream->url);
+    tStream * stream = headStream( channel );
+    fprintf( output, "%s%s\n", stream->url.prefix, stream->url.suffix );
 #endif
 }
 
 
-bool interateChannel( const void * item, void * udata )
+/**
+ * @brief choose which of the split outputs a channel belongs in
+ * @param channel
+ * @param slot      set to a small number that identifies the output
+ * @param label     set to the name of the output
+ */
+void splitSlot( const tChannel * channel, unsigned int * slot, const char ** label )
+{
+    const tCommon * common = &channel->common;
+
+    switch ( global.split.key )
+    {
+    case kSplitCountry:
+        *slot  = common->country;
+        *label = lookupCountryAsString[ common->country ];
+        break;
+
+    case kSplitGenre:
+        *slot  = common->genre;
+        *label = lookupGenreAsString[ common->genre ];
+        break;
+
+    case kSplitRegion:
+        *slot  = common->region;
+        *label = lookupRegionAsString[ common->region ];
+        break;
+
+    case kSplitDMA:
+        *slot = kNielsenDMAUnset;
+        if ( common->usStation != kUSCallsignUnset && common->usStation < kUSStationCount )
+        {
+            *slot = USStationData[ common->usStation ].nielsenDMAIdx;
+        }
+        *label = lookupNielsenDMAAsString[ *slot ];
+        break;
+
+    case kSplitGroup:
+        {
+            const char * title = nameOf( &channel->group->common );
+            unsigned int i;
+
+            for ( i = 0; i < global.split.patternCount; ++i )
+            {
+                if ( title != NULL && fnmatch( global.split.pattern[ i ], title, FNM_CASEFOLD ) == 0 )
+                {
+                    break;
+                }
+            }
+            *slot  = i;
+            *label = i < global.split.patternCount ? global.split.pattern[ i ] : "other";
+        }
+        break;
+
+    default:
+        *slot  = 0;
+        *label = "all";
+        break;
+    }
+}
+
+#define kScoreMaxStreams    8
+
+/**
+ * @brief rank a channel for --top, by the weighted sum of its attributes
+ * @param channel
+ * @return
+ */
+int64_t scoreChannel( tChannel * channel )
+{
+    const tCommon * common = &channel->common;
+    int64_t         score  = 0;
+
+    score += (int64_t)global.top.weight.resolution * common->resolution;
+    score += (int64_t)global.top.weight.language   * ( global.top.language != kLanguageUnset
+                                                      && common->language == global.top.language );
+    score += (int64_t)global.top.weight.affiliate  * ( common->affiliate != kAffiliateUnset );
+    score += (int64_t)global.top.weight.streams    * min( channel->streams.count, kScoreMaxStreams );
+    if ( global.top.weight.tms != 0 )
+    {
+        score += (int64_t)global.top.weight.tms * ( findTMSID( channel ) != 0 );
+    }
+    return score;
+}
+
+/**
+ * @brief write a channel to the output, or to its split output if splitting,
+ *        noting it in the snapshot if the output is being compared with the last run
+ * @param output
+ * @param channel
+ */
+void writeChannel( FILE * output, tChannel * channel )
+{
+    if ( global.split.output != NULL )
+    {
+        unsigned int slot;
+        const char * label;
+
+        splitSlot( channel, &slot, &label );
+        output = splitOutput( global.split.output, slot, label );
+    }
+    if ( output == NULL )
+    {
+        return;
+    }
+    if ( global.delta.current == NULL )
+    {
+        exportChannel( output, channel );
+        return;
+    }
+
+    /* hash the #EXTINF line and the stream URL as written, so any change that shows downstream is seen */
+    rewind( global.delta.render );
+    exportChannel( global.delta.render, channel );
+    fflush( global.delta.render );
+
+    const char * text   = global.delta.buffer;
+    size_t       length = ftell( global.delta.render );
+    const char * eol    = memchr( text, '\n', length );
+    size_t       extinf = eol != NULL ? (size_t)(eol - text) + 1 : length;
+    const char * name   = nameOf( &channel->common );
+
+    fwrite( text, 1, length, output );
+    if ( ! snapshotAdd( global.delta.current, channel->fingerprint,
+                        fingerprint( text, extinf, 0 ), fingerprint( text + extinf, length - extinf, 0 ),
+                        name, strlen( name ) ) )
+    {
+        global.delta.failed = true;
+    }
+}
+
+/**
+ * @brief the playlist header, written once however many inputs go into the output
+ * @param output
+ */
+void beginPlaylist( FILE * output )
+{
+    if ( ! global.output.started )
+    {
+        fprintf( output, "#EXTM3U\n" );
+        global.output.started = true;
+    }
+}
+
+/**
+ * @brief start an export: write the playlist header, unless the channels are
+ *        being split across several files, and start ranking them if asked to
+ * @param output
+ * @return 0, or -ENOMEM if there isn't room to rank the channels
+ */
+int beginExport( FILE * output )
+{
+    if ( global.split.output == NULL )
+    {
+        beginPlaylist( output );
+    }
+    if ( global.top.k > 0 )
+    {
+        global.top.heap = topkNew( global.top.k );
+        if ( global.top.heap == NULL )
+        {
+            fprintf( stderr, "### unable to rank the top %zu channels\n", global.top.k );
+            return -ENOMEM;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief a kept channel is written straight away, unless only the top channels are wanted
+ * @param output
+ * @param channel
+ */
+void exportKeptChannel( FILE * output, tChannel * channel )
+{
+    if ( global.top.heap != NULL )
+    {
+        topkOffer( global.top.heap, scoreChannel( channel ), channel );
+    }
+    else
+    {
+        writeChannel( output, channel );
+    }
+}
+
+bool numberRanked( void * item, int64_t score, void * udata )
+{
+    (void)score;
+    (void)udata;
+    numberChannel( item );
+    return true;
+}
+
+bool exportRanked( void * item, int64_t score, void * udata )
+{
+    (void)score;
+    writeChannel( udata, item );
+    return true;
+}
+
+/**
+ * @brief finish an export, writing the top channels, if they were being ranked
+ * @param output
+ */
+void endExport( FILE * output )
+{
+    if ( global.top.heap != NULL )
+    {
+        global.top.offered   = topkOffered( global.top.heap );
+        global.top.threshold = topkThreshold( global.top.heap );
+        if ( global.numbering.table != NULL )
+        {
+            /* only the channels that made the cut are numbered */
+            topkForEach( global.top.heap, numberRanked, NULL );
+        }
+        topkForEach( global.top.heap, exportRanked, output );
+        topkFree( global.top.heap );
+        global.top.heap = NULL;
+    }
+}
+
+bool interateChannel( const void * item, void * udata )
+{
+    FILE *     output  = udata;
+    tChannel * channel = *(tChannel **)item;
+
+    // fprintf( stderr, "%d %d %s\n", channel->common.disabled, channel->group->common.disabled, nameOf( &channel->common ) );
+    if (! channel->common.disabled && ! channel->group->common.disabled )
+    {
+        exportKeptChannel( output, channel );
+    }
+
+    return true;
+}
+
+bool interateGroup( const void * item, void * udata )
+{
+    (void)udata;
+
+    tGroup * group = *(tGroup **)item;
+
+    fprintf( stderr, "%d \'%s\',\'%s\' [%s] (%s)\n",
+             group->common.disabled,
+             group->originalName,
+             nameOf( &group->common ),
+             lookupGenreAsString[ group->common.genre ],
+             lookupTypeAsString[ group->common.type ] );
+
+    return true;
+}
+
+/**
+ * @brief
+ * @param output
+ * @return 0, or a negative errno
+ */
+int exportM3U( FILE * output )
+{
+    int result = beginExport( output );
+    if ( result != 0 )
+    {
+        return result;
+    }
+    if ( global.top.k == 0 )
+    {
+        numberKeptChannels();
+    }
+    shardAscend( global.index.channel, interateChannel, output );
+    endExport( output );
+    //shardAscend( global.index.group,   interateGroup,   NULL );
+
+    return 0;
+}
+
+typedef struct {
+    tCatalog *   catalog;
+    tChannel **  channel;   /* the channel for each row */
+    size_t       row;
+} tCatalogBuild;
+
+bool catalogChannel( const void * item, void * udata )
+{
+    tCatalogBuild * build   = udata;
+    tCatalog *      catalog = build->catalog;
+    tChannel *      channel = *(tChannel **)item;
+    tCommon *       common  = &channel->common;
+    size_t          row     = build->row++;
+    uint8_t         flags   = 0;
+
+    if ( common->isPlus1 )                      flags |= kCatalogFlagPlus1;
+    if ( common->isVIP )                        flags |= kCatalogFlagVIP;
+    tStream *       stream  = headStream( channel );
+
+    if ( stream == NULL || stream->isFile )     flags |= kCatalogFlagNoStream;
+    if ( channel->group->common.disabled )      flags |= kCatalogFlagGroupOff;
+
+    build->channel[ row ]        = channel;
+    catalog->country[ row ]      = common->country;
+    catalog->genre[ row ]        = common->genre;
+    catalog->language[ row ]     = common->language;
+    catalog->resolution[ row ]   = stream != NULL ? stream->resolution : 0;
+    catalog->city[ row ]         = common->city;
+    catalog->type[ row ]         = common->type;
+    catalog->flags[ row ]        = flags;
+    catalog->station[ row ]      = common->usStation;
+
+    return true;
+}
+
+static double elapsedMS( const struct timespec * start, const struct timespec * end )
+{
+    return (double)(end->tv_sec - start->tv_sec) * 1e3 + (double)(end->tv_nsec - start->tv_nsec) / 1e6;
+}
+
+/**
+ * @brief make a columnar catalog of every channel in the index, in export order
+ * @param catalog
+ * @return the channel for each row of the catalog, or NULL if out of memory
+ */
+tChannel ** buildCatalog( tCatalog * catalog )
+{
+    tCatalogBuild build;
+    size_t        count = shardCount( global.index.channel );
+
+    if ( ! catalogInit( catalog, count ) )
+    {
+        fprintf( stderr, "### unable to allocate a catalog for %lu channels\n", count );
+        return NULL;
+    }
+
+    build.catalog = catalog;
+    build.channel = calloc( count + 1, sizeof( tChannel * ) );
+    build.row     = 0;
+    if ( build.channel == NULL )
+    {
+        catalogFree( catalog );
+        return NULL;
+    }
+
+    shardAscend( global.index.channel, catalogChannel, &build );
+
+    return build.channel;
+}
+
+/**
+ * @brief export the M3U by copying the channel index into a columnar catalog,
+ *        then selecting the channels to keep with the vectorized filter kernel
+ * @param output
+ * @param stats
+ * @return -ENOMEM if the catalog couldn't be allocated
+ */
+int exportM3UColumnar( FILE * output, bool stats )
+{
+    tCatalog      catalog;
+    tFilterPolicy policy;
+    tChannel **   channel = buildCatalog( &catalog );
+
+    if ( channel == NULL )
+    {
+        return -ENOMEM;
+    }
+
+    size_t     count     = catalog.count;
+    uint32_t * selection = calloc( count + 1, sizeof( uint32_t ) );
+    if ( selection == NULL )
+    {
+        free( channel );
+        catalogFree( &catalog );
+        return -ENOMEM;
+    }
+
+    initFilterPolicy( &policy );
+
+    struct timespec start, end;
+    clock_gettime( CLOCK_MONOTONIC, &start );
+    size_t selected = catalogFilter( &catalog, &policy, selection );
+    clock_gettime( CLOCK_MONOTONIC, &end );
+
+    int result = beginExport( output );
+    if ( result != 0 )
+    {
+        free( selection );
+        free( channel );
+        catalogFree( &catalog );
+        return result;
+    }
+    for ( size_t i = 0; i < selected && global.numbering.table != NULL && global.top.k == 0; ++i )
+    {
+        numberChannel( channel[ selection[ i ] ] );
+    }
+    for ( size_t i = 0; i < selected; ++i )
+    {
+        exportKeptChannel( output, channel[ selection[ i ] ] );
+    }
+    endExport( output );
+
+    if ( stats )
+    {
+        /* cross-check the kernel against the per-channel filter */
+        size_t mismatch = 0;
+        size_t next = 0;
+        for ( size_t row = 0; row < count; ++row )
+        {
+            tCommon * common = &channel[ row ]->common;
+            bool kept = ( next < selected && selection[ next ] == row );
+            next += kept;
+            mismatch += ( kept != ( ! common->disabled && ! channel[ row ]->group->common.disabled ) );
+        }
+        fprintf( stderr, "columnar: %lu of %lu channels selected in %.3f ms (%lu differ from the per-channel filter)\n",
+                 selected, count, elapsedMS( &start, &end ), mismatch );
+    }
+
+    free( selection );
+    free( channel );
+    catalogFree( &catalog );
+
+    return 0;
+}
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*
+ * Profiles: several differently filtered playlists from one run. The input is
+ * parsed and classified once, into a single catalog, then every profile's
+ * policy is applied to that catalog on its own thread, and each writes the
+ * channels it selects to its own file.
+ */
+
+typedef struct sProfile {
+    const char *       path;
+    tFilterPolicy      policy;
+
+    const tCatalog *   catalog;     /* shared by all the profiles */
+    tChannel * const * channel;
+    uint32_t *         selection;   /* the catalog rows the policy selects */
+    size_t             selected;
+    double             elapsed;     /* ms to filter and write */
+    int                result;
+} tProfile;
+
+/**
+ * @brief hash a rule value as if it were a word in a channel name, ignoring
+ *        any separators, so it matches the same keywords, spelled the same ways
+ * @param value
+ * @param length
+ * @return
+ */
+tHash hashRuleValue( const char * value, size_t length )
+{
+    tHash hash = 0;
+
+    for ( size_t i = 0; i < length; ++i )
+    {
+        tMappedChar mappedC = remapChar( gNameCharMap, value[ i ] );
+        if ( mappedC != kNameSeparator && mappedC != '\0' )
+        {
+            hash = hashChar( hash, mappedC );
+        }
+    }
+    return hash;
+}
+
+/**
+ * @brief find the index of a rule value in one of the keyword dictionaries
+ * @return the index, or kIndexUnset if the value isn't in the dictionary
+ */
+tIndex findRuleValue( const tRecord * dictionary, const char * value, size_t length )
+{
+    return findHash( dictionary, hashRuleValue( value, length ) );
+}
+
+tIndex findLanguage( const char * value, size_t length )
+{
+    for ( unsigned int i = 0; i < sizeof( lookupLanguageAsString ) / sizeof( lookupLanguageAsString[0] ); ++i )
+    {
+        const char * name = lookupLanguageAsString[ i ];
+        if ( name != NULL && strlen( name ) == length && strncasecmp( name, value, length ) == 0 )
+        {
+            return i;
+        }
+    }
+    return kIndexUnset;
+}
+
+/**
+ * @brief apply one 'key:value+value...' rule to a profile's policy
+ * @return false if the rule isn't valid
+ */
+bool parseRule( tFilterPolicy * policy, const char * rule, size_t length )
+{
+    const char * colon = memchr( rule, ':', length );
+
+    if ( colon == NULL )
+    {
+        if ( length == 7 && strncasecmp( rule, "default", 7 ) == 0 )
+        {
+            initFilterPolicy( policy );
+            return true;
+        }
+        return false;
+    }
+
+    size_t       keyLength = colon - rule;
+    const char * end       = rule + length;
+
+    for ( const char * value = colon + 1; value < end; )
+    {
+        const char * plus = memchr( value, '+', end - value );
+        size_t       len  = ( plus != NULL ? plus : end ) - value;
+        tIndex       index;
+
+#define isKey( key )   ( keyLength == sizeof( key ) - 1 && strncasecmp( rule, key, keyLength ) == 0 )
+
+        if ( isKey( "country" ) )
+        {
+            index = findRuleValue( mapCountrySearch, value, len );
+            if ( index == kIndexUnset || policy->keepCountryCount == kPolicyMaxValues ) return false;
+            policy->keepCountry[ policy->keepCountryCount++ ] = index;
+        }
+        else if ( isKey( "genre" ) )
+        {
+            index = findRuleValue( mapGenreSearch, value, len );
+            if ( index == kIndexUnset || policy->keepGenreCount == kPolicyMaxValues ) return false;
+            policy->keepGenre[ policy->keepGenreCount++ ] = index;
+        }
+        else if ( isKey( "nogenre" ) )
+        {
+            index = findRuleValue( mapGenreSearch, value, len );
+            if ( index == kIndexUnset || index >= 16 ) return false;
+            policy->rejectGenres |= (1u << index);
+        }
+        else if ( isKey( "language" ) )
+        {
+            index = findLanguage( value, len );
+            if ( index == kIndexUnset ) return false;
+            policy->language = index;
+        }
+        else if ( isKey( "resolution" ) )
+        {
+            index = findRuleValue( mapResolutionSearch, value, len );
+            if ( index == kIndexUnset ) return false;
+            policy->minResolution = index;
+        }
+        else if ( isKey( "local" ) )
+        {
+            /* 'country' or 'country/city' */
+            const char * slash = memchr( value, '/', len );
+            index = findRuleValue( mapCountrySearch, value, slash != NULL ? (size_t)(slash - value) : len );
+            if ( index == kIndexUnset || policy->keepLocalCount == kPolicyMaxValues ) return false;
+            policy->localGenre = kGenreLocal;
+            policy->keepLocal[ policy->keepLocalCount ].country = index;
+            policy->keepLocal[ policy->keepLocalCount ].city    = 0;
+            if ( slash != NULL )
+            {
+                index = findRuleValue( mapCitySearch, slash + 1, value + len - (slash + 1) );
+                if ( index == kIndexUnset ) return false;
+                policy->keepLocal[ policy->keepLocalCount ].city = index;
+            }
+            policy->keepLocalCount++;
+        }
+        else
+        {
+            return false;
+        }
+#undef isKey
+        value += len + 1;
+    }
+    return true;
+}
+
+/**
+ * @brief add a profile from a '<file>=<rule>,<rule>...' argument
+ * @param arg
+ * @return 0, or a negative errno
+ */
+int parseProfile( const char * arg )
+{
+    const char * equals = strchr( arg, '=' );
+
+    if ( equals == NULL || equals == arg )
+    {
+        fprintf( stderr, "### invalid profile \'%s\' (expected <file>=<rule>,...)\n", arg );
+        return -EINVAL;
+    }
+
+    tProfile * profile = realloc( global.profile, (global.profileCount + 1) * sizeof( tProfile ) );
+    char *     path    = malloc( equals - arg + 1 );
+    if ( profile == NULL || path == NULL )
+    {
+        free( path );
+        if ( profile != NULL ) global.profile = profile;
+        return -ENOMEM;
+    }
+    global.profile = profile;
+    profile = &global.profile[ global.profileCount ];
+    memset( profile, 0, sizeof( tProfile ) );
+
+    memcpy( path, arg, equals - arg );
+    path[ equals - arg ] = '\0';
+    profile->path = path;
+
+    /* just the structural rules to begin with: anything can be kept if it has a live stream */
+    profile->policy.rejectFlags = kCatalogFlagNoStream;
+    profile->policy.linearOnly  = true;
+
+    for ( const char * rule = equals + 1; *rule != '\0'; )
+    {
+        const char * comma  = strchr( rule, ',' );
+        size_t       length = comma != NULL ? (size_t)(comma - rule) : strlen( rule );
+
+        if ( length > 0 && ! parseRule( &profile->policy, rule, length ) )
+        {
+            fprintf( stderr, "### invalid rule \'%.*s\' in profile \'%s\'\n", (int)length, rule, path );
+            free( path );
+            return -EINVAL;
+        }
+        rule += length + ( comma != NULL );
+    }
+    global.profileCount++;
+
+    return 0;
+}
+
+/**
+ * @brief select the profile's channels from the shared catalog
+ * @param arg   the tProfile
+ * @return
+ */
+void * profileFilterStage( void * arg )
+{
+    tProfile *      profile = arg;
+    struct timespec start, end;
+
+    clock_gettime( CLOCK_MONOTONIC, &start );
+
+    profile->selection = calloc( profile->catalog->count + 1, sizeof( uint32_t ) );
+    if ( profile->selection == NULL )
+    {
+        profile->result = -ENOMEM;
+    }
+    else
+    {
+        profile->selected = catalogFilter( profile->catalog, &profile->policy, profile->selection );
+    }
+
+    clock_gettime( CLOCK_MONOTONIC, &end );
+    profile->elapsed = elapsedMS( &start, &end );
+
+    return NULL;
+}
+
+/**
+ * @brief write the channels the profile selected, with the numbers they've already been given
+ * @param arg   the tProfile
+ * @return
+ */
+void * profileWriteStage( void * arg )
+{
+    tProfile *      profile = arg;
+    struct timespec start, end;
+
+    if ( profile->result != 0 )
+    {
+        return NULL;
+    }
+    clock_gettime( CLOCK_MONOTONIC, &start );
+
+    FILE * output = fopen( profile->path, "w" );
+    if ( output == NULL )
+    {
+        profile->result = -errno;
+        fprintf( stderr, "### unable to open \'%s\' (%d: %s)\n", profile->path, errno, strerror(errno) );
+    }
+    else
+    {
+        fprintf( output, "#EXTM3U\n" );
+        for ( size_t i = 0; i < profile->selected; ++i )
+        {
+            exportChannel( output, profile->channel[ profile->selection[ i ] ] );
+        }
+        if ( fclose( output ) != 0 )
+        {
+            profile->result = -errno;
+            fprintf( stderr, "### unable to write \'%s\' (%d: %s)\n", profile->path, errno, strerror(errno) );
+        }
+    }
+
+    clock_gettime( CLOCK_MONOTONIC, &end );
+    profile->elapsed += elapsedMS( &start, &end );
+
+    return NULL;
+}
+
+/**
+ * @brief run a stage for every profile, each on a thread of its own, and wait for them all
+ * @param stage
+ * @param thread
+ * @return 0, or the first error hit by any of the profiles
+ */
+int runProfiles( void * (*stage)( void * ), pthread_t * thread )
+{
+    int result = 0;
+
+    for ( unsigned int i = 0; i < global.profileCount; ++i )
+    {
+        if ( pthread_create( &thread[ i ], NULL, stage, &global.profile[ i ] ) != 0 )
+        {
+            /* do it on this thread instead */
+            stage( &global.profile[ i ] );
+            thread[ i ] = pthread_self();
+        }
+    }
+    for ( unsigned int i = 0; i < global.profileCount; ++i )
+    {
+        if ( ! pthread_equal( thread[ i ], pthread_self() ) )
+        {
+            pthread_join( thread[ i ], NULL );
+        }
+        if ( result == 0 )
+        {
+            result = global.profile[ i ].result;
+        }
+    }
+    return result;
+}
+
+/**
+ * @brief number every channel that any of the profiles selected, in catalog order,
+ *        so a channel has the same number in every profile it's in
+ * @param catalog
+ * @param channel   the channel for each row of the catalog
+ * @return 0, or -ENOMEM
+ */
+int numberProfiles( const tCatalog * catalog, tChannel * const * channel )
+{
+    if ( global.numbering.table == NULL )
+    {
+        return 0;
+    }
+
+    bool * selected = calloc( catalog->count + 1, sizeof( bool ) );
+    if ( selected == NULL )
+    {
+        return -ENOMEM;
+    }
+    for ( unsigned int i = 0; i < global.profileCount; ++i )
+    {
+        const tProfile * profile = &global.profile[ i ];
+
+        for ( size_t j = 0; j < profile->selected; ++j )
+        {
+            selected[ profile->selection[ j ] ] = true;
+        }
+    }
+    for ( size_t row = 0; row < catalog->count; ++row )
+    {
+        if ( selected[ row ] )
+        {
+            numberChannel( channel[ row ] );
+        }
+    }
+    free( selected );
+
+    return 0;
+}
+
+/**
+ * @brief build one catalog, and evaluate all the profiles against it in parallel.
+ *        The channels are numbered between selecting them and writing them out,
+ *        on this thread, so the numbers don't depend on which profile runs first
+ * @param stats
+ * @return 0, or the first error hit by any of the profiles
+ */
+int exportProfiles( bool stats )
+{
+    int             result = 0;
+    tCatalog        catalog;
+    tChannel **     channel;
+    struct timespec start, end;
+
+    if ( global.profileCount == 0 )
+    {
+        return 0;
+    }
+
+    clock_gettime( CLOCK_MONOTONIC, &start );
+    channel = buildCatalog( &catalog );
+    if ( channel == NULL )
+    {
+        return -ENOMEM;
+    }
+
+    pthread_t * thread = calloc( global.profileCount, sizeof( pthread_t ) );
+    if ( thread == NULL )
+    {
+        free( channel );
+        catalogFree( &catalog );
+        return -ENOMEM;
+    }
+
+    for ( unsigned int i = 0; i < global.profileCount; ++i )
+    {
+        tProfile * profile = &global.profile[ i ];
+
+        profile->catalog   = &catalog;
+        profile->channel   = channel;
+        profile->selection = NULL;
+        profile->selected  = 0;
+        profile->result    = 0;
+    }
+    result = runProfiles( profileFilterStage, thread );
+    if ( result == 0 )
+    {
+        result = numberProfiles( &catalog, channel );
+    }
+    if ( result == 0 )
+    {
+        result = runProfiles( profileWriteStage, thread );
+    }
+    clock_gettime( CLOCK_MONOTONIC, &end );
+
+    if ( stats )
+    {
+        for ( unsigned int i = 0; i < global.profileCount; ++i )
+        {
+            fprintf( stderr, "profile: %lu of %lu channels written to \'%s\' in %.3f ms\n",
+                     global.profile[ i ].selected, catalog.count, global.profile[ i ].path,
+                     global.profile[ i ].elapsed );
+        }
+        fprintf( stderr, "profile: %u profiles from one catalog in %.3f ms\n",
+                 global.profileCount, elapsedMS( &start, &end ) );
+    }
+
+    for ( unsigned int i = 0; i < global.profileCount; ++i )
+    {
+        free( global.profile[ i ].selection );
+        global.profile[ i ].selection = NULL;
+    }
+    free( thread );
+    free( channel );
+    catalogFree( &catalog );
+
+    return result;
+}
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*
+ * Queries: an inverted index of the channels, with a posting list for each
+ * value of each attribute. A posting list is a bitmap of channel ordinals
+ * (their position in export order), so a query is answered by combining
+ * bitmaps, without looking at the channels at all until the results are
+ * written.
+ */
+
+typedef enum {
+    kQueryCountry,
+    kQueryGenre,
+    kQueryLanguage,
+    kQueryResolution,
+    kQueryAffiliate,
+    kQueryCity,
+    kQueryDMA,
+    kQueryHost,         /* any of the channel's streams */
+    kQueryAttributeCount
+} tQueryAttribute;
+
+typedef enum {
+    kQueryFormatM3U,
+    kQueryFormatTSV,
+    kQueryFormatJSON
+} tQueryFormat;
+
+static const char * queryAttributeName[ kQueryAttributeCount ] =
+{
+    [kQueryCountry]    = "country",
+    [kQueryGenre]      = "genre",
+    [kQueryLanguage]   = "language",
+    [kQueryResolution] = "resolution",
+    [kQueryAffiliate]  = "affiliate",
+    [kQueryCity]       = "city",
+    [kQueryDMA]        = "dma",
+    [kQueryHost]       = "host"
+};
+
+typedef struct {
+    tChannel **    channel;     /* by ordinal */
+    size_t         count;
+
+    tBitmap *      all;
+    tBitmap *      kept;        /* the channels the filters keep */
+    tBitmap *      empty;       /* for values no channel has */
+
+    tBitmap **     posting[ kQueryAttributeCount ];     /* by attribute value */
+    unsigned int   values[ kQueryAttributeCount ];
+    bool           oom;
+} tQueryIndex;
+
+static inline tIndex dmaOf( const tCommon * common )
+{
+    if ( common->usStation != kUSCallsignUnset && common->usStation < kUSStationCount )
+    {
+        return USStationData[ common->usStation ].nielsenDMAIdx;
+    }
+    return kNielsenDMAUnset;
+}
+
+static inline unsigned int resolutionOf( tChannel * channel )
+{
+    /* as the filters see it: the resolution of the preferred stream */
+    tStream * stream = headStream( channel );
+    return stream != NULL ? stream->resolution : channel->common.resolution;
+}
+
+void postValue( tQueryIndex * index, tQueryAttribute attribute, unsigned int value, uint32_t ordinal )
+{
+    if ( value >= index->values[ attribute ] )
+    {
+        unsigned int values  = value < 256 ? 256 : value + 1;
+        tBitmap **   posting = realloc( index->posting[ attribute ], values * sizeof( tBitmap * ) );
+        if ( posting == NULL )
+        {
+            index->oom = true;
+            return;
+        }
+        memset( &posting[ index->values[ attribute ] ], 0, (values - index->values[ attribute ]) * sizeof( tBitmap * ) );
+        index->posting[ attribute ] = posting;
+        index->values[ attribute ]  = values;
+    }
+
+    tBitmap ** bitmap = &index->posting[ attribute ][ value ];
+    if ( *bitmap == NULL )
+    {
+        *bitmap = bitmapNew();
+    }
+    if ( *bitmap == NULL || ! bitmapAdd( *bitmap, ordinal ) )
+    {
+        index->oom = true;
+    }
+}
+
+bool queryIndexChannel( const void * item, void * udata )
+{
+    tQueryIndex * index   = udata;
+    tChannel *    channel = *(tChannel **)item;
+    tCommon *     common  = &channel->common;
+    uint32_t      ordinal = (uint32_t)index->count++;
+
+    index->channel[ ordinal ] = channel;
+
+    index->oom |= ! bitmapAdd( index->all, ordinal );
+    if ( ! common->disabled && ! channel->group->common.disabled )
+    {
+        index->oom |= ! bitmapAdd( index->kept, ordinal );
+    }
+    postValue( index, kQueryCountry,    common->country,        ordinal );
+    postValue( index, kQueryGenre,      common->genre,          ordinal );
+    postValue( index, kQueryLanguage,   common->language,       ordinal );
+    postValue( index, kQueryResolution, resolutionOf( channel ), ordinal );
+    postValue( index, kQueryAffiliate,  common->affiliate,      ordinal );
+    postValue( index, kQueryCity,       common->city,           ordinal );
+    postValue( index, kQueryDMA,        dmaOf( common ),        ordinal );
+
+    tStream * stream = streamsData( &channel->streams );
+    for ( uint32_t i = 0; i < channel->streams.count; ++i )
+    {
+        if ( stream[ i ].host != kHostUnset )
+        {
+            postValue( index, kQueryHost, stream[ i ].host, ordinal );
+        }
+    }
+
+    return ! index->oom;
+}
+
+void queryIndexFree( tQueryIndex * index )
+{
+    for ( unsigned int a = 0; a < kQueryAttributeCount; ++a )
+    {
+        for ( unsigned int v = 0; v < index->values[ a ]; ++v )
+        {
+            bitmapFree( index->posting[ a ][ v ] );
+        }
+        free( index->posting[ a ] );
+    }
+    bitmapFree( index->all );
+    bitmapFree( index->kept );
+    bitmapFree( index->empty );
+    free( index->channel );
+    memset( index, 0, sizeof( tQueryIndex ) );
+}
+
+/**
+ * @brief index every channel by each of its attributes
+ * @param index
+ * @return 0, or -ENOMEM
+ */
+int queryIndexBuild( tQueryIndex * index )
+{
+    size_t count = shardCount( global.index.channel );
+
+    memset( index, 0, sizeof( tQueryIndex ) );
+    index->channel = calloc( count + 1, sizeof( tChannel * ) );
+    index->all     = bitmapNew();
+    index->kept    = bitmapNew();
+    index->empty   = bitmapNew();
+
+    if ( index->channel == NULL || index->all == NULL || index->kept == NULL || index->empty == NULL )
+    {
+        queryIndexFree( index );
+        return -ENOMEM;
+    }
+
+    shardAscend( global.index.channel, queryIndexChannel, index );
+    if ( index->oom )
+    {
+        queryIndexFree( index );
+        return -ENOMEM;
+    }
+    return 0;
+}
+
+/* resolve a 'key:value' term of a query to its posting list */
+const tBitmap * queryTerm( const char * key, size_t keyLength, const char * value, size_t valueLength, void * udata )
+{
+    tQueryIndex * index = udata;
+
+    if ( value == NULL )
+    {
+        if ( keyLength == 4 && strncasecmp( key, "kept", 4 ) == 0 ) return index->kept;
+        if ( keyLength == 3 && strncasecmp( key, "all",  3 ) == 0 ) return index->all;
+        return NULL;
+    }
+
+    for ( unsigned int a = 0; a < kQueryAttributeCount; ++a )
+    {
+        const char * name = queryAttributeName[ a ];
+        if ( strlen( name ) != keyLength || strncasecmp( key, name, keyLength ) != 0 )
+        {
+            continue;
+        }
+
+        tIndex v = kIndexUnset;
+        switch ( (tQueryAttribute)a )
+        {
+        case kQueryCountry:    v = findRuleValue( mapCountrySearch,    value, valueLength ); break;
+        case kQueryGenre:      v = findRuleValue( mapGenreSearch,      value, valueLength ); break;
+        case kQueryLanguage:   v = findLanguage( value, valueLength );                      break;
+        case kQueryResolution: v = findRuleValue( mapResolutionSearch, value, valueLength ); break;
+        case kQueryAffiliate:  v = findRuleValue( mapAffiliateSearch,  value, valueLength ); break;
+        case kQueryCity:       v = findRuleValue( mapCitySearch,       value, valueLength ); break;
+        case kQueryDMA:        v = findRuleValue( mapNielsenDMASearch, value, valueLength ); break;
+        case kQueryHost:
+            /* a host that no stream uses isn't an error, it just matches nothing */
+            v = global.hosts != NULL ? hostFind( global.hosts, value, valueLength ) : kHostUnset;
+            if ( v == kHostUnset ) return index->empty;
+            break;
+        default:               break;
+        }
+        if ( v == kIndexUnset )
+        {
+            return NULL;
+        }
+        if ( v < index->values[ a ] && index->posting[ a ][ v ] != NULL )
+        {
+            return index->posting[ a ][ v ];
+        }
+        return index->empty;
+    }
+    return NULL;
+}
+
+/* a string, quoted and escaped for JSON */
+void jsonString( FILE * output, const char * s )
+{
+    fputc( '"', output );
+    for ( ; s != NULL && *s != '\0'; ++s )
+    {
+        unsigned char c = (unsigned char)*s;
+        if ( c == '"' || c == '\\' )
+        {
+            fprintf( output, "\\%c", c );
+        }
+        else if ( c < 0x20 )
+        {
+            fprintf( output, "\\u%04x", c );
+        }
+        else
+        {
+            fputc( c, output );
+        }
+    }
+    fputc( '"', output );
+}
+
+/* a string as a TSV field: tabs and line breaks would start a new field or row, so become spaces */
+void tsvField( FILE * output, const char * s )
+{
+    for ( ; s != NULL && *s != '\0'; ++s )
+    {
+        fputc( ( *s == '\t' || *s == '\n' || *s == '\r' ) ? ' ' : *s, output );
+    }
+}
+
+typedef struct {
+    FILE *         output;
+    tQueryIndex *  index;
+    size_t         written;
+} tQueryResults;
+
+bool writeQueryResult( uint32_t ordinal, void * udata )
+{
+    tQueryResults * results = udata;
+    tChannel *      channel = results->index->channel[ ordinal ];
+    tCommon *       common  = &channel->common;
+    tCold *         cold    = coldOf( common );
+    FILE *          output  = results->output;
+    const char *    field[] =
+    {
+        cold->name,
+        cold->id,
+        nameOf( &channel->group->common ),
+        lookupCountryAsString[ common->country ],
+        lookupGenreAsString[ common->genre ],
+        lookupLanguageAsString[ common->language ],
+        lookupResolutionAsString[ resolutionOf( channel ) ],
+        lookupCityAsString[ common->city ],
+        lookupNielsenDMAAsString[ dmaOf( common ) ],
+        lookupAffiliateAsString[ common->affiliate ]
+    };
+    static const char * fieldName[] =
+    {
+        "name", "tvg-id", "group", "country", "genre", "language", "resolution", "city", "dma", "affiliate"
+    };
+    bool kept = bitmapContains( results->index->kept, ordinal );
+
+    switch ( (tQueryFormat)global.query.format )
+    {
+    case kQueryFormatM3U:
+        exportChannel( output, channel );
+        break;
+
+    case kQueryFormatTSV:
+        for ( unsigned int i = 0; i < sizeof( field ) / sizeof( field[0] ); ++i )
+        {
+            tsvField( output, field[ i ] );
+            fputc( '\t', output );
+        }
+        fprintf( output, "%s\n", kept ? "yes" : "no" );
+        break;
+
+    case kQueryFormatJSON:
+        fprintf( output, "%s\n    {", results->written > 0 ? "," : "" );
+        for ( unsigned int i = 0; i < sizeof( field ) / sizeof( field[0] ); ++i )
+        {
+            fprintf( output, " \"%s\": ", fieldName[ i ] );
+            jsonString( output, field[ i ] );
+            fputc( ',', output );
+        }
+        fprintf( output, " \"kept\": %s }", kept ? "true" : "false" );
+        break;
+    }
+    results->written++;
+
+    return true;
+}
+
+/**
+ * @brief answer each of the queries from an inverted index of the channels
+ * @param output
+ * @param stats
+ * @return 0, or a negative errno
+ */
+int exportQueries( FILE * output, bool stats )
+{
+    tQueryIndex     index;
+    struct timespec start, end;
+    int             result;
+
+    if ( global.query.count == 0 )
+    {
+        return 0;
+    }
+
+    clock_gettime( CLOCK_MONOTONIC, &start );
+    result = queryIndexBuild( &index );
+    clock_gettime( CLOCK_MONOTONIC, &end );
+    if ( result != 0 )
+    {
+        fprintf( stderr, "### unable to index %lu channels for queries\n", shardCount( global.index.channel ) );
+        return result;
+    }
+
+    if ( stats )
+    {
+        size_t lists = 0;
+        size_t bytes = 0;
+        for ( unsigned int a = 0; a < kQueryAttributeCount; ++a )
+        {
+            for ( unsigned int v = 0; v < index.values[ a ]; ++v )
+            {
+                if ( index.posting[ a ][ v ] != NULL )
+                {
+                    lists++;
+                    bytes += bitmapBytes( index.posting[ a ][ v ] );
+                }
+            }
+        }
+        fprintf( stderr, "query: indexed %lu channels into %lu posting lists (%lu bytes) in %.3f ms\n",
+                 index.count, lists, bytes, elapsedMS( &start, &end ) );
+    }
+
+    /* only the channels the filters keep are numbered, whichever queries they match */
+    numberKeptChannels();
+
+    if ( global.query.format == kQueryFormatJSON )
+    {
+        fprintf( output, "[" );
+    }
+    for ( unsigned int q = 0; q < global.query.count && result == 0; ++q )
+    {
+        const char *  expression = global.query.expression[ q ];
+        tQueryResults results    = { output, &index, 0 };
+
+        clock_gettime( CLOCK_MONOTONIC, &start );
+        tBitmap * matches = queryEvaluate( expression, index.all, queryTerm, &index );
+        clock_gettime( CLOCK_MONOTONIC, &end );
+        if ( matches == NULL )
+        {
+            result = -EINVAL;
+            break;
+        }
+
+        switch ( (tQueryFormat)global.query.format )
+        {
+        case kQueryFormatM3U:
+            /* the results of all the queries make one playlist */
+            beginPlaylist( output );
+            break;
+
+        case kQueryFormatTSV:
+            fprintf( output, "# " );
+            tsvField( output, expression );
+            fprintf( output, "\nname\ttvg-id\tgroup\tcountry\tgenre\tlanguage\tresolution\tcity\tdma\taffiliate\tkept\n" );
+            break;
+
+        case kQueryFormatJSON:
+            fprintf( output, "%s\n  { \"query\": ", q > 0 ? "," : "" );
+            jsonString( output, expression );
+            fprintf( output, ", \"count\": %lu, \"channels\": [", bitmapCardinality( matches ) );
+            break;
+        }
+
+        bitmapForEach( matches, writeQueryResult, &results );
+
+        if ( global.query.format == kQueryFormatJSON )
+        {
+            fprintf( output, "%s] }", results.written > 0 ? "\n  " : " " );
+        }
+        if ( stats )
+        {
+            fprintf( stderr, "query: \'%s\' matched %lu channels in %.3f ms\n",
+                     expression, bitmapCardinality( matches ), elapsedMS( &start, &end ) );
+        }
+        bitmapFree( matches );
+    }
+    if ( global.query.format == kQueryFormatJSON )
+    {
+        fprintf( output, "\n]\n" );
+    }
+
+    queryIndexFree( &index );
+
+    return result;
+}
+
+/**
+ * @brief
+ * @param left
+ * @param right
+ * @param udata
+ * @return
+ */
+int compareChannels( const void *left, const void *right, void *udata )
+{
+    int result;
+
+    (void)udata;
+
+    const tChannel * l = *(const tChannel **)left;
+    const tChannel * r = *(const tChannel **)right;
+
+    result = bound( l->common.country - r->common.country, -1, 1 );
+
+    if ( result == 0 )
+    {
+        result = strcmp( nameOf( &l->common ), nameOf( &r->common ) );
+    }
+
+    // fprintf( stderr, "channel: left: %s, right: %s, result %d\n", nameOf( &l->common ), nameOf( &r->common ), result );
+    return result;
+}
+
+/**
+ * @brief
+ * @param left
+ * @param right
+ * @param udata
+ * @return
+ */
+int compareGroups( const void * left, const void * right, void * udata )
+{
+    int result;
+
+    (void)udata;
+
+    const tGroup * l = *(const tGroup **)left;
+    const tGroup * r = *(const tGroup **)right;
+
+    result = bound( l->common.country - r->common.country, -1, 1 );
+    if ( result == 0 )
+    {
+        result = strcmp( nameOf( &l->common ), nameOf( &r->common ) );
+    }
+
+    // fprintf( stderr, "group: left: %s, right: %s, result %d\n", nameOf( &l->common ), nameOf( &r->common ), result );
+    return result;
+}
+
+/* the fingerprint is the hash, so the compare functions only run to rule out a collision */
+uint64_t hashChannel( const void * item )
+{
+    return (*(const tChannel **)item)->fingerprint;
+}
+
+uint64_t hashGroup( const void * item )
+{
+    return (*(const tGroup **)item)->fingerprint;
+}
+
+/**
+ * @brief the radix sort key for a channel or group: the country, then as much
+ *        of the name as fits, zero-padded. Orders the same as compareChannels()
+ *        and compareGroups(), up to the length of the key.
+ * @param common
+ * @param key
+ */
+void sortKeyCommon( const tCommon * common, uint8_t key[ kSortKeyBytes ] )
+{
+    const char * name = nameOf( common );
+    unsigned int i = 1;
+
+    key[ 0 ] = common->country;
+    for ( ; i < kSortKeyBytes && *name != '\0'; ++i )
+    {
+        key[ i ] = (uint8_t)*name++;
+    }
+    for ( ; i < kSortKeyBytes; ++i )
+    {
+        key[ i ] = 0;
+    }
+}
+
+void sortKeyChannel( const void * item, uint8_t key[ kSortKeyBytes ] )
+{
+    sortKeyCommon( &(*(const tChannel **)item)->common, key );
+}
+
+void sortKeyGroup( const void * item, uint8_t key[ kSortKeyBytes ] )
+{
+    sortKeyCommon( &(*(const tGroup **)item)->common, key );
+}
+
+/**
+ * @brief
+ * @param path
+ * @return
+ */
+int processMapping( const char * path )
+{
+    if ( global.mapping == NULL )
+    {
+        global.mapping = mappingNew();
+        if ( global.mapping == NULL )
+        {
+            return -ENOMEM;
+        }
+    }
+    return mappingLoad( global.mapping, path );
+}
+
+/**
+ * @brief
+ * @param path
+ * @return
+ */
+int processProbes( const char * path )
+{
+    if ( global.probes == NULL )
+    {
+        global.probes = probesNew();
+        if ( global.probes == NULL )
+        {
+            return -ENOMEM;
+        }
+    }
+    return probesLoad( global.probes, path );
+}
+
+/**
+ * @brief
+ * @param path
+ * @return
+ */
+int processGuide( const char * path )
+{
+    if ( global.guide == NULL )
+    {
+        global.guide = xmltvNew();
+        if ( global.guide == NULL )
+        {
+            return -ENOMEM;
+        }
+    }
+    return xmltvLoad( global.guide, path );
+}
+
+typedef struct {
+    bool           list;
+    unsigned long  kept;
+    unsigned long  guided;
+    unsigned long  programmes;
+} tGuideJoin;
+
+bool joinChannel( const void * item, void * udata )
+{
+    tGuideJoin * join    = udata;
+    tChannel *   channel = *(tChannel **)item;
+
+    if ( ! channel->common.disabled && ! channel->group->common.disabled )
+    {
+        const char * id         = coldOf( &channel->common )->id;
+        long         programmes = -1;
+
+        if ( id != NULL )
+        {
+            programmes = xmltvSelect( global.guide, id, strlen( id ) );
+        }
+
+        join->kept++;
+        if ( programmes >= 0 )
+        {
+            join->guided++;
+            join->programmes += programmes;
+        }
+        else if ( join->list )
+        {
+            fprintf( stderr, "### no guide data for \'%s\' (tvg-id \'%s\')\n",
+                     nameOf( &channel->common ), id != NULL ? id : "" );
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief select the channels this input keeps from the guide, by tvg-id
+ * @param list  also list the channels that don't have any guide data
+ */
+void joinGuide( bool list )
+{
+    tGuideJoin join;
+
+    memset( &join, 0, sizeof( join ) );
+    join.list = list;
+
+    shardAscend( global.index.channel, joinChannel, &join );
+
+    global.joined.kept       += join.kept;
+    global.joined.guided     += join.guided;
+    global.joined.programmes += join.programmes;
+}
+
+/**
+ * @brief once every input has been joined to the guide, report how many channels
+ *        have guide data, and write the trimmed guide if asked to
+ * @param result
+ * @param stats
+ * @return 0, or a negative errno
+ */
+int endGuide( int result, bool stats )
+{
+    if ( global.guide == NULL )
+    {
+        return result;
+    }
+    if ( result == 0 )
+    {
+        fprintf( stderr, "guide: %lu of %lu channels have guide data (%lu programmes)\n",
+                 global.joined.guided, global.joined.kept, global.joined.programmes );
+        if ( global.guideOutput != NULL )
+        {
+            result = xmltvExport( global.guide, global.guideOutput, stats );
+        }
+    }
+    if ( stats )
+    {
+        xmltvReport( stderr, global.guide );
+    }
+    return result;
+}
+
+/**
+ * @brief set one of the --top weights from a '<name>=<weight>' argument
+ * @param arg
+ * @return 0, or -EINVAL
+ */
+int parseWeight( const char * arg )
+{
+    const struct { const char * name; int * weight; } weights[] =
+    {
+        { "resolution", &global.top.weight.resolution },
+        { "tms",        &global.top.weight.tms        },
+        { "language",   &global.top.weight.language   },
+        { "affiliate",  &global.top.weight.affiliate  },
+        { "streams",    &global.top.weight.streams    }
+    };
+    const char * equals = strchr( arg, '=' );
+
+    for ( unsigned int i = 0; i < sizeof( weights ) / sizeof( weights[0] ) && equals != NULL; ++i )
+    {
+        size_t length = strlen( weights[ i ].name );
+        if ( (size_t)(equals - arg) == length && strncasecmp( arg, weights[ i ].name, length ) == 0 )
+        {
+            char * end;
+            long   weight = strtol( equals + 1, &end, 10 );
+            if ( end != equals + 1 && *end == '\0' )
+            {
+                *weights[ i ].weight = bound( weight, -1000, 1000 );
+                return 0;
+            }
+        }
+    }
+
+    fprintf( stderr, "### invalid weight \'%s\' (expected resolution, tms, language, affiliate or streams=<n>)\n", arg );
+    return -EINVAL;
+}
+
+/**
+ * @brief
+ * @param output
+ */
+void reportTop( FILE * output )
+{
+    fprintf( output, "top: kept %zu of %zu channels, lowest score kept %ld\n",
+             global.top.offered < global.top.k ? global.top.offered : global.top.k,
+             global.top.offered, (long)global.top.threshold );
+}
+
+/**
+ * @brief set up how to split the output from a --split argument
+ * @param key   'country', 'genre', 'region', 'dma', or 'group:' followed by
+ *              a comma-separated list of group-title patterns
+ * @return 0, or a negative errno
+ */
+int parseSplitKey( const char * key )
+{
+    static const struct { const char * name; tSplitKey key; } keys[] =
+    {
+        { "country", kSplitCountry },
+        { "genre",   kSplitGenre   },
+        { "region",  kSplitRegion  },
+        { "dma",     kSplitDMA     }
+    };
+
+    for ( unsigned int i = 0; i < sizeof( keys ) / sizeof( keys[0] ); ++i )
+    {
+        if ( strcasecmp( key, keys[ i ].name ) == 0 )
+        {
+            global.split.key = keys[ i ].key;
+            return 0;
+        }
+    }
+
+    if ( strncasecmp( key, "group:", 6 ) == 0 && key[ 6 ] != '\0' )
+    {
+        size_t length   = strlen( key + 6 );
+        char * patterns = malloc( length + 1 );
+        char ** pattern = calloc( length / 2 + 1, sizeof( char * ) );
+        if ( patterns == NULL || pattern == NULL )
+        {
+            free( patterns );
+            free( pattern );
+            return -ENOMEM;
+        }
+        memcpy( patterns, key + 6, length + 1 );
+
+        /* the first pattern starts at the beginning of the buffer, so freeing it frees them all */
+        unsigned int count = 0;
+        for ( char * p = patterns; p != NULL; )
+        {
+            char * comma = strchr( p, ',' );
+            if ( comma != NULL )
+            {
+                *comma = '\0';
+            }
+            if ( *p != '\0' || count == 0 )
+            {
+                pattern[ count++ ] = p;
+            }
+            p = comma != NULL ? comma + 1 : NULL;
+        }
+        global.split.key          = kSplitGroup;
+        global.split.pattern      = pattern;
+        global.split.patternCount = count;
+        return 0;
+    }
+
+    fprintf( stderr, "### unknown split key \'%s\' (expected country, genre, region, dma or group:<pattern>,...)\n", key );
+    return -EINVAL;
+}
+
+/**
+ * @brief open the split outputs for an input file, if the output is being split
+ * @param path  of the input file. Unless a prefix was given, the outputs are named after it
+ * @return 0, or a negative errno
+ */
+int beginSplit( const char * path )
+{
+    const char * prefix  = global.split.prefix;
+    char *       derived = NULL;
+
+    if ( global.split.key == kSplitNone )
+    {
+        return 0;
+    }
+
+    if ( prefix == NULL )
+    {
+        /* 'dir/playlist.m3u' becomes 'dir/playlist-' */
+        const char * base   = strrchr( path, '/' );
+        const char * dot    = strrchr( base != NULL ? base + 1 : path, '.' );
+        size_t       length = dot != NULL ? (size_t)(dot - path) : strlen( path );
+
+        derived = malloc( length + 2 );
+        if ( derived == NULL )
+        {
+            return -ENOMEM;
+        }
+        memcpy( derived, path, length );
+        derived[ length ]     = '-';
+        derived[ length + 1 ] = '\0';
+        prefix = derived;
+    }
+
+    global.split.output = splitNew( prefix, global.split.extension, global.split.cap );
+    free( derived );
+
+    return global.split.output != NULL ? 0 : -ENOMEM;
+}
+
+/**
+ * @brief close the split outputs, whether or not the export succeeded
+ * @param result  of the export
+ * @param stats
+ * @return the export's result if it failed, else 0, or a negative errno if any of them couldn't be written
+ */
+int endSplit( int result, bool stats )
+{
+    if ( global.split.output != NULL )
+    {
+        if ( stats )
+        {
+            splitReport( stderr, global.split.output );
+        }
+        int r = splitFree( global.split.output );
+        if ( result == 0 )
+        {
+            result = r;
+        }
+        global.split.output = NULL;
+    }
+    return result;
+}
+
+/* the most distinct unknown attributes, and stream extensions, to count individually */
+#define kMaxUnknownFields       64
+#define kMaxUnknownExtensions   64
+
+bool reportUnknownField( const char * key, uint64_t count, const char * example, void * udata )
+{
+    (void)example;
+    fprintf( udata, "Warning: unknown field \'%s\' passed through on %lu entries\n", key, (unsigned long)count );
+    return true;
+}
+
+/**
+ * @brief one warning for each kind of unknown attribute, however often it turned up
+ * @param output
+ */
+void reportUnknownFields( FILE * output )
+{
+    if ( global.unknownFields != NULL )
+    {
+        tallyForEach( global.unknownFields, reportUnknownField, output );
+
+        uint64_t overflow = tallyOverflow( global.unknownFields );
+        if ( overflow > 0 )
+        {
+            fprintf( output, "Warning: %lu more unknown fields passed through, of too many kinds to list\n",
+                     (unsigned long)overflow );
+        }
+    }
+
+    unsigned long dropped = atomic_load( &global.droppedFields );
+    if ( dropped > 0 )
+    {
+        fprintf( output, "Warning: %lu entries had more than %d bytes of unknown fields, and the rest were dropped\n",
+                 dropped, kMaxPassthrough );
+    }
+}
+
+typedef struct {
+    FILE *     output;
+    bool       list;
+    uint64_t   streams;
+    unsigned   kinds;
+} tExtensionReport;
+
+bool reportUnknownExtension( const char * key, uint64_t count, const char * example, void * udata )
+{
+    tExtensionReport * report = udata;
+
+    report->streams += count;
+    report->kinds++;
+    if ( report->list )
+    {
+        fprintf( report->output, "extensions: \'%s\' unrecognized on %lu streams, e.g. %s\n",
+                 key, (unsigned long)count, example != NULL ? example : "" );
+    }
+    return true;
+}
+
+/**
+ * @brief summarize the stream URLs with extensions that weren't recognized
+ * @param output
+ * @param stats     list each extension, with the first URL it was seen on
+ */
+void reportUnknownExtensions( FILE * output, bool stats )
+{
+    tExtensionReport report = { output, stats, 0, 0 };
+
+    if ( global.unknownExtensions == NULL )
+    {
+        return;
+    }
+    tallyForEach( global.unknownExtensions, reportUnknownExtension, &report );
+    report.streams += tallyOverflow( global.unknownExtensions );
+
+    if ( report.streams > 0 )
+    {
+        fprintf( output, "Warning: %lu streams have an unrecognized extension (%u kinds%s)\n",
+                 (unsigned long)report.streams, report.kinds,
+                 tallyOverflow( global.unknownExtensions ) > 0 ? ", and more not tracked" : "" );
+    }
+}
+
+/* the most hosts to list in the statistics */
+#define kHostReportMax  20
+
+_Static_assert( kResolutionMax <= kHostMaxTiers, "each resolution should be counted separately" );
+
+typedef struct {
+    tHostIndex     host;
+    int64_t        streams;
+} tHostRank;
+
+typedef struct {
+    FILE *         output;
+    tTopK *        busiest;
+    uint64_t       streams;
+
+    tHostRank      ranked[ kHostReportMax ];
+    unsigned int   count;
+} tHostReport;
+
+bool rankHost( tHostIndex host, const char * name, const tHostStats * stats, void * udata )
+{
+    tHostReport * report = udata;
+
+    (void)name;
+    report->streams += stats->streams;
+    topkOffer( report->busiest, (int64_t)stats->streams, (void *)(uintptr_t)host );
+    return true;
+}
+
+bool collectHost( void * item, int64_t score, void * udata )
+{
+    tHostReport * report = udata;
+
+    report->ranked[ report->count ].host    = (tHostIndex)(uintptr_t)item;
+    report->ranked[ report->count ].streams = score;
+    report->count++;
+    return true;
+}
+
+/* most streams first, and hosts with as many in the order they were first seen */
+int compareHostRank( const void * left, const void * right )
+{
+    const tHostRank * l = left;
+    const tHostRank * r = right;
+
+    if ( l->streams != r->streams )
+    {
+        return l->streams < r->streams ? 1 : -1;
+    }
+    return ( l->host > r->host ) - ( l->host < r->host );
+}
+
+void reportHost( tHostReport * report, tHostIndex host )
+{
+    tHostStats stats;
+
+    if ( hostStats( global.hosts, host, &stats ) )
+    {
+        fprintf( report->output, "host: %s: %lu streams on %lu channels, %lu VIP (",
+                 hostName( global.hosts, host ), (unsigned long)stats.streams,
+                 (unsigned long)stats.channels, (unsigned long)stats.vip );
+
+        const char * separator = "";
+        for ( unsigned int t = 0; t < kResolutionMax; ++t )
+        {
+            if ( stats.tier[ t ] > 0 )
+            {
+                fprintf( report->output, "%s%s %lu", separator,
+                         t == kResolutionUnset ? "unknown" : lookupResolutionAsString[ t ],
+                         (unsigned long)stats.tier[ t ] );
+                separator = ", ";
+            }
+        }
+        fprintf( report->output, ")\n" );
+    }
+}
+
+/**
+ * @brief how the streams are spread across the hosts serving them, listing the busiest
+ * @param output
+ */
+void reportHosts( FILE * output )
+{
+    tHostReport report = { .output = output };
+
+    if ( global.hosts == NULL || (report.busiest = topkNew( kHostReportMax )) == NULL )
+    {
+        return;
+    }
+    hostForEach( global.hosts, rankHost, &report );
+    fprintf( output, "hosts: %lu streams served from %u hosts",
+             (unsigned long)report.streams, hostCount( global.hosts ) );
+    if ( hostCount( global.hosts ) > kHostReportMax )
+    {
+        fprintf( output, ", the busiest %u of them:", kHostReportMax );
+    }
+    fprintf( output, "\n" );
+    topkForEach( report.busiest, collectHost, &report );
+    qsort( report.ranked, report.count, sizeof( tHostRank ), compareHostRank );
+    for ( unsigned int i = 0; i < report.count; ++i )
+    {
+        reportHost( &report, report.ranked[ i ].host );
+    }
+    topkFree( report.busiest );
+}
+
+/**
+ * @brief load the channel numbers given out by earlier runs, and set up the
+ *        ranges new channels are numbered from
+ * @param path      of the table
+ * @param ranges    '<pattern>=<first>-<last>' arguments
+ * @param count
+ * @return 0, or a negative errno
+ */
+int beginNumbering( const char * path, const char ** ranges, unsigned int count )
+{
+    int      result  = 0;
+    uint32_t highest = 0;
+
+    global.numbering.table   = numberingNew();
+    global.numbering.pattern = calloc( count + 1, sizeof( char * ) );
+    global.numbering.range   = calloc( count + 1, sizeof( unsigned int ) );
+    if ( global.numbering.table == NULL || global.numbering.pattern == NULL || global.numbering.range == NULL )
+    {
+        return -ENOMEM;
+    }
+    result = numberingLoad( global.numbering.table, path );
+
+    for ( unsigned int i = 0; i < count && result == 0; ++i )
+    {
+        const char *  arg    = ranges[ i ];
+        const char *  equals = strrchr( arg, '=' );
+        unsigned long first  = 0;
+        unsigned long last   = 0;
+        char *        end    = NULL;
+
+        if ( equals != NULL && equals != arg )
+        {
+            first = strtoul( equals + 1, &end, 10 );
+            if ( *end == '-' )
+            {
+                last = strtoul( end + 1, &end, 10 );
+            }
+        }
+        if ( end == NULL || *end != '\0' || first == 0 || last < first || last > kChannelNumberMax )
+        {
+            fprintf( stderr, "### invalid number range '%s' (expected <pattern>=<first>-<last>, up to %u)\n",
+                     arg, kChannelNumberMax );
+            return -EINVAL;
+        }
+
+        char * pattern = malloc( equals - arg + 1 );
+        if ( pattern == NULL )
+        {
+            return -ENOMEM;
+        }
+        memcpy( pattern, arg, equals - arg );
+        pattern[ equals - arg ] = '\0';
+        global.numbering.pattern[ i ] = pattern;
+        global.numbering.count++;
+
+        int range = numberingAddRange( global.numbering.table, first, last );
+        if ( range < 0 )
+        {
+            return range;
+        }
+        global.numbering.range[ i ] = range;
+        if ( last > highest )
+        {
+            highest = last;
+        }
+    }
+
+    /* the groups without a range of their own are numbered after all the others,
+     * as are the channels whose range is full */
+    global.numbering.fallback = UINT_MAX;
+    if ( result == 0 && highest < kChannelNumberMax )
+    {
+        int range = numberingAddOverflow( global.numbering.table, highest + 1, kChannelNumberMax );
+        if ( range < 0 )
+        {
+            return range;
+        }
+        global.numbering.fallback = range;
+    }
+    return result;
+}
+
+/**
+ * @brief save the channel numbers for the next run
+ * @param path
+ * @param result    of the run. Nothing is saved if it failed
+ * @param stats
+ * @return 0, or a negative errno
+ */
+int endNumbering( const char * path, int result, bool stats )
+{
+    if ( global.numbering.table != NULL )
+    {
+        if ( result == 0 )
+        {
+            result = numberingSave( global.numbering.table, path );
+        }
+        numberingWarn( stderr, global.numbering.table );
+        if ( stats )
+        {
+            numberingReport( stderr, global.numbering.table );
+        }
+        numberingFree( global.numbering.table );
+        global.numbering.table = NULL;
+    }
+    for ( unsigned int i = 0; i < global.numbering.count; ++i )
+    {
+        free( global.numbering.pattern[ i ] );
+    }
+    free( global.numbering.pattern );
+    free( global.numbering.range );
+
+    return result;
+}
+
+/**
+ * @brief open the playlist output, and the snapshot of the last run to compare it with
+ * @return 0, or a negative errno
+ */
+int beginOutput( void )
+{
+    int result = 0;
+
+    global.outputFile     = stdout;
+    global.output.started = false;
+    if ( global.output.path != NULL )
+    {
+        /* written alongside, so the playlist is only ever replaced whole */
+        size_t length = strlen( global.output.path );
+        global.output.temporary = malloc( length + sizeof( ".new" ) );
+        if ( global.output.temporary == NULL )
+        {
+            return -ENOMEM;
+        }
+        memcpy( global.output.temporary, global.output.path, length );
+        memcpy( global.output.temporary + length, ".new", sizeof( ".new" ) );
+
+        global.outputFile = fopen( global.output.temporary, "w" );
+        if ( global.outputFile == NULL )
+        {
+            result = -errno;
+            fprintf( stderr, "### unable to open \'%s\' (%d: %s)\n", global.output.temporary, errno, strerror(errno) );
+            free( global.output.temporary );
+            global.output.temporary = NULL;
+            return result;
+        }
+    }
+
+    if ( global.delta.path != NULL )
+    {
+        global.delta.previous = snapshotNew();
+        global.delta.current  = snapshotNew();
+        global.delta.render   = open_memstream( &global.delta.buffer, &global.delta.size );
+        global.delta.failed   = false;
+        if ( global.delta.previous == NULL || global.delta.current == NULL || global.delta.render == NULL )
+        {
+            result = -ENOMEM;
+        }
+        else
+        {
+            result = snapshotLoad( global.delta.previous, global.delta.path );
+        }
+    }
+    return result;
+}
+
+void reportChange( tSnapshotChange change, const char * name, size_t nameLength, void * udata )
+{
+    static const char marker[] = { '+', '-', '~', '>' };
+
+    fprintf( udata, "%c %.*s\n", marker[ change ], (int)nameLength, name );
+}
+
+/* compare what was written with the last run, and save it for the next one */
+int endDelta( int result, bool stats, bool * changed )
+{
+    tSnapshotDelta delta;
+
+    if ( global.delta.render != NULL )
+    {
+        fclose( global.delta.render );
+    }
+    free( global.delta.buffer );
+    global.delta.render = NULL;
+    global.delta.buffer = NULL;
+
+    if ( result == 0 )
+    {
+        if ( global.delta.failed
+          || ! snapshotCompare( global.delta.previous, global.delta.current, &delta, stats ? reportChange : NULL, stderr ) )
+        {
+            fprintf( stderr, "### error: out of memory\n" );
+            result = -ENOMEM;
+        }
+        else
+        {
+            fprintf( stderr, "delta: %zu added, %zu removed, %zu changed, %zu with a new stream, %zu unchanged%s\n",
+                     delta.added, delta.removed, delta.changed, delta.streams, delta.unchanged,
+                     delta.reordered ? " (reordered)" : "" );
+            *changed = delta.added > 0 || delta.removed > 0 || delta.changed > 0 || delta.streams > 0 || delta.reordered;
+            if ( global.output.path != NULL && access( global.output.path, F_OK ) != 0 )
+            {
+                *changed = true;
+            }
+        }
+    }
+    snapshotFree( global.delta.previous );
+    global.delta.previous = NULL;
+
+    return result;
+}
+
+/**
+ * @brief finish the playlist output. If it's being compared with the last run and
+ *        nothing changed, the existing playlist and snapshot are left untouched.
+ * @param result  of the export so far. Nothing is replaced if it failed
+ * @param stats   list the channels that changed
+ * @return 0, or a negative errno
+ */
+int endOutput( int result, bool stats )
+{
+    bool changed = true;
+
+    if ( global.delta.current != NULL )
+    {
+        result = endDelta( result, stats, &changed );
+    }
+
+    if ( global.output.temporary != NULL )
+    {
+        if ( fclose( global.outputFile ) != 0 && result == 0 )
+        {
+            result = -errno;
+            fprintf( stderr, "### unable to write \'%s\' (%d: %s)\n", global.output.temporary, errno, strerror(errno) );
+        }
+        if ( result == 0 && changed )
+        {
+            if ( rename( global.output.temporary, global.output.path ) != 0 )
+            {
+                result = -errno;
+                fprintf( stderr, "### unable to replace \'%s\' (%d: %s)\n", global.output.path, errno, strerror(errno) );
+            }
+        }
+        else
+        {
+            if ( result == 0 )
+            {
+                fprintf( stderr, "delta: \'%s\' is unchanged\n", global.output.path );
+            }
+            unlink( global.output.temporary );
+        }
+        free( global.output.temporary );
+        global.output.temporary = NULL;
+    }
+    else if ( global.outputFile != NULL )
+    {
+        fflush( global.outputFile );
+    }
+    global.outputFile = NULL;
+
+    /* only once the playlist is in place, so the snapshot never describes one that wasn't written */
+    if ( global.delta.current != NULL )
+    {
+        if ( result == 0 && changed )
+        {
+            result = snapshotSave( global.delta.current, global.delta.path );
+        }
+        snapshotFree( global.delta.current );
+        global.delta.current = NULL;
+    }
+    return result;
+}
+
+/**
+ * @brief
+ * @param path
+ * @return
+ */
+int processFile( const char * path, bool columnar, bool stats )
+{
+    int result = 0;
+
+    FILE * inputFile = fopen( path, "r" );
+
+    if ( inputFile == NULL )
+    {
+        result = -errno;
+        fprintf( stderr, "### unable to open \'%s\' (%d: %s)\n", path, errno, strerror(errno) );
+    }
+    else
+    {
+        global.index.channel = shardNew( kIndexShards, sizeof( tChannel * ), compareChannels, hashChannel, sortKeyChannel );
+        global.index.group   = shardNew( kIndexShards, sizeof( tGroup * ),   compareGroups,   hashGroup,   sortKeyGroup );
+
+        if ( global.index.channel == NULL || global.index.group == NULL )
+        {
+            result = -ENOMEM;
+            fprintf( stderr, "### error: out of memory\n" );
+        }
+        else
+        {
+            importM3U( inputFile );
+            result = beginSplit( path );
+        }
+        if ( result != 0 )
+        {
+            /* nothing to write to */
+        }
+        else if ( global.profileCount > 0 || global.query.count > 0 )
+        {
+            result = exportProfiles( stats );
+            if ( result == 0 )
+            {
+                result = exportQueries( global.outputFile, stats );
+            }
+        }
+        else if ( columnar )
+        {
+            result = exportM3UColumnar( global.outputFile, stats );
+        }
+        else
+        {
+            result = exportM3U( global.outputFile );
+        }
+        result = endSplit( result, stats );
+        if ( global.guide != NULL && result == 0 )
+        {
+            joinGuide( stats );
+        }
+        if ( stats )
+        {
+            internReport( stderr, "strings", global.strings );
+            if ( global.mapping != NULL )
+            {
+                mappingReport( stderr, global.mapping );
+            }
+            if ( global.top.k > 0 )
+            {
+                reportTop( stderr );
+            }
+        }
+
+        shardFree( global.index.channel );
+        shardFree( global.index.group );
+    }
+
+    return result;
+}
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*
+ * Pipelined execution: a reader thread splits the mmap'd input into entries,
+ * a pool of classifier threads parse them and run processName(), a single
+ * indexer thread owns the indexes and merges the entries back in their original
+ * order (so the output is identical to the serial path), and a writer thread
+ * formats the surviving channels. If a stage fails, it records the error, and
+ * every stage stops working but keeps passing the end markers along, so the
+ * threads all finish and the error is returned from the main thread.
+ */
+
+#define kPipelineQueueSize  1024
+#define kPipelineWindow     4096    /* power of two: max entries between the reader and the indexer */
+
+/* the raw text of one #EXTINF entry, pointing into the mapped input */
+typedef struct {
+    unsigned long  sequence;
+    const char *   extinf;          /* past the leading '#EXTINF:-1 ' */
+    size_t         extinfLen;
+    const char *   url;
+    size_t         urlLen;
+} tSpan;
+
+typedef struct {
+    const char *   data;
+    size_t         size;
+    FILE *         output;
+    unsigned int   classifiers;
+
+    tQueue *       spans;           /* reader -> classifiers */
+    tQueue *       entries;         /* classifiers -> indexer */
+    tRing *        channels;        /* indexer -> writer */
+
+    atomic_ulong   indexed;         /* number of entries merged by the indexer */
+    atomic_int     failed;          /* the first stage to fail's negative errno, or 0 */
+    int            result;          /* the writer's, read once it's been joined */
+} tPipeline;
+
+/* remember the first error, for the main thread to return once the threads are joined */
+static void pipelineFail( tPipeline * pipeline, int error )
+{
+    int expected = 0;
+    atomic_compare_exchange_strong( &pipeline->failed, &expected, error );
+}
+
+static inline bool pipelineFailed( tPipeline * pipeline )
+{
+    return atomic_load_explicit( &pipeline->failed, memory_order_relaxed ) != 0;
+}
+
+/**
+ * @brief find the end of the line, and trim off any trailing EOL characters
+ * @param p
+ * @param end
+ * @param len   set to the length of the line, excluding the EOL characters
+ * @return the start of the next line
+ */
+static const char * nextLine( const char * p, const char * end, size_t * len )
+{
+    const char * eol = memchr( p, '\n', end - p );
+    if ( eol == NULL )
+    {
+        eol = end;
+    }
+    const char * e = eol;
+    while ( e > p && ( e[-1] == '\r' || e[-1] == '\n' ) ) { --e; }
+    *len = e - p;
+
+    return ( eol < end ) ? eol + 1 : end;
+}
+
+void * readerStage( void * arg )
 {
-    (void)udata;
+    tPipeline *   pipeline = (tPipeline *)arg;
+    const char *  p        = pipeline->data;
+    const char *  end      = p + pipeline->size;
+    unsigned long sequence = 0;
+    tQueueCounts  counts;
+
+    memset( &counts, 0, sizeof( counts ) );
+    while ( p < end && ! pipelineFailed( pipeline ) )
+    {
+        size_t       len;
+        const char * line = p;
 
-    tChannel * channel = *(tChannel **)item;
+        p = nextLine( p, end, &len );
+        if ( len > 11 && strncmp( line, "#EXTINF:-1 ", 11 ) == 0 )
+        {
+            tSpan * span = malloc( sizeof( tSpan ) );
+            if ( span == NULL )
+            {
+                fprintf( stderr, "### error: out of memory\n" );
+                pipelineFail( pipeline, -ENOMEM );
+                break;
+            }
+            span->sequence  = sequence;
+            span->extinf    = line + 11;
+            span->extinfLen = len - 11;
+            span->url       = p;
+            p = nextLine( p, end, &span->urlLen );
+
+            /* don't get too far ahead of the indexer, or its reorder window would overflow */
+            while ( sequence - atomic_load_explicit( &pipeline->indexed, memory_order_acquire ) >= kPipelineWindow
+                    && ! pipelineFailed( pipeline ) )
+            {
+                sched_yield();
+            }
+            queuePush( pipeline->spans, span, &counts );
+            ++sequence;
+        }
+    }
 
-    // fprintf( stderr, "%d %d %s\n", channel->common.disabled, channel->group->common.disabled, channel->common.name );
-    if (! channel->common.disabled && ! channel->group->common.disabled )
+    /* one end-of-input marker for each classifier */
+    for ( unsigned int i = 0; i < pipeline->classifiers; ++i )
     {
-        exportChannel( stdout, channel );
+        queuePush( pipeline->spans, NULL, &counts );
     }
+    queueAddCounts( pipeline->spans, &counts );
 
-    return true;
+    return NULL;
 }
 
-bool interateGroup( const void * item, void * udata )
+void * classifierStage( void * arg )
 {
-    (void)udata;
+    tPipeline *  pipeline = (tPipeline *)arg;
+    char *       buffer   = NULL;
+    size_t       size     = 0;
+    tSpan *      span;
+    tParser      parser;
+    tQueueCounts spans;
+    tQueueCounts entries;
+
+    memset( &parser,  0, sizeof( parser ) );
+    memset( &spans,   0, sizeof( spans ) );
+    memset( &entries, 0, sizeof( entries ) );
+    while ( (span = queuePop( pipeline->spans, &spans )) != NULL )
+    {
+        /* once a stage has failed, the rest of the spans are just drained */
+        if ( pipelineFailed( pipeline ) )
+        {
+            free( span );
+            continue;
+        }
 
-    tGroup * group = *(tGroup **)item;
+        /* reassemble the entry in the same form importM3U() builds */
+        size_t needed = span->extinfLen + span->urlLen + sizeof( " x-url=\"\"" );
+        if ( needed > size )
+        {
+            char * larger = realloc( buffer, needed * 2 );
+            if ( larger == NULL )
+            {
+                fprintf( stderr, "### error: out of memory\n" );
+                pipelineFail( pipeline, -ENOMEM );
+                free( span );
+                continue;
+            }
+            buffer = larger;
+            size   = needed * 2;
+        }
+        memcpy( buffer, span->extinf, span->extinfLen );
+        buffer[ span->extinfLen ] = '\0';
 
-    fprintf( stderr, "%d \'%s\',\'%s\' [%s] (%s)\n",
-             group->common.disabled,
-             group->common.originalName,
-             group->common.name,
-             lookupGenreAsString[ group->common.genre ],
-             lookupTypeAsString[ group->common.type ] );
+        char * q = strrchr( buffer, ',' );
+        if ( q != NULL && q > buffer && *(q-1) == '"' )
+        {
+            *q = '\0';
+        }
+        q = stpcpy( &buffer[ strlen( buffer ) ], " x-url=\"" );
+        memcpy( q, span->url, span->urlLen );
+        q[ span->urlLen ]     = '\"';
+        q[ span->urlLen + 1 ] = '\0';
 
-    return true;
+        tEntry * entry = parseM3Uentry( buffer, &parser );
+        if ( entry == NULL )
+        {
+            fprintf( stderr, "### error: out of memory\n" );
+            pipelineFail( pipeline, -ENOMEM );
+            free( span );
+            continue;
+        }
+        entry->sequence = span->sequence;
+        free( span );
+
+        queuePush( pipeline->entries, entry, &entries );
+    }
+    free( buffer );
+    endParser( &parser );
+
+    queuePush( pipeline->entries, NULL, &entries );
+    queueAddCounts( pipeline->spans, &spans );
+    queueAddCounts( pipeline->entries, &entries );
+
+    return NULL;
 }
 
-/**
- * @brief
- * @param output
- */
-void exportM3U( FILE * output )
+/* the indexer's end of the ring to the writer */
+typedef struct {
+    tRing *        channels;
+    tQueueCounts   counts;
+} tChannelFeed;
+
+bool queueChannel( const void * item, void * udata )
 {
-    fprintf( output, "#EXTM3U\n" );
+    tChannelFeed * feed    = (tChannelFeed *)udata;
+    tChannel *     channel = *(tChannel **)item;
+
+    if ( ! channel->common.disabled && ! channel->group->common.disabled )
+    {
+        ringPush( feed->channels, channel, &feed->counts );
+    }
 
-    btree_ascend( global.tree.channel, NULL, interateChannel, NULL );
-    //btree_ascend( global.tree.group,   NULL, interateGroup,   NULL );
+    return true;
 }
 
-/**
- * @brief QSort-style compare function for Gracenote/TMS channel IDs
- * @param left
- * @param right
- * @param udata
- * @return
- */
-int compareTMSChannel( const void * left, const void * right, void * udata )
+void * indexerStage( void * arg )
 {
-    int result;
+    tPipeline *   pipeline  = (tPipeline *)arg;
+    tEntry **     pending   = calloc( kPipelineWindow, sizeof( tEntry * ) );
+    unsigned long next      = 0;
+    unsigned int  remaining = pipeline->classifiers;
+    tQueueCounts  entries;
+    tChannelFeed  feed;
+
+    memset( &entries, 0, sizeof( entries ) );
+    memset( &feed,    0, sizeof( feed ) );
+    feed.channels = pipeline->channels;
+
+    if ( pending == NULL )
+    {
+        fprintf( stderr, "### error: out of memory\n" );
+        pipelineFail( pipeline, -ENOMEM );
+    }
 
-    (void)udata;
+    while ( remaining > 0 )
+    {
+        tEntry * entry = queuePop( pipeline->entries, &entries );
+        if ( entry == NULL )
+        {
+            /* a classifier has finished */
+            --remaining;
+            continue;
+        }
+        if ( pipelineFailed( pipeline ) )
+        {
+            discardEntry( entry );
+            continue;
+        }
 
-    const tTMSChannel * l = (const tTMSChannel *)left;
-    const tTMSChannel * r = (const tTMSChannel *)right;
+        /* entries arrive out of order, so merge them in input order */
+        pending[ entry->sequence & (kPipelineWindow - 1) ] = entry;
+        while ( (entry = pending[ next & (kPipelineWindow - 1) ]) != NULL )
+        {
+            pending[ next & (kPipelineWindow - 1) ] = NULL;
+            indexM3Uentry( entry );
+            ++next;
+            atomic_store_explicit( &pipeline->indexed, next, memory_order_release );
+        }
+    }
+    if ( pending != NULL && pipelineFailed( pipeline ) )
+    {
+        /* those still waiting for an entry that won't come now */
+        for ( unsigned int i = 0; i < kPipelineWindow; ++i )
+        {
+            if ( pending[ i ] != NULL )
+            {
+                discardEntry( pending[ i ] );
+            }
+        }
+    }
+    free( pending );
 
-    result = strcmp( l->name, r->name );
+    if ( ! pipelineFailed( pipeline ) )
+    {
+        /* the output order isn't known until everything has been merged, and
+         * the numbers are given out in that order before the writer sees any */
+        if ( global.top.k == 0 && global.profileCount == 0 && global.query.count == 0 )
+        {
+            numberKeptChannels();
+        }
+        shardAscend( global.index.channel, queueChannel, &feed );
+    }
+    ringPush( pipeline->channels, NULL, &feed.counts );
+    queueAddCounts( pipeline->entries, &entries );
+    ringAddCounts( pipeline->channels, &feed.counts );
 
-    return result;
+    return NULL;
 }
 
-
-/**
- * @brief
- * @param left
- * @param right
- * @param udata
- * @return
- */
-int compareChannels( const void *left, const void *right, void *udata )
+void * writerStage( void * arg )
 {
-    int result;
-
-    (void)udata;
+    tPipeline *  pipeline = (tPipeline *)arg;
+    tChannel *   channel;
+    tQueueCounts counts;
 
-    const tChannel * l = *(const tChannel **)left;
-    const tChannel * r = *(const tChannel **)right;
+    memset( &counts, 0, sizeof( counts ) );
 
-    result = bound( l->common.country - r->common.country, -1, 1 );
+    /* the profiles and queries are written once everything is indexed */
+    bool writing = ( global.profileCount == 0 && global.query.count == 0 );
+    if ( writing )
+    {
+        pipeline->result = beginExport( pipeline->output );
+        writing = ( pipeline->result == 0 );
+    }
 
-    if ( result == 0 )
+    /* the indexer waits to hand over every channel, whether they're written or not */
+    while ( (channel = ringPop( pipeline->channels, &counts )) != NULL )
+    {
+        if ( writing )
+        {
+            exportKeptChannel( pipeline->output, channel );
+        }
+    }
+    if ( writing )
     {
-        result = strcmp( l->common.name, r->common.name );
+        endExport( pipeline->output );
     }
+    ringAddCounts( pipeline->channels, &counts );
 
-    // fprintf( stderr, "channel: left: %s, right: %s, result %d\n", l->common.name, r->common.name, result );
-    return result;
+    return NULL;
 }
 
 /**
- * @brief
- * @param left
- * @param right
- * @param udata
- * @return
+ * @brief start one of the pipeline's threads
+ * @param thread
+ * @param stage
+ * @param pipeline  marked as failed if the thread couldn't be started
+ * @return false if it couldn't be
  */
-int compareGroups( const void * left, const void * right, void * udata )
+bool startStage( pthread_t * thread, void * (*stage)( void * ), tPipeline * pipeline )
 {
-    int result;
-
-    (void)udata;
+    int error = pthread_create( thread, NULL, stage, pipeline );
 
-    const tGroup * l = *(const tGroup **)left;
-    const tGroup * r = *(const tGroup **)right;
-
-    result = bound( l->common.country - r->common.country, -1, 1 );
-    if ( result == 0 )
+    if ( error != 0 )
     {
-        result = strcmp( l->common.name, r->common.name );
+        fprintf( stderr, "### unable to start a pipeline thread (%d: %s)\n", error, strerror( error ) );
+        pipelineFail( pipeline, -error );
+        return false;
     }
-
-    // fprintf( stderr, "group: left: %s, right: %s, result %d\n", l->common.name, r->common.name, result );
-    return result;
+    return true;
 }
 
 /**
- * @brief
+ * @brief process an M3U file using the multi-threaded pipeline
  * @param path
+ * @param classifiers  number of classifier threads
+ * @param stats        report the occupancy of each stage's queue
  * @return
  */
-int processMapping( const char * path )
+int processFilePipelined( const char * path, unsigned int classifiers, bool stats )
 {
-    int result = 0;
-    char line[1024];
-
-    FILE * mappingFile = fopen( path, "r" );
+    int         result = 0;
+    tPipeline   pipeline;
+    struct stat st;
 
-    if ( mappingFile == NULL )
+    int fd = open( path, O_RDONLY );
+    if ( fd < 0 || fstat( fd, &st ) != 0 )
     {
         result = -errno;
         fprintf( stderr, "### unable to open \'%s\' (%d: %s)\n", path, errno, strerror(errno) );
+        if ( fd >= 0 ) close( fd );
+        return result;
     }
-    else
+
+    memset( &pipeline, 0, sizeof( pipeline ) );
+    pipeline.size        = st.st_size;
+    pipeline.classifiers = classifiers;
+    atomic_init( &pipeline.indexed, 0 );
+    atomic_init( &pipeline.failed, 0 );
+
+    if ( pipeline.size > 0 )
     {
-        global.tree.mapping = btree_new( sizeof( tTMSChannel ), 0, compareTMSChannel, NULL );
-        while ( fgets( line, sizeof(line), mappingFile ) != NULL)
+        pipeline.data = mmap( NULL, pipeline.size, PROT_READ, MAP_PRIVATE, fd, 0 );
+        if ( pipeline.data == MAP_FAILED )
         {
-            if ( line[0] != '\0' && line[0] != '#' )
-            {
-                char * e = strchr( line, '\t' );
-                if ( e != NULL )
-                {
-                    *e = '\0';
+            result = -errno;
+            fprintf( stderr, "### unable to map \'%s\' (%d: %s)\n", path, errno, strerror(errno) );
+            close( fd );
+            return result;
+        }
+        madvise( (void *)pipeline.data, pipeline.size, MADV_SEQUENTIAL );
+    }
 
-                    tTMSChannel * tmschan = calloc(1, sizeof(tTMSChannel));
-                    if (tmschan != NULL)
-                    {
-                        tmschan->name = strdup(line);
+    pipeline.spans    = queueNew( kPipelineQueueSize );
+    pipeline.entries  = queueNew( kPipelineQueueSize );
+    pipeline.channels = ringNew( kPipelineQueueSize );
+    pthread_t * classifier = calloc( classifiers, sizeof( pthread_t ) );
 
-                        ++e;                         // point at the second field
-                        e = strchr( e, '\t' );  // end of the second field
-                        if ( e != NULL)
-                        {
-                            ++e; // beginning of field 3 - TMS ID
-                            // strtol stops at first non-numeric character, so don't need to convert tab to null
-                            tmschan->id = strtol(e, NULL, 10);
+    if ( pipeline.spans == NULL || pipeline.entries == NULL || pipeline.channels == NULL || classifier == NULL )
+    {
+        result = -ENOMEM;
+        fprintf( stderr, "### error: out of memory\n" );
+    }
+    else if ( (result = beginSplit( path )) == 0 )
+    {
+        pthread_t reader, indexer, writer;
 
-                            btree_set( global.tree.mapping, tmschan );
-                        }
-                    }
-                }
+        pipeline.output = global.outputFile;
+
+        global.index.channel = shardNew( kIndexShards, sizeof( tChannel * ), compareChannels, hashChannel, sortKeyChannel );
+        global.index.group   = shardNew( kIndexShards, sizeof( tGroup * ),   compareGroups,   hashGroup,   sortKeyGroup );
+
+        /* each stage is only started once the one it feeds is running */
+        bool         haveWriter  = false;
+        bool         haveIndexer = false;
+        bool         haveReader  = false;
+        unsigned int started     = 0;   /* classifiers */
+
+        if ( global.index.channel == NULL || global.index.group == NULL )
+        {
+            fprintf( stderr, "### error: out of memory\n" );
+            pipelineFail( &pipeline, -ENOMEM );
+        }
+        else if ( (haveWriter = startStage( &writer, writerStage, &pipeline ))
+               && (haveIndexer = startStage( &indexer, indexerStage, &pipeline )) )
+        {
+            while ( started < classifiers && startStage( &classifier[ started ], classifierStage, &pipeline ) )
+            {
+                ++started;
             }
+            haveReader = ( started == classifiers && startStage( &reader, readerStage, &pipeline ) );
         }
-    }
 
-    return result;
-}
+        /* stand in for the stages that didn't start, so the ones that did still see their end markers */
+        tQueueCounts counts;
+        memset( &counts, 0, sizeof( counts ) );
+        for ( unsigned int i = 0; i < started && ! haveReader; ++i )
+        {
+            queuePush( pipeline.spans, NULL, &counts );
+        }
+        for ( unsigned int i = started; i < classifiers && haveIndexer; ++i )
+        {
+            queuePush( pipeline.entries, NULL, &counts );
+        }
+        if ( haveWriter && ! haveIndexer )
+        {
+            ringPush( pipeline.channels, NULL, &counts );
+        }
 
-/**
- * @brief
- * @param path
- * @return
- */
-int processFile( const char * path )
-{
-    int result = 0;
+        if ( haveReader )
+        {
+            pthread_join( reader, NULL );
+        }
+        for ( unsigned int i = 0; i < started; ++i )
+        {
+            pthread_join( classifier[ i ], NULL );
+        }
+        if ( haveIndexer )
+        {
+            pthread_join( indexer, NULL );
+        }
+        if ( haveWriter )
+        {
+            pthread_join( writer, NULL );
+        }
 
-    FILE * inputFile = fopen( path, "r" );
+        result = atomic_load( &pipeline.failed );
+        result = endSplit( result != 0 ? result : pipeline.result, stats );
+        if ( global.profileCount > 0 && result == 0 )
+        {
+            result = exportProfiles( stats );
+        }
+        if ( global.query.count > 0 && result == 0 )
+        {
+            result = exportQueries( global.outputFile, stats );
+        }
+        if ( global.guide != NULL && result == 0 )
+        {
+            joinGuide( stats );
+        }
+        if ( stats )
+        {
+            fprintf( stderr, "pipeline: %lu entries, %u classifier threads\n",
+                     atomic_load( &pipeline.indexed ), classifiers );
+            queueReport( stderr, "reader -> classifier", pipeline.spans );
+            queueReport( stderr, "classifier -> indexer", pipeline.entries );
+            ringReport(  stderr, "indexer -> writer", pipeline.channels );
+            internReport( stderr, "strings", global.strings );
+            if ( global.mapping != NULL )
+            {
+                mappingReport( stderr, global.mapping );
+            }
+            if ( global.top.k > 0 )
+            {
+                reportTop( stderr );
+            }
+        }
 
-    if ( inputFile == NULL )
-    {
-        result = -errno;
-        fprintf( stderr, "### unable to open \'%s\' (%d: %s)\n", path, errno, strerror(errno) );
+        shardFree( global.index.channel );
+        shardFree( global.index.group );
     }
-    else
-    {
-        global.tree.channel = btree_new( sizeof( tChannel * ), 0, compareChannels, NULL );
-        global.tree.group   = btree_new( sizeof( tGroup * ),   0, compareGroups,   NULL );
 
-        importM3U( inputFile );
-        exportM3U( stdout );
+    free( classifier );
+    queueFree( pipeline.spans );
+    queueFree( pipeline.entries );
+    ringFree( pipeline.channels );
 
-        btree_free( global.tree.channel );
-        btree_free( global.tree.group );
+    if ( pipeline.size > 0 )
+    {
+        munmap( (void *)pipeline.data, pipeline.size );
     }
+    close( fd );
 
     return result;
 }
@@ -1660,7 +5199,26 @@ static struct
 {
     struct arg_lit  * help;
     struct arg_lit  * version;
+    struct arg_file * output;
+    struct arg_file * snapshot;
+    struct arg_file * numbers;
+    struct arg_str  * numberRange;
     struct arg_file * mapping;
+    struct arg_int  * fuzzy;
+    struct arg_file * probes;
+    struct arg_file * xmltv;
+    struct arg_file * xmltvOut;
+    struct arg_str  * split;
+    struct arg_int  * splitMax;
+    struct arg_str  * splitPrefix;
+    struct arg_int  * top;
+    struct arg_str  * weight;
+    struct arg_str  * profile;
+    struct arg_str  * query;
+    struct arg_str  * format;
+    struct arg_int  * threads;
+    struct arg_lit  * stats;
+    struct arg_lit  * columnar;
     struct arg_str  * extn;
     struct arg_file * file;
     struct arg_end  * end;
@@ -1692,8 +5250,46 @@ int main( int argc, char * argv[] )
                                         "display version info (and exit)" ),
             gOption.extn    = arg_strn( "x", "extension", "<extension>", 0, 1,
                                         "set the extension to use for output files" ),
+            gOption.output  = arg_filen( "o", "output", "<file>", 0, 1,
+                                        "write the playlist to <file> instead of stdout, replacing it only once it's complete" ),
+            gOption.snapshot = arg_filen( NULL, "snapshot", "<file>", 0, 1,
+                                        "report the channels added, removed or changed since the run that saved <file>. With --output, an unchanged playlist isn't rewritten; --split files always are" ),
+            gOption.numbers = arg_filen( NULL, "numbers", "<file>", 0, 1,
+                                        "add a tvg-chno to each channel, keeping the numbers given out by earlier runs in <file>. The provider's tvg-chno are dropped, so they can't clash" ),
+            gOption.numberRange = arg_strn( NULL, "number-range", "<pattern>=<first>-<last>", 0, 16,
+                                        "number new channels in groups matching <pattern> from <first> to <last>. Other groups, and channels whose range is full, are numbered after the highest range" ),
             gOption.mapping = arg_filen("m", "mapping", "<file>", 0, 1,
                                         "channel mapping file" ),
+            gOption.fuzzy   = arg_intn( NULL, "fuzzy", "<edits>", 0, 1,
+                                        "if a name isn't in the mapping file, use the closest one within <edits> edits" ),
+            gOption.probes  = arg_filen( NULL, "probes", "<file>", 0, 1,
+                                        "order each channel's streams by the startup latency measured in <file>, a TSV of <url>, <ms>" ),
+            gOption.xmltv   = arg_filen( NULL, "xmltv", "<file>", 0, 1,
+                                        "XMLTV guide to match to the channels by tvg-id" ),
+            gOption.xmltvOut = arg_filen( NULL, "xmltv-output", "<file>", 0, 1,
+                                        "write the XMLTV guide for just the channels being kept to <file>" ),
+            gOption.split   = arg_strn( NULL, "split", "<key>", 0, 1,
+                                        "split the output into a file for each country, genre, region, dma, or group:<pattern>,..." ),
+            gOption.splitMax = arg_intn( NULL, "split-max", "<n>", 0, 1,
+                                        "put at most <n> channels in each split file, continuing in another" ),
+            gOption.splitPrefix = arg_strn( NULL, "split-prefix", "<prefix>", 0, 1,
+                                        "start the split file names with <prefix>, instead of the input file's name" ),
+            gOption.top     = arg_intn( NULL, "top", "<k>", 0, 1,
+                                        "only output the <k> highest scoring channels" ),
+            gOption.weight  = arg_strn( NULL, "weight", "<name>=<n>", 0, 5,
+                                        "how much resolution, tms, language, affiliate or streams count towards a channel's score" ),
+            gOption.profile = arg_strn( NULL, "profile", "<file>=<rules>", 0, 16,
+                                        "write <file> instead of the usual output, filtered by <rules>: default, country:, genre:, nogenre:, language:, resolution: or local:<country>[/<city>]" ),
+            gOption.query   = arg_strn( "q", "query", "<query>", 0, 16,
+                                        "list the channels that match <query>, e.g. 'country:UK and resolution:FHD', instead of the usual output" ),
+            gOption.format  = arg_strn( NULL, "format", "<format>", 0, 1,
+                                        "write query results as m3u (the default), tsv or json" ),
+            gOption.threads = arg_intn( "j", "threads", "<n>", 0, 1,
+                                        "classify entries on <n> threads, pipelining the reading, indexing and writing" ),
+            gOption.stats   = arg_litn( NULL, "stats", 0, 1,
+                                        "report processing statistics to stderr" ),
+            gOption.columnar = arg_litn( NULL, "columnar", 0, 1,
+                                        "select the channels to output with the vectorized columnar filter" ),
             gOption.file    = arg_filen(NULL, NULL, "<file>", 1, 20,
                                         "input files" ),
 
@@ -1726,18 +5322,191 @@ int main( int argc, char * argv[] )
     else
     {
         global.outputFile = NULL;
+        global.phrases    = buildPhraseMatcher();
+        global.cold       = tableNew( sizeof( tCold ) );
+        global.strings    = internNew( kIndexShards );
+        global.unknownFields = tallyNew( kMaxUnknownFields );
+        global.unknownExtensions = tallyNew( kMaxUnknownExtensions );
+        global.hosts      = hostNew();
 
         result = 0;
         for ( int i = 0; i < gOption.mapping->count && result == 0; i++ )
         {
             result = processMapping( gOption.mapping->filename[i] );
         }
+        if ( result == 0 && global.mapping != NULL && gOption.fuzzy->count > 0 )
+        {
+            result = mappingApproximate( global.mapping, bound( gOption.fuzzy->ival[0], 0, kFuzzyMaxDistance ) );
+        }
+        if ( result == 0 && global.mapping != NULL )
+        {
+            result = indexCallsigns();
+        }
+        if ( result == 0 && gOption.probes->count > 0 )
+        {
+            result = processProbes( gOption.probes->filename[0] );
+        }
+        if ( result == 0 && gOption.xmltv->count > 0 )
+        {
+            result = processGuide( gOption.xmltv->filename[0] );
+            if ( gOption.xmltvOut->count > 0 )
+            {
+                global.guideOutput = gOption.xmltvOut->filename[0];
+            }
+        }
+        else if ( gOption.xmltvOut->count > 0 )
+        {
+            fprintf( stderr, "### --xmltv-output writes a trimmed copy of the guide, so needs --xmltv\n" );
+            result = -EINVAL;
+        }
+        if ( gOption.top->count > 0 && gOption.top->ival[0] > 0 )
+        {
+            global.top.k = gOption.top->ival[0];
+        }
+        /* a channel scores for being in the language the filters keep */
+        tFilterPolicy policy;
+        initFilterPolicy( &policy );
+        global.top.language          = policy.language;
+        global.top.weight.resolution = 4;
+        global.top.weight.tms        = 8;
+        global.top.weight.language   = 2;
+        global.top.weight.affiliate  = 3;
+        global.top.weight.streams    = 1;
+        for ( int i = 0; i < gOption.weight->count && result == 0; i++ )
+        {
+            result = parseWeight( gOption.weight->sval[i] );
+        }
+        for ( int i = 0; i < gOption.profile->count && result == 0; i++ )
+        {
+            result = parseProfile( gOption.profile->sval[i] );
+        }
+        global.query.expression = gOption.query->sval;
+        global.query.count      = gOption.query->count;
+        if ( gOption.format->count > 0 )
+        {
+            if ( strcasecmp( gOption.format->sval[0], "tsv" ) == 0 )
+            {
+                global.query.format = kQueryFormatTSV;
+            }
+            else if ( strcasecmp( gOption.format->sval[0], "json" ) == 0 )
+            {
+                global.query.format = kQueryFormatJSON;
+            }
+            else if ( strcasecmp( gOption.format->sval[0], "m3u" ) != 0 )
+            {
+                fprintf( stderr, "### unknown format \'%s\' (expected m3u, tsv or json)\n", gOption.format->sval[0] );
+                result = -EINVAL;
+            }
+        }
+        if ( gOption.output->count > 0 )
+        {
+            global.output.path = gOption.output->filename[0];
+        }
+        if ( gOption.snapshot->count > 0 )
+        {
+            global.delta.path = gOption.snapshot->filename[0];
+            if ( global.profileCount > 0 || global.query.count > 0 )
+            {
+                fprintf( stderr, "### --snapshot compares the playlist, so can't be used with --profile or --query\n" );
+                result = -EINVAL;
+            }
+        }
+        if ( gOption.split->count > 0 && global.output.path != NULL )
+        {
+            /* nothing would be written to it */
+            fprintf( stderr, "### --split writes each part to a file of its own, so can't be used with --output\n" );
+            result = -EINVAL;
+        }
+        if ( global.profileCount > 0 && ( global.top.k > 0 || gOption.split->count > 0 ) )
+        {
+            /* the profiles are written whole, each to the one file */
+            fprintf( stderr, "### --profile writes every channel it selects to its own file, so can't be used with --top or --split\n" );
+            result = -EINVAL;
+        }
+        if ( result == 0 && gOption.numbers->count > 0 )
+        {
+            result = beginNumbering( gOption.numbers->filename[0], gOption.numberRange->sval, gOption.numberRange->count );
+        }
+        if ( result == 0 && gOption.split->count > 0 )
+        {
+            result = parseSplitKey( gOption.split->sval[0] );
+            global.split.extension = gOption.extn->count > 0 ? gOption.extn->sval[0] : "m3u";
+            if ( global.split.extension[0] == '.' )
+            {
+                global.split.extension++;
+            }
+            if ( gOption.splitPrefix->count > 0 )
+            {
+                global.split.prefix = gOption.splitPrefix->sval[0];
+            }
+            if ( gOption.splitMax->count > 0 && gOption.splitMax->ival[0] > 0 )
+            {
+                global.split.cap = gOption.splitMax->ival[0];
+            }
+        }
+        /* every input goes into the one output, which is only replaced once they're all written */
+        bool output = ( result == 0 );
+        if ( output )
+        {
+            result = beginOutput();
+        }
         for ( int i = 0; i < gOption.file->count && result == 0; i++ )
         {
-            result = processFile( gOption.file->filename[i] );
+            if ( gOption.threads->count > 0 && gOption.threads->ival[0] > 0 )
+            {
+                result = processFilePipelined( gOption.file->filename[i],
+                                               gOption.threads->ival[0],
+                                               gOption.stats->count > 0 );
+            }
+            else
+            {
+                result = processFile( gOption.file->filename[i],
+                                      gOption.columnar->count > 0,
+                                      gOption.stats->count > 0 );
+            }
+        }
+        if ( output )
+        {
+            result = endOutput( result, gOption.stats->count > 0 );
+        }
+        result = endGuide( result, gOption.stats->count > 0 );
+        reportUnknownFields( stderr );
+        reportUnknownExtensions( stderr, gOption.stats->count > 0 );
+        if ( gOption.stats->count > 0 )
+        {
+            reportHosts( stderr );
+            if ( global.probes != NULL )
+            {
+                probesReport( stderr, global.probes );
+            }
+        }
+        if ( gOption.numbers->count > 0 )
+        {
+            result = endNumbering( gOption.numbers->filename[0], result, gOption.stats->count > 0 );
         }
     }
 
+    phraseFree( global.phrases );
+    tableFree( global.cold );
+    internFree( global.strings );
+    tallyFree( global.unknownFields );
+    tallyFree( global.unknownExtensions );
+    hostFree( global.hosts );
+    probesFree( global.probes );
+    mappingFree( global.mapping );
+    free( global.callsignTMS );
+    xmltvFree( global.guide );
+    for ( unsigned int i = 0; i < global.profileCount; i++ )
+    {
+        free( (void *)global.profile[ i ].path );
+    }
+    free( global.profile );
+    if ( global.split.pattern != NULL )
+    {
+        free( global.split.pattern[0] );
+        free( global.split.pattern );
+    }
+
     /* release each non-null entry in argtable[] */
     arg_freetable( argtable, sizeof( argtable ) / sizeof( argtable[0] ));
 
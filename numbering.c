@@ -0,0 +1,530 @@
+//
+// Created by paul on 10/19/26.
+//
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "bitmap.h"
+#include "radix.h"
+#include "numbering.h"
+
+#define kNumberingMagic     "mungeCHN"
+#define kNumberingVersion   1
+
+typedef struct {
+    char           magic[ 8 ];
+    uint32_t       version;
+    uint32_t       count;
+} tNumberingHeader;
+
+typedef struct {
+    tFingerprint   key;
+    uint32_t       number;
+    uint32_t       unused;
+} tNumberingRecord;
+
+typedef struct {
+    uint32_t       first;
+    uint32_t       last;
+    uint32_t       next;        /* no number below this is free */
+} tNumberingRange;
+
+struct sNumbering {
+    pthread_mutex_t          lock;
+
+    const char *             data;      /* the mapped file, or NULL */
+    size_t                   size;
+    const tNumberingRecord * saved;     /* sorted by fingerprint */
+    size_t                   savedCount;
+
+    tNumberingRecord *       added;     /* assigned by this run */
+    size_t                   addedCount;
+    size_t                   capacity;
+    uint32_t *               slot;      /* 1 + the index into 'added', or 0 if empty */
+    size_t                   mask;
+
+    tBitmap *                used;      /* every number that's been given out */
+    tNumberingRange *        range;
+    unsigned int             rangeCount;
+    int                      overflow;  /* the range a full one overflows into, or -1 */
+
+    size_t                   overflowed;    /* channels numbered from the overflow, as their range was full */
+    size_t                   exhausted; /* lookups whose range, and the overflow, had no number left */
+};
+
+/**
+ * @brief
+ * @return an empty table
+ */
+tNumbering * numberingNew( void )
+{
+    tNumbering * numbering = calloc( 1, sizeof( tNumbering ) );
+
+    if ( numbering != NULL )
+    {
+        numbering->used = bitmapNew();
+        if ( numbering->used == NULL )
+        {
+            free( numbering );
+            return NULL;
+        }
+        pthread_mutex_init( &numbering->lock, NULL );
+        numbering->overflow = -1;
+    }
+    return numbering;
+}
+
+/**
+ * @brief
+ * @param numbering
+ */
+void numberingFree( tNumbering * numbering )
+{
+    if ( numbering != NULL )
+    {
+        if ( numbering->data != NULL )
+        {
+            munmap( (void *)numbering->data, numbering->size );
+        }
+        pthread_mutex_destroy( &numbering->lock );
+        bitmapFree( numbering->used );
+        free( numbering->added );
+        free( numbering->slot );
+        free( numbering->range );
+        free( numbering );
+    }
+}
+
+static bool validTable( const char * data, size_t size )
+{
+    const tNumberingHeader * header = (const tNumberingHeader *)data;
+
+    if ( size < sizeof( tNumberingHeader )
+      || memcmp( header->magic, kNumberingMagic, sizeof( header->magic ) ) != 0
+      || header->version != kNumberingVersion
+      || (size - sizeof( tNumberingHeader )) / sizeof( tNumberingRecord ) < header->count )
+    {
+        return false;
+    }
+
+    const tNumberingRecord * record = (const tNumberingRecord *)(data + sizeof( tNumberingHeader ));
+    for ( uint32_t i = 1; i < header->count; ++i )
+    {
+        if ( record[ i ].key <= record[ i - 1 ].key )
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief map the numbers given out by earlier runs. A missing file is the same as an empty table.
+ * @param numbering must be empty
+ * @param path
+ * @return 0, or a negative errno
+ */
+int numberingLoad( tNumbering * numbering, const char * path )
+{
+    int         result = 0;
+    struct stat st;
+
+    int fd = open( path, O_RDONLY );
+    if ( fd < 0 && errno == ENOENT )
+    {
+        /* the first run */
+        return 0;
+    }
+    if ( fd < 0 || fstat( fd, &st ) != 0 )
+    {
+        result = -errno;
+        fprintf( stderr, "### unable to open \'%s\' (%d: %s)\n", path, errno, strerror(errno) );
+        if ( fd >= 0 ) close( fd );
+        return result;
+    }
+    if ( st.st_size == 0 )
+    {
+        close( fd );
+        return 0;
+    }
+
+    const char * data = mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    close( fd );
+    if ( data == MAP_FAILED )
+    {
+        result = -errno;
+        fprintf( stderr, "### unable to map \'%s\' (%d: %s)\n", path, errno, strerror(errno) );
+        return result;
+    }
+    if ( ! validTable( data, st.st_size ) )
+    {
+        /* don't quietly renumber everything */
+        fprintf( stderr, "### \'%s\' is not a channel number table\n", path );
+        munmap( (void *)data, st.st_size );
+        return -EINVAL;
+    }
+
+    numbering->data       = data;
+    numbering->size       = st.st_size;
+    numbering->saved      = (const tNumberingRecord *)(data + sizeof( tNumberingHeader ));
+    numbering->savedCount = ((const tNumberingHeader *)data)->count;
+
+    for ( size_t i = 0; i < numbering->savedCount; ++i )
+    {
+        if ( ! bitmapAdd( numbering->used, numbering->saved[ i ].number ) )
+        {
+            return -ENOMEM;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief add a range of numbers to give new channels
+ * @param numbering
+ * @param first
+ * @param last      inclusive
+ * @return the range's index, to pass to numberingAssign, or a negative errno
+ */
+int numberingAddRange( tNumbering * numbering, uint32_t first, uint32_t last )
+{
+    if ( first == 0 || last < first )
+    {
+        return -EINVAL;
+    }
+
+    tNumberingRange * range = realloc( numbering->range, (numbering->rangeCount + 1) * sizeof( tNumberingRange ) );
+    if ( range == NULL )
+    {
+        return -ENOMEM;
+    }
+    numbering->range = range;
+    range = &numbering->range[ numbering->rangeCount ];
+    range->first = first;
+    range->last  = last;
+    range->next  = first;
+
+    return (int)numbering->rangeCount++;
+}
+
+/**
+ * @brief add the range of numbers given to new channels whose own range is full
+ * @param numbering
+ * @param first
+ * @param last      inclusive
+ * @return the range's index, to pass to numberingAssign, or a negative errno
+ */
+int numberingAddOverflow( tNumbering * numbering, uint32_t first, uint32_t last )
+{
+    int range = numberingAddRange( numbering, first, last );
+
+    if ( range >= 0 )
+    {
+        numbering->overflow = range;
+    }
+    return range;
+}
+
+static bool growSlots( tNumbering * numbering )
+{
+    size_t     mask = numbering->mask ? numbering->mask * 2 + 1 : 1023;
+    uint32_t * slot = calloc( mask + 1, sizeof( uint32_t ) );
+
+    if ( slot == NULL )
+    {
+        return false;
+    }
+    for ( size_t i = 0; i <= numbering->mask && numbering->slot != NULL; ++i )
+    {
+        if ( numbering->slot[ i ] != 0 )
+        {
+            size_t s = numbering->added[ numbering->slot[ i ] - 1 ].key & mask;
+            while ( slot[ s ] != 0 )
+            {
+                s = (s + 1) & mask;
+            }
+            slot[ s ] = numbering->slot[ i ];
+        }
+    }
+    free( numbering->slot );
+    numbering->slot = slot;
+    numbering->mask = mask;
+
+    return true;
+}
+
+static uint32_t * findSlot( tNumbering * numbering, tFingerprint key )
+{
+    size_t s = key & numbering->mask;
+
+    while ( numbering->slot[ s ] != 0 && numbering->added[ numbering->slot[ s ] - 1 ].key != key )
+    {
+        s = (s + 1) & numbering->mask;
+    }
+    return &numbering->slot[ s ];
+}
+
+static const tNumberingRecord * findSaved( const tNumbering * numbering, tFingerprint key )
+{
+    size_t low  = 0;
+    size_t high = numbering->savedCount;
+
+    while ( low < high )
+    {
+        size_t middle = low + (high - low) / 2;
+        if ( numbering->saved[ middle ].key < key )
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+    return ( low < numbering->savedCount && numbering->saved[ low ].key == key ) ? &numbering->saved[ low ] : NULL;
+}
+
+/* the lowest number in the range nothing has been given yet, or 0 if there isn't one */
+static uint32_t nextFree( tNumbering * numbering, tNumberingRange * range )
+{
+    while ( range->next <= range->last && bitmapContains( numbering->used, range->next ) )
+    {
+        range->next++;
+    }
+    if ( range->next > range->last )
+    {
+        return 0;
+    }
+    return range->next++;
+}
+
+/* the caller holds the lock */
+static uint32_t assign( tNumbering * numbering, tFingerprint key, unsigned int range )
+{
+    const tNumberingRecord * saved = findSaved( numbering, key );
+    if ( saved != NULL )
+    {
+        return saved->number;
+    }
+
+    if ( 2 * (numbering->addedCount + 1) > numbering->mask && ! growSlots( numbering ) )
+    {
+        return 0;
+    }
+    uint32_t * slot = findSlot( numbering, key );
+    if ( *slot != 0 )
+    {
+        return numbering->added[ *slot - 1 ].number;
+    }
+
+    uint32_t number = range < numbering->rangeCount ? nextFree( numbering, &numbering->range[ range ] ) : 0;
+    if ( number == 0 && numbering->overflow >= 0 && range != (unsigned int)numbering->overflow )
+    {
+        /* rather than leave the channel to be numbered by where it is in the playlist */
+        number = nextFree( numbering, &numbering->range[ numbering->overflow ] );
+        numbering->overflowed += ( number != 0 );
+    }
+    if ( number == 0 )
+    {
+        numbering->exhausted++;
+        return 0;
+    }
+
+    if ( numbering->addedCount == numbering->capacity )
+    {
+        size_t capacity = numbering->capacity > 0 ? numbering->capacity * 2 : 256;
+        tNumberingRecord * added = realloc( numbering->added, capacity * sizeof( tNumberingRecord ) );
+        if ( added == NULL )
+        {
+            return 0;
+        }
+        numbering->added    = added;
+        numbering->capacity = capacity;
+    }
+    if ( ! bitmapAdd( numbering->used, number ) )
+    {
+        return 0;
+    }
+
+    tNumberingRecord * record = &numbering->added[ numbering->addedCount++ ];
+    record->key    = key;
+    record->number = number;
+    record->unused = 0;
+    *slot = (uint32_t)numbering->addedCount;
+
+    return number;
+}
+
+/**
+ * @brief the channel's number, giving it one from the range if it doesn't have one yet,
+ *        or from the overflow range if that one is full.
+ *        A channel keeps the number it has, even if it's not in the range.
+ *        Safe to call from several threads.
+ * @param numbering
+ * @param key       the channel's fingerprint
+ * @param range     as returned by numberingAddRange
+ * @return the channel's number, or 0 if the range and the overflow are both full
+ */
+uint32_t numberingAssign( tNumbering * numbering, tFingerprint key, unsigned int range )
+{
+    pthread_mutex_lock( &numbering->lock );
+    uint32_t number = assign( numbering, key, range );
+    pthread_mutex_unlock( &numbering->lock );
+
+    return number;
+}
+
+/**
+ * @brief save the table, if any numbers were given out since it was loaded,
+ *        replacing the file only once it's been written in full
+ * @param numbering
+ * @param path
+ * @return 0, or a negative errno
+ */
+int numberingSave( tNumbering * numbering, const char * path )
+{
+    int result = 0;
+
+    if ( numbering->addedCount == 0 )
+    {
+        /* leave the file alone */
+        return 0;
+    }
+
+    size_t             count  = numbering->savedCount + numbering->addedCount;
+    tNumberingRecord * merged = malloc( count * sizeof( tNumberingRecord ) );
+    tSortKey *         keys   = malloc( numbering->addedCount * sizeof( tSortKey ) );
+    size_t             length = strlen( path );
+    char *             temporary = malloc( length + sizeof( ".new" ) );
+
+    if ( merged == NULL || keys == NULL || temporary == NULL )
+    {
+        free( merged );
+        free( keys );
+        free( temporary );
+        return -ENOMEM;
+    }
+    memcpy( temporary, path, length );
+    memcpy( temporary + length, ".new", sizeof( ".new" ) );
+
+    /* sort the new numbers by fingerprint, then merge them in with the saved ones */
+    for ( size_t i = 0; i < numbering->addedCount; ++i )
+    {
+        tFingerprint key = numbering->added[ i ].key;
+
+        memset( keys[ i ].key, 0, kSortKeyBytes );
+        for ( int b = 0; b < 8; ++b )
+        {
+            keys[ i ].key[ b ] = (uint8_t)(key >> (56 - 8 * b));
+        }
+        keys[ i ].index = (uint32_t)i;
+    }
+    if ( ! radixSort( keys, numbering->addedCount, NULL, NULL ) )
+    {
+        free( merged );
+        free( keys );
+        free( temporary );
+        return -ENOMEM;
+    }
+
+    size_t s = 0, a = 0, m = 0;
+    while ( s < numbering->savedCount || a < numbering->addedCount )
+    {
+        if ( a == numbering->addedCount
+          || ( s < numbering->savedCount && numbering->saved[ s ].key < numbering->added[ keys[ a ].index ].key ) )
+        {
+            merged[ m++ ] = numbering->saved[ s++ ];
+        }
+        else
+        {
+            merged[ m++ ] = numbering->added[ keys[ a++ ].index ];
+        }
+    }
+    free( keys );
+
+    tNumberingHeader header;
+    memset( &header, 0, sizeof( header ) );
+    memcpy( header.magic, kNumberingMagic, sizeof( header.magic ) );
+    header.version = kNumberingVersion;
+    header.count   = (uint32_t)m;
+
+    FILE * file = fopen( temporary, "w" );
+    if ( file == NULL )
+    {
+        result = -errno;
+        fprintf( stderr, "### unable to open \'%s\' (%d: %s)\n", temporary, errno, strerror(errno) );
+    }
+    else
+    {
+        fwrite( &header, sizeof( header ), 1, file );
+        fwrite( merged, sizeof( tNumberingRecord ), m, file );
+
+        if ( ferror( file ) | fclose( file ) )
+        {
+            result = -errno;
+            fprintf( stderr, "### unable to write \'%s\' (%d: %s)\n", temporary, errno, strerror(errno) );
+            unlink( temporary );
+        }
+        else if ( rename( temporary, path ) != 0 )
+        {
+            result = -errno;
+            fprintf( stderr, "### unable to replace \'%s\' (%d: %s)\n", path, errno, strerror(errno) );
+            unlink( temporary );
+        }
+    }
+    free( merged );
+    free( temporary );
+
+    return result;
+}
+
+/**
+ * @brief
+ * @param output
+ * @param numbering
+ */
+void numberingReport( FILE * output, tNumbering * numbering )
+{
+    fprintf( output, "numbers: %zu in use, %zu given out by this run",
+             bitmapCardinality( numbering->used ), numbering->addedCount );
+    if ( numbering->overflowed > 0 )
+    {
+        fprintf( output, ", %zu from the overflow as their range was full", numbering->overflowed );
+    }
+    if ( numbering->exhausted > 0 )
+    {
+        fprintf( output, ", %zu channels left without one", numbering->exhausted );
+    }
+    fprintf( output, "\n" );
+}
+
+/**
+ * @brief warn about the channels that didn't get a number from their own range, whether or not
+ *        the stats are being reported, as they'd be given one by where they are in the playlist
+ * @param output
+ * @param numbering
+ */
+void numberingWarn( FILE * output, tNumbering * numbering )
+{
+    if ( numbering->overflowed > 0 )
+    {
+        fprintf( output, "Warning: %zu channels were numbered after the highest range, as their own range was full\n",
+                 numbering->overflowed );
+    }
+    if ( numbering->exhausted > 0 )
+    {
+        fprintf( output, "### %zu channels have no number, as there are none left in their range\n",
+                 numbering->exhausted );
+    }
+}
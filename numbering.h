@@ -0,0 +1,40 @@
+//
+// Created by paul on 10/19/26.
+//
+
+#ifndef MUNGEM3U_NUMBERING_H
+#define MUNGEM3U_NUMBERING_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "fingerprint.h"
+
+/*
+ * Channel numbers that stay the same from run to run. Once a channel has
+ * been given a number, it keeps it for as long as the table is kept, even if
+ * it goes missing for a while. A new channel is given the lowest number
+ * that's free in the range it's assigned from, or if that range is full,
+ * from the overflow range after all the others. The table is saved as
+ * fingerprint/number pairs sorted by fingerprint, and mapped rather than
+ * read. It's in the machine's byte order.
+ */
+
+typedef struct sNumbering tNumbering;
+
+tNumbering * numberingNew( void );
+void numberingFree( tNumbering * numbering );
+
+int numberingLoad( tNumbering * numbering, const char * path );
+int numberingSave( tNumbering * numbering, const char * path );
+
+int numberingAddRange( tNumbering * numbering, uint32_t first, uint32_t last );
+int numberingAddOverflow( tNumbering * numbering, uint32_t first, uint32_t last );
+uint32_t numberingAssign( tNumbering * numbering, tFingerprint key, unsigned int range );
+
+void numberingReport( FILE * output, tNumbering * numbering );
+void numberingWarn( FILE * output, tNumbering * numbering );
+
+#endif //MUNGEM3U_NUMBERING_H
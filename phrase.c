@@ -0,0 +1,317 @@
+//
+// Created by paul on 10/19/26.
+//
+#include <stdlib.h>
+#include <string.h>
+
+#include "phrase.h"
+
+typedef unsigned int tPhraseState;
+
+#define kPhraseRoot     ((tPhraseState)0)
+
+typedef struct {
+    tPhraseState  parent;
+    tPhraseState  fail;
+    tPhraseState  output;   /* next state down the fail chain that completes a phrase */
+    tHash         token;    /* token hash on the edge from the parent */
+    unsigned int  depth;
+    bool          terminal;
+    int           tag;
+} tPhraseNode;
+
+typedef struct {
+    tPhraseState  from;
+    tPhraseState  to;       /* kPhraseRoot marks an empty slot */
+    tHash         token;
+} tPhraseEdge;
+
+struct sPhraseMatcher {
+    tPhraseNode * node;
+    unsigned int  nodeCount;
+    unsigned int  nodeSize;
+
+    tPhraseEdge * edge;
+    unsigned int  edgeCount;
+    unsigned int  edgeMask;     /* edge table size is always a power of two */
+
+    unsigned int  phrases;
+};
+
+static inline unsigned int edgeSlot( tPhraseState from, tHash token, unsigned int mask )
+{
+    unsigned long h = (unsigned long)token * 0x9E3779B97F4A7C15UL + from;
+    return (unsigned int)( h ^ (h >> 29) ) & mask;
+}
+
+/**
+ * @brief follow the edge from 'from' labelled 'token'
+ * @return the destination state, or kPhraseRoot if there is no such edge
+ */
+static tPhraseState edgeGet( tPhraseMatcher * matcher, tPhraseState from, tHash token )
+{
+    unsigned int i = edgeSlot( from, token, matcher->edgeMask );
+
+    while ( matcher->edge[ i ].to != kPhraseRoot )
+    {
+        if ( matcher->edge[ i ].from == from && matcher->edge[ i ].token == token )
+        {
+            return matcher->edge[ i ].to;
+        }
+        i = (i + 1) & matcher->edgeMask;
+    }
+    return kPhraseRoot;
+}
+
+static void edgeInsert( tPhraseEdge * table, unsigned int mask, tPhraseState from, tHash token, tPhraseState to )
+{
+    unsigned int i = edgeSlot( from, token, mask );
+
+    while ( table[ i ].to != kPhraseRoot )
+    {
+        i = (i + 1) & mask;
+    }
+    table[ i ].from  = from;
+    table[ i ].token = token;
+    table[ i ].to    = to;
+}
+
+static bool edgeGrow( tPhraseMatcher * matcher )
+{
+    unsigned int  mask  = matcher->edgeMask * 2 + 1;
+    tPhraseEdge * table = calloc( mask + 1, sizeof( tPhraseEdge ) );
+
+    if ( table == NULL )
+    {
+        return false;
+    }
+
+    for ( unsigned int i = 0; i <= matcher->edgeMask; ++i )
+    {
+        tPhraseEdge * e = &matcher->edge[ i ];
+        if ( e->to != kPhraseRoot )
+        {
+            edgeInsert( table, mask, e->from, e->token, e->to );
+        }
+    }
+    free( matcher->edge );
+    matcher->edge     = table;
+    matcher->edgeMask = mask;
+
+    return true;
+}
+
+/**
+ * @brief
+ * @return
+ */
+tPhraseMatcher * phraseNew( void )
+{
+    tPhraseMatcher * matcher = calloc( 1, sizeof( tPhraseMatcher ) );
+
+    if ( matcher != NULL )
+    {
+        matcher->nodeSize = 64;
+        matcher->node     = calloc( matcher->nodeSize, sizeof( tPhraseNode ) );
+        matcher->edgeMask = 127;
+        matcher->edge     = calloc( matcher->edgeMask + 1, sizeof( tPhraseEdge ) );
+
+        if ( matcher->node == NULL || matcher->edge == NULL )
+        {
+            phraseFree( matcher );
+            return NULL;
+        }
+        /* the root */
+        matcher->nodeCount = 1;
+    }
+    return matcher;
+}
+
+/**
+ * @brief
+ * @param matcher
+ */
+void phraseFree( tPhraseMatcher * matcher )
+{
+    if ( matcher != NULL )
+    {
+        free( matcher->node );
+        free( matcher->edge );
+        free( matcher );
+    }
+}
+
+/**
+ * @brief add a phrase to the trie. phraseBuild() must be called after the last one is added.
+ * @param matcher
+ * @param tokens    the hash of each word of the phrase, in order
+ * @param count     number of words in the phrase
+ * @param tag       caller-defined, reported when the phrase is matched
+ * @return false if out of memory
+ */
+bool phraseAdd( tPhraseMatcher * matcher, const tHash * tokens, unsigned int count, int tag )
+{
+    tPhraseState state = kPhraseRoot;
+
+    if ( count == 0 )
+    {
+        return true;
+    }
+
+    for ( unsigned int i = 0; i < count; ++i )
+    {
+        tPhraseState next = edgeGet( matcher, state, tokens[ i ] );
+        if ( next == kPhraseRoot )
+        {
+            if ( matcher->nodeCount == matcher->nodeSize )
+            {
+                tPhraseNode * node = realloc( matcher->node, 2 * matcher->nodeSize * sizeof( tPhraseNode ) );
+                if ( node == NULL )
+                {
+                    return false;
+                }
+                matcher->node      = node;
+                matcher->nodeSize *= 2;
+            }
+            /* keep the edge table no more than half full */
+            if ( 2 * (matcher->edgeCount + 1) > matcher->edgeMask && !edgeGrow( matcher ) )
+            {
+                return false;
+            }
+
+            next = matcher->nodeCount++;
+            memset( &matcher->node[ next ], 0, sizeof( tPhraseNode ) );
+            matcher->node[ next ].parent = state;
+            matcher->node[ next ].token  = tokens[ i ];
+            matcher->node[ next ].depth  = i + 1;
+
+            edgeInsert( matcher->edge, matcher->edgeMask, state, tokens[ i ], next );
+            matcher->edgeCount++;
+        }
+        state = next;
+    }
+
+    if ( ! matcher->node[ state ].terminal )
+    {
+        matcher->phrases++;
+    }
+    matcher->node[ state ].terminal = true;
+    matcher->node[ state ].tag      = tag;
+
+    return true;
+}
+
+/**
+ * @brief compute the failure and output links, breadth-first
+ * @param matcher
+ */
+void phraseBuild( tPhraseMatcher * matcher )
+{
+    unsigned int   maxDepth = 0;
+    unsigned int * order;
+    unsigned int * start;
+
+    for ( tPhraseState s = 1; s < matcher->nodeCount; ++s )
+    {
+        if ( matcher->node[ s ].depth > maxDepth )
+        {
+            maxDepth = matcher->node[ s ].depth;
+        }
+    }
+
+    /* counting sort of the states by depth, so every parent is linked before its children */
+    order = calloc( matcher->nodeCount, sizeof( unsigned int ) );
+    start = calloc( maxDepth + 2, sizeof( unsigned int ) );
+    if ( order == NULL || start == NULL )
+    {
+        free( order );
+        free( start );
+        return;
+    }
+
+    for ( tPhraseState s = 1; s < matcher->nodeCount; ++s )
+    {
+        start[ matcher->node[ s ].depth + 1 ]++;
+    }
+    for ( unsigned int d = 1; d <= maxDepth + 1; ++d )
+    {
+        start[ d ] += start[ d - 1 ];
+    }
+    for ( tPhraseState s = 1; s < matcher->nodeCount; ++s )
+    {
+        order[ start[ matcher->node[ s ].depth ]++ ] = s;
+    }
+
+    for ( unsigned int i = 0; i < matcher->nodeCount - 1; ++i )
+    {
+        tPhraseNode * node = &matcher->node[ order[ i ] ];
+        tPhraseState  fail = kPhraseRoot;
+
+        if ( node->parent != kPhraseRoot )
+        {
+            tPhraseState f = matcher->node[ node->parent ].fail;
+            for (;;)
+            {
+                fail = edgeGet( matcher, f, node->token );
+                if ( fail != kPhraseRoot || f == kPhraseRoot )
+                {
+                    break;
+                }
+                f = matcher->node[ f ].fail;
+            }
+        }
+        node->fail   = fail;
+        node->output = matcher->node[ fail ].terminal ? fail : matcher->node[ fail ].output;
+    }
+
+    free( order );
+    free( start );
+}
+
+/**
+ * @brief
+ * @param matcher
+ * @return the number of distinct phrases in the automaton
+ */
+unsigned int phraseCount( tPhraseMatcher * matcher )
+{
+    return matcher->phrases;
+}
+
+/**
+ * @brief run the token hashes through the automaton, reporting every phrase found
+ * @param matcher
+ * @param tokens
+ * @param count
+ * @param callback  invoked for each match, in order of the match's last token
+ * @param udata
+ */
+void phraseScan( tPhraseMatcher * matcher, const tHash * tokens, unsigned int count,
+                 tPhraseCallback callback, void * udata )
+{
+    tPhraseState state = kPhraseRoot;
+
+    for ( unsigned int i = 0; i < count; ++i )
+    {
+        tPhraseState next;
+        while ( (next = edgeGet( matcher, state, tokens[ i ] )) == kPhraseRoot && state != kPhraseRoot )
+        {
+            state = matcher->node[ state ].fail;
+        }
+        state = next;
+
+        tPhraseState s = matcher->node[ state ].terminal ? state : matcher->node[ state ].output;
+        while ( s != kPhraseRoot )
+        {
+            tPhraseNode * node = &matcher->node[ s ];
+            tPhraseMatch  match;
+
+            match.first = i + 1 - node->depth;
+            match.count = node->depth;
+            match.tag   = node->tag;
+            callback( &match, udata );
+
+            s = node->output;
+        }
+    }
+}
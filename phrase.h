@@ -0,0 +1,39 @@
+//
+// Created by paul on 10/19/26.
+//
+
+#ifndef MUNGEM3U_PHRASE_H
+#define MUNGEM3U_PHRASE_H
+
+#include <stdbool.h>
+#include <libhashstrings.h>
+
+/*
+ * An Aho-Corasick automaton whose alphabet is the hash of a separator-delimited
+ * token, rather than a character. Names are hashed a token at a time already,
+ * so matching over token hashes finds every multi-word phrase in a single pass
+ * over the name, without ever having to re-hash or re-scan characters.
+ */
+
+typedef struct {
+    unsigned int  first;    /* index of the first token of the match */
+    unsigned int  count;    /* number of tokens spanned by the match */
+    int           tag;      /* caller-supplied, given when the phrase was added */
+} tPhraseMatch;
+
+typedef struct sPhraseMatcher tPhraseMatcher;
+
+typedef void (*tPhraseCallback)( const tPhraseMatch * match, void * udata );
+
+tPhraseMatcher * phraseNew( void );
+void phraseFree( tPhraseMatcher * matcher );
+
+bool phraseAdd( tPhraseMatcher * matcher, const tHash * tokens, unsigned int count, int tag );
+void phraseBuild( tPhraseMatcher * matcher );
+
+unsigned int phraseCount( tPhraseMatcher * matcher );
+
+void phraseScan( tPhraseMatcher * matcher, const tHash * tokens, unsigned int count,
+                 tPhraseCallback callback, void * udata );
+
+#endif //MUNGEM3U_PHRASE_H
@@ -0,0 +1,64 @@
+//
+// Created by paul on 10/19/26.
+//
+
+#ifndef MUNGEM3U_PHRASES_H
+#define MUNGEM3U_PHRASES_H
+
+/* the dictionary that a keyword was found in */
+typedef enum {
+    kMatchUnset = 0,
+    kMatchCountry,
+    kMatchName,
+    kMatchResolution,
+    kMatchUSCallsign,
+    kMatchCity,
+    kMatchGenre,
+    kMatchCapitalization
+} tMatchCategory;
+
+/*
+ * Multi-word spellings that should be recognized as a single keyword, and
+ * the keyword each one stands for. The .hash dictionaries are matched one
+ * word at a time, so a phrase names its dictionary and index directly rather
+ * than needing a run-together spelling of its own there.
+ */
+typedef struct {
+    const char *    phrase;
+    tMatchCategory  category;
+    unsigned int    index;      /* in the category's dictionary */
+} tMultiWordPhrase;
+
+const tMultiWordPhrase multiWordPhrases[] =
+{
+    /* country.hash */
+    { "American Samoa",           kMatchCountry, kCountryAmericanSamoa  },
+    { "Costa Rica",               kMatchCountry, kCountryCostaRica      },
+    { "El Salvador",              kMatchCountry, kCountryElSalvador     },
+    { "Great Britain",            kMatchCountry, kCountryUnitedKingdom  },
+    { "Hong Kong",                kMatchCountry, kCountryHongKong       },
+    { "New Caledonia",            kMatchCountry, kCountryNewCaledonia   },
+    { "New Zealand",              kMatchCountry, kCountryNewZealand     },
+    { "Papua New Guinea",         kMatchCountry, kCountryPapuaNewGuinea },
+    { "Puerto Rico",              kMatchCountry, kCountryPuertoRico     },
+    { "San Marino",               kMatchCountry, kCountrySanMarino      },
+    { "Saudi Arabia",             kMatchCountry, kCountrySaudiArabia    },
+    { "South Africa",             kMatchCountry, kCountrySouthAfrica    },
+    { "South Korea",              kMatchCountry, kCountrySouthKorea     },
+    { "Sri Lanka",                kMatchCountry, kCountrySriLanka       },
+    { "United Kingdom",           kMatchCountry, kCountryUnitedKingdom  },
+    { "United States",            kMatchCountry, kCountryUnitedStates   },
+
+    /* genre.hash */
+    { "Catch Up",                 kMatchGenre,   kGenreCatchup          },
+    { "Sports and Entertainment", kMatchGenre,   kGenreEntertainment    },
+
+    /* name.hash */
+    { "On Demand",                kMatchName,    kNameVideoOnDemand     },
+    { "Pay Per View",             kMatchName,    kNamePayPerView        },
+    { "Video On Demand",          kMatchName,    kNameVideoOnDemand     },
+
+    { NULL,                       kMatchUnset,   0                      }
+};
+
+#endif //MUNGEM3U_PHRASES_H
@@ -0,0 +1,253 @@
+//
+// Created by paul on 10/19/26.
+//
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "fingerprint.h"
+#include "probe.h"
+
+typedef struct {
+    tFingerprint    url;        /* 0 if the slot is empty */
+    uint16_t        latency;
+} tProbeSlot;
+
+struct sProbes {
+    tProbeSlot *    slot;
+    size_t          mask;       /* slot count is always a power of two */
+    size_t          count;
+    size_t          failed;
+
+    /* the classifier threads' counts, added as each one finishes */
+    atomic_ulong    lookups;
+    atomic_ulong    matched;
+};
+
+/**
+ * @brief
+ * @return an empty set of results
+ */
+tProbes * probesNew( void )
+{
+    tProbes * probes = calloc( 1, sizeof( tProbes ) );
+
+    if ( probes != NULL )
+    {
+        atomic_init( &probes->lookups, 0 );
+        atomic_init( &probes->matched, 0 );
+    }
+    return probes;
+}
+
+/**
+ * @brief
+ * @param probes
+ */
+void probesFree( tProbes * probes )
+{
+    if ( probes != NULL )
+    {
+        free( probes->slot );
+        free( probes );
+    }
+}
+
+/* an empty slot is marked by a zero fingerprint, so that one is moved aside */
+static inline tFingerprint urlKey( const char * url, size_t length )
+{
+    tFingerprint key = fingerprint( url, length, 0 );
+    return key != 0 ? key : 1;
+}
+
+static tProbeSlot * findSlot( tProbeSlot * slot, size_t mask, tFingerprint key )
+{
+    size_t s = key & mask;
+
+    while ( slot[ s ].url != 0 && slot[ s ].url != key )
+    {
+        s = (s + 1) & mask;
+    }
+    return &slot[ s ];
+}
+
+static bool growSlots( tProbes * probes )
+{
+    size_t       mask = probes->mask ? probes->mask * 2 + 1 : 1023;
+    tProbeSlot * slot = calloc( mask + 1, sizeof( tProbeSlot ) );
+
+    if ( slot == NULL )
+    {
+        return false;
+    }
+    for ( size_t i = 0; i <= probes->mask && probes->slot != NULL; ++i )
+    {
+        if ( probes->slot[ i ].url != 0 )
+        {
+            *findSlot( slot, mask, probes->slot[ i ].url ) = probes->slot[ i ];
+        }
+    }
+    free( probes->slot );
+    probes->slot = slot;
+    probes->mask = mask;
+
+    return true;
+}
+
+/* the latency column: a number of milliseconds, or anything else for a failed probe */
+static uint16_t parseLatency( const char * p, const char * end )
+{
+    unsigned long latency = 0;
+    const char *  start   = p;
+
+    while ( p < end && *p >= '0' && *p <= '9' )
+    {
+        if ( latency <= kProbeMaxLatency )
+        {
+            latency = latency * 10 + (*p - '0');
+        }
+        ++p;
+    }
+    if ( p == start || ( p < end && *p != '.' && *p != '\t' && *p != '\r' ) )
+    {
+        return kProbeFailed;
+    }
+    return latency < kProbeMaxLatency ? (uint16_t)latency : kProbeMaxLatency;
+}
+
+/**
+ * @brief
+ * @param probes
+ * @param path
+ * @return 0, or a negative errno
+ */
+int probesLoad( tProbes * probes, const char * path )
+{
+    int         result = 0;
+    struct stat st;
+
+    int fd = open( path, O_RDONLY );
+    if ( fd < 0 || fstat( fd, &st ) != 0 )
+    {
+        result = -errno;
+        fprintf( stderr, "### unable to open \'%s\' (%d: %s)\n", path, errno, strerror(errno) );
+        if ( fd >= 0 ) close( fd );
+        return result;
+    }
+    if ( st.st_size == 0 )
+    {
+        close( fd );
+        return 0;
+    }
+
+    const char * data = mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    close( fd );
+    if ( data == MAP_FAILED )
+    {
+        result = -errno;
+        fprintf( stderr, "### unable to map \'%s\' (%d: %s)\n", path, errno, strerror(errno) );
+        return result;
+    }
+    madvise( (void *)data, st.st_size, MADV_SEQUENTIAL );
+
+    const char * end = data + st.st_size;
+    for ( const char * p = data; p < end && result == 0; )
+    {
+        const char * eol = memchr( p, '\n', end - p );
+        if ( eol == NULL )
+        {
+            eol = end;
+        }
+        const char * tab = memchr( p, '\t', eol - p );
+        size_t       length = ( tab != NULL ? tab : eol ) - p;
+
+        /* a stream URL always has a scheme, which rules out comments and the header */
+        const char * scheme = memchr( p, ':', length );
+        if ( length > 0 && *p != '#' && scheme != NULL && scheme + 2 < p + length && scheme[1] == '/' )
+        {
+            uint16_t latency = tab != NULL ? parseLatency( tab + 1, eol ) : kProbeFailed;
+
+            if ( 2 * (probes->count + 1) > probes->mask && ! growSlots( probes ) )
+            {
+                result = -ENOMEM;
+                fprintf( stderr, "### out of memory loading \'%s\'\n", path );
+                break;
+            }
+
+            tFingerprint key  = urlKey( p, length );
+            tProbeSlot * slot = findSlot( probes->slot, probes->mask, key );
+            if ( slot->url == 0 )
+            {
+                probes->count++;
+            }
+            else if ( slot->latency == kProbeFailed )
+            {
+                probes->failed--;
+            }
+            slot->url     = key;
+            slot->latency = latency;
+            probes->failed += ( latency == kProbeFailed );
+        }
+        p = eol + 1;
+    }
+
+    munmap( (void *)data, st.st_size );
+
+    return result;
+}
+
+/**
+ * @brief how long the stream took to start when it was probed. Safe to call from several threads.
+ * @param probes
+ * @param url
+ * @param length
+ * @param counts    the calling thread's own
+ * @return the latency in milliseconds, kProbeUnknown if it wasn't probed, or kProbeFailed
+ */
+uint16_t probesLatency( const tProbes * probes, const char * url, size_t length, tProbeCounts * counts )
+{
+    counts->lookups++;
+    if ( probes->slot == NULL )
+    {
+        return kProbeUnknown;
+    }
+
+    const tProbeSlot * slot = findSlot( probes->slot, probes->mask, urlKey( url, length ) );
+    if ( slot->url == 0 )
+    {
+        return kProbeUnknown;
+    }
+    counts->matched++;
+    return slot->latency;
+}
+
+/**
+ * @brief add a thread's counts to the totals, once it's done looking streams up
+ * @param probes
+ * @param counts
+ */
+void probesAddCounts( tProbes * probes, const tProbeCounts * counts )
+{
+    atomic_fetch_add_explicit( &probes->lookups, counts->lookups, memory_order_relaxed );
+    atomic_fetch_add_explicit( &probes->matched, counts->matched, memory_order_relaxed );
+}
+
+/**
+ * @brief
+ * @param output
+ * @param probes
+ */
+void probesReport( FILE * output, tProbes * probes )
+{
+    fprintf( output, "probes: %zu results loaded (%zu failed), %lu of %lu streams were probed\n",
+             probes->count, probes->failed,
+             atomic_load( &probes->matched ), atomic_load( &probes->lookups ) );
+}
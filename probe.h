@@ -0,0 +1,43 @@
+//
+// Created by paul on 10/19/26.
+//
+
+#ifndef MUNGEM3U_PROBE_H
+#define MUNGEM3U_PROBE_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * The results of probing the streams: how long each stream URL took to
+ * start. Probe files are tab-separated: the stream URL, then the startup
+ * latency in milliseconds. A latency that's empty, '-' or not a number
+ * means the probe failed. Any further columns (such as the bitrate) are
+ * ignored, as are blank lines, lines starting with '#', and a header row.
+ * The results are indexed by the fingerprint of the URL, so the URLs
+ * themselves aren't kept. If a URL appears more than once, the last row wins.
+ */
+
+#define kProbeMaxLatency    0xFFFD  /* longer latencies are counted as this */
+#define kProbeUnknown       0xFFFE  /* the URL wasn't probed */
+#define kProbeFailed        0xFFFF  /* the URL was probed, but didn't start */
+
+typedef struct sProbes tProbes;
+
+/* kept by each thread that looks streams up, and added to the totals when it's done */
+typedef struct {
+    unsigned long   lookups;
+    unsigned long   matched;
+} tProbeCounts;
+
+tProbes * probesNew( void );
+void probesFree( tProbes * probes );
+
+int probesLoad( tProbes * probes, const char * path );
+uint16_t probesLatency( const tProbes * probes, const char * url, size_t length, tProbeCounts * counts );
+void probesAddCounts( tProbes * probes, const tProbeCounts * counts );
+
+void probesReport( FILE * output, tProbes * probes );
+
+#endif //MUNGEM3U_PROBE_H
@@ -0,0 +1,299 @@
+//
+// Created by paul on 10/19/26.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <strings.h>
+
+#include "query.h"
+
+typedef enum {
+    kTokenEnd,
+    kTokenOpen,
+    kTokenClose,
+    kTokenAnd,
+    kTokenOr,
+    kTokenNot,
+    kTokenTerm,
+    kTokenError
+} tTokenType;
+
+typedef struct {
+    const char *     query;
+    const char *     p;
+
+    tTokenType       type;          /* the current token */
+    const char *     key;
+    size_t           keyLength;
+    const char *     value;
+    size_t           valueLength;
+
+    const tBitmap *  universe;
+    tQueryTerm       term;
+    void *           udata;
+    bool             failed;
+} tQueryParser;
+
+/* a bitmap that may belong to the caller rather than the query */
+typedef struct {
+    const tBitmap *  bitmap;
+    bool             owned;
+} tOperand;
+
+static inline bool isSpaceChar( char c )
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static inline bool isWordChar( char c )
+{
+    return c != '\0' && ! isSpaceChar( c ) && c != '(' && c != ')' && c != '&' && c != '|' && c != '"';
+}
+
+static void fail( tQueryParser * parser, const char * message )
+{
+    if ( ! parser->failed )
+    {
+        fprintf( stderr, "### query \'%s\': %s at offset %ld\n", parser->query, message, (long)(parser->p - parser->query) );
+        parser->failed = true;
+    }
+}
+
+/* a word, or a quoted string */
+static const char * scanWord( tQueryParser * parser, const char ** start, size_t * length )
+{
+    const char * p = parser->p;
+
+    if ( *p == '"' )
+    {
+        const char * close = strchr( p + 1, '"' );
+        if ( close == NULL )
+        {
+            return NULL;
+        }
+        *start  = p + 1;
+        *length = close - (p + 1);
+        return close + 1;
+    }
+    *start = p;
+    while ( isWordChar( *p ) && *p != ':' )
+    {
+        ++p;
+    }
+    *length = p - *start;
+    return p;
+}
+
+static void nextToken( tQueryParser * parser )
+{
+    while ( isSpaceChar( *parser->p ) )
+    {
+        ++parser->p;
+    }
+
+    switch ( *parser->p )
+    {
+    case '\0': parser->type = kTokenEnd;               return;
+    case '(':  parser->type = kTokenOpen;  parser->p++; return;
+    case ')':  parser->type = kTokenClose; parser->p++; return;
+    case '&':  parser->type = kTokenAnd;   parser->p++; return;
+    case '|':  parser->type = kTokenOr;    parser->p++; return;
+    case '!':
+    case '-':  parser->type = kTokenNot;   parser->p++; return;
+    default:   break;
+    }
+
+    const char * end = scanWord( parser, &parser->key, &parser->keyLength );
+    if ( end == NULL || parser->keyLength == 0 )
+    {
+        parser->type = kTokenError;
+        return;
+    }
+    parser->p = end;
+
+    parser->value       = NULL;
+    parser->valueLength = 0;
+    if ( *parser->p == ':' )
+    {
+        parser->p++;
+        end = scanWord( parser, &parser->value, &parser->valueLength );
+        if ( end == NULL )
+        {
+            parser->type = kTokenError;
+            return;
+        }
+        parser->p    = end;
+        parser->type = kTokenTerm;
+        return;
+    }
+
+    /* the operators can be spelled out, too */
+    if ( parser->keyLength == 3 && strncasecmp( parser->key, "and", 3 ) == 0 )
+    {
+        parser->type = kTokenAnd;
+    }
+    else if ( parser->keyLength == 2 && strncasecmp( parser->key, "or", 2 ) == 0 )
+    {
+        parser->type = kTokenOr;
+    }
+    else if ( parser->keyLength == 3 && strncasecmp( parser->key, "not", 3 ) == 0 )
+    {
+        parser->type = kTokenNot;
+    }
+    else
+    {
+        parser->type = kTokenTerm;
+    }
+}
+
+static void release( tOperand * operand )
+{
+    if ( operand->owned )
+    {
+        bitmapFree( (tBitmap *)operand->bitmap );
+    }
+    operand->bitmap = NULL;
+    operand->owned  = false;
+}
+
+typedef tBitmap * (*tCombine)( const tBitmap * left, const tBitmap * right );
+
+/* replace left with 'left op right', releasing both */
+static void apply( tQueryParser * parser, tOperand * left, tOperand * right, tCombine combine )
+{
+    tBitmap * result = NULL;
+
+    if ( left->bitmap != NULL && right->bitmap != NULL )
+    {
+        result = combine( left->bitmap, right->bitmap );
+        if ( result == NULL )
+        {
+            fail( parser, "out of memory" );
+        }
+    }
+    release( left );
+    release( right );
+    left->bitmap = result;
+    left->owned  = ( result != NULL );
+}
+
+static tOperand parseOr( tQueryParser * parser );
+
+static tOperand parseNot( tQueryParser * parser )
+{
+    tOperand result = { NULL, false };
+
+    switch ( parser->type )
+    {
+    case kTokenNot:
+        {
+            nextToken( parser );
+            tOperand operand  = parseNot( parser );
+            tOperand universe = { parser->universe, false };
+            apply( parser, &universe, &operand, bitmapAndNot );
+            return universe;
+        }
+
+    case kTokenOpen:
+        nextToken( parser );
+        result = parseOr( parser );
+        if ( parser->type != kTokenClose )
+        {
+            fail( parser, "expected a ')'" );
+            release( &result );
+            return result;
+        }
+        nextToken( parser );
+        return result;
+
+    case kTokenTerm:
+        result.bitmap = parser->term( parser->key, parser->keyLength,
+                                      parser->value, parser->valueLength, parser->udata );
+        if ( result.bitmap == NULL )
+        {
+            fail( parser, "unknown term" );
+        }
+        nextToken( parser );
+        return result;
+
+    default:
+        fail( parser, "expected a term" );
+        return result;
+    }
+}
+
+static tOperand parseAnd( tQueryParser * parser )
+{
+    tOperand left = parseNot( parser );
+
+    for (;;)
+    {
+        if ( parser->type == kTokenAnd )
+        {
+            nextToken( parser );
+        }
+        else if ( parser->type != kTokenTerm && parser->type != kTokenNot && parser->type != kTokenOpen )
+        {
+            return left;
+        }
+        /* terms side by side are and-ed */
+        tOperand right = parseNot( parser );
+        apply( parser, &left, &right, bitmapAnd );
+    }
+}
+
+static tOperand parseOr( tQueryParser * parser )
+{
+    tOperand left = parseAnd( parser );
+
+    while ( parser->type == kTokenOr )
+    {
+        nextToken( parser );
+        tOperand right = parseAnd( parser );
+        apply( parser, &left, &right, bitmapOr );
+    }
+    return left;
+}
+
+/**
+ * @brief
+ * @param query
+ * @param universe  every value, for 'not'
+ * @param term      resolves each term of the query to a bitmap
+ * @param udata
+ * @return a new bitmap of the values that satisfy the query, or NULL if the query isn't valid
+ */
+tBitmap * queryEvaluate( const char * query, const tBitmap * universe, tQueryTerm term, void * udata )
+{
+    tQueryParser parser;
+
+    memset( &parser, 0, sizeof( parser ) );
+    parser.query    = query;
+    parser.p        = query;
+    parser.universe = universe;
+    parser.term     = term;
+    parser.udata    = udata;
+
+    nextToken( &parser );
+    tOperand result = parseOr( &parser );
+    if ( parser.type != kTokenEnd )
+    {
+        fail( &parser, parser.type == kTokenError ? "invalid term" : "unexpected input" );
+    }
+    if ( parser.failed )
+    {
+        release( &result );
+        return NULL;
+    }
+    if ( ! result.owned )
+    {
+        /* a single term: hand back a copy, so the caller always owns the result */
+        tBitmap * empty = bitmapNew();
+        tBitmap * copy  = empty != NULL ? bitmapOr( result.bitmap, empty ) : NULL;
+        bitmapFree( empty );
+        return copy;
+    }
+    return (tBitmap *)result.bitmap;
+}
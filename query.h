@@ -0,0 +1,26 @@
+//
+// Created by paul on 10/19/26.
+//
+
+#ifndef MUNGEM3U_QUERY_H
+#define MUNGEM3U_QUERY_H
+
+#include <stddef.h>
+
+#include "bitmap.h"
+
+/*
+ * Boolean queries over bitmaps. A query is made of 'key:value' terms (or just
+ * 'key'), combined with 'and' (or '&', or nothing at all), 'or' (or '|'),
+ * 'not' (or '!' or '-') and parentheses. Values containing spaces can be
+ * quoted. 'not' binds tightest, then 'and', then 'or'. The caller resolves
+ * each term to a bitmap, and 'not' is relative to the universe bitmap.
+ */
+
+/* return the bitmap for a term (the query doesn't take ownership of it), or NULL if it isn't valid */
+typedef const tBitmap * (*tQueryTerm)( const char * key, size_t keyLength,
+                                       const char * value, size_t valueLength, void * udata );
+
+tBitmap * queryEvaluate( const char * query, const tBitmap * universe, tQueryTerm term, void * udata );
+
+#endif //MUNGEM3U_QUERY_H
@@ -0,0 +1,368 @@
+//
+// Created by paul on 10/19/26.
+//
+#include <stdlib.h>
+#include <stdint.h>
+#include <sched.h>
+
+#include "queue.h"
+
+static size_t roundUpPow2( size_t n )
+{
+    size_t result = 2;
+    while ( result < n )
+    {
+        result <<= 1;
+    }
+    return result;
+}
+
+static inline void sampleOccupancy( tQueueCounts * counts, size_t occupancy )
+{
+    counts->samples++;
+    counts->occupancy += occupancy;
+    if ( occupancy > counts->peak )
+    {
+        counts->peak = occupancy;
+    }
+}
+
+static void addCounts( tQueueStats * stats, const tQueueCounts * counts )
+{
+    atomic_fetch_add_explicit( &stats->samples,    counts->samples,    memory_order_relaxed );
+    atomic_fetch_add_explicit( &stats->occupancy,  counts->occupancy,  memory_order_relaxed );
+    atomic_fetch_add_explicit( &stats->pushStalls, counts->pushStalls, memory_order_relaxed );
+    atomic_fetch_add_explicit( &stats->popStalls,  counts->popStalls,  memory_order_relaxed );
+
+    unsigned long peak = atomic_load_explicit( &stats->peak, memory_order_relaxed );
+    while ( counts->peak > peak
+            && ! atomic_compare_exchange_weak_explicit( &stats->peak, &peak, counts->peak,
+                                                        memory_order_relaxed, memory_order_relaxed ) )
+    { /* retry - peak was refreshed by the failed exchange */ }
+}
+
+static void reportStats( FILE * output, const char * name, tQueueStats * stats, size_t capacity )
+{
+    unsigned long samples = atomic_load( &stats->samples );
+    double mean = 0.0;
+
+    if ( samples != 0 )
+    {
+        mean = (double)atomic_load( &stats->occupancy ) / (double)samples;
+    }
+    fprintf( output, "%-22s capacity %6zu, mean occupancy %8.1f (%5.1f%%), peak %6lu, "
+                     "producer stalls %8lu, consumer stalls %8lu\n",
+             name, capacity, mean, 100.0 * mean / (double)capacity,
+             atomic_load( &stats->peak ),
+             atomic_load( &stats->pushStalls ),
+             atomic_load( &stats->popStalls ) );
+}
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/**
+ * @brief
+ * @param capacity  rounded up to a power of two
+ * @return
+ */
+tQueue * queueNew( size_t capacity )
+{
+    tQueue * queue = calloc( 1, sizeof( tQueue ) );
+
+    if ( queue != NULL )
+    {
+        capacity    = roundUpPow2( capacity );
+        queue->mask = capacity - 1;
+        queue->cell = calloc( capacity, sizeof( tQueueCell ) );
+        if ( queue->cell == NULL )
+        {
+            free( queue );
+            return NULL;
+        }
+        for ( size_t i = 0; i < capacity; ++i )
+        {
+            atomic_init( &queue->cell[ i ].sequence, i );
+        }
+        atomic_init( &queue->head, 0 );
+        atomic_init( &queue->tail, 0 );
+    }
+    return queue;
+}
+
+/**
+ * @brief
+ * @param queue
+ */
+void queueFree( tQueue * queue )
+{
+    if ( queue != NULL )
+    {
+        free( queue->cell );
+        free( queue );
+    }
+}
+
+/**
+ * @brief
+ * @param queue
+ * @param item
+ * @return false if the queue is full
+ */
+bool queueTryPush( tQueue * queue, void * item )
+{
+    size_t       pos = atomic_load_explicit( &queue->head, memory_order_relaxed );
+    tQueueCell * cell;
+
+    for (;;)
+    {
+        cell = &queue->cell[ pos & queue->mask ];
+        size_t   seq  = atomic_load_explicit( &cell->sequence, memory_order_acquire );
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+        if ( diff == 0 )
+        {
+            if ( atomic_compare_exchange_weak_explicit( &queue->head, &pos, pos + 1,
+                                                        memory_order_relaxed, memory_order_relaxed ) )
+            {
+                break;
+            }
+        }
+        else if ( diff < 0 )
+        {
+            return false;
+        }
+        else
+        {
+            pos = atomic_load_explicit( &queue->head, memory_order_relaxed );
+        }
+    }
+
+    cell->item = item;
+    atomic_store_explicit( &cell->sequence, pos + 1, memory_order_release );
+
+    return true;
+}
+
+/**
+ * @brief
+ * @param queue
+ * @param item
+ * @param counts    the calling thread's own
+ * @return false if the queue is empty
+ */
+bool queueTryPop( tQueue * queue, void ** item, tQueueCounts * counts )
+{
+    size_t       pos = atomic_load_explicit( &queue->tail, memory_order_relaxed );
+    tQueueCell * cell;
+
+    for (;;)
+    {
+        cell = &queue->cell[ pos & queue->mask ];
+        size_t   seq  = atomic_load_explicit( &cell->sequence, memory_order_acquire );
+        intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+
+        if ( diff == 0 )
+        {
+            if ( atomic_compare_exchange_weak_explicit( &queue->tail, &pos, pos + 1,
+                                                        memory_order_relaxed, memory_order_relaxed ) )
+            {
+                break;
+            }
+        }
+        else if ( diff < 0 )
+        {
+            return false;
+        }
+        else
+        {
+            pos = atomic_load_explicit( &queue->tail, memory_order_relaxed );
+        }
+    }
+
+    *item = cell->item;
+    atomic_store_explicit( &cell->sequence, pos + queue->mask + 1, memory_order_release );
+
+    /* sample how many items were queued when this one was taken */
+    size_t head = atomic_load_explicit( &queue->head, memory_order_relaxed );
+    sampleOccupancy( counts, head > pos ? head - pos : 0 );
+
+    return true;
+}
+
+/**
+ * @brief push, yielding the CPU until there's room
+ * @param queue
+ * @param item
+ * @param counts    the calling thread's own
+ */
+void queuePush( tQueue * queue, void * item, tQueueCounts * counts )
+{
+    if ( ! queueTryPush( queue, item ) )
+    {
+        counts->pushStalls++;
+        do {
+            sched_yield();
+        } while ( ! queueTryPush( queue, item ) );
+    }
+}
+
+/**
+ * @brief pop, yielding the CPU until there's something to pop
+ * @param queue
+ * @param counts    the calling thread's own
+ * @return
+ */
+void * queuePop( tQueue * queue, tQueueCounts * counts )
+{
+    void * item;
+
+    if ( ! queueTryPop( queue, &item, counts ) )
+    {
+        counts->popStalls++;
+        do {
+            sched_yield();
+        } while ( ! queueTryPop( queue, &item, counts ) );
+    }
+    return item;
+}
+
+size_t queueCapacity( tQueue * queue )
+{
+    return queue->mask + 1;
+}
+
+/**
+ * @brief add a thread's counts to the queue's totals, once it's done with the queue
+ * @param queue
+ * @param counts
+ */
+void queueAddCounts( tQueue * queue, const tQueueCounts * counts )
+{
+    addCounts( &queue->stats, counts );
+}
+
+void queueReport( FILE * output, const char * name, tQueue * queue )
+{
+    reportStats( output, name, &queue->stats, queueCapacity( queue ) );
+}
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/**
+ * @brief
+ * @param capacity  rounded up to a power of two
+ * @return
+ */
+tRing * ringNew( size_t capacity )
+{
+    tRing * ring = calloc( 1, sizeof( tRing ) );
+
+    if ( ring != NULL )
+    {
+        capacity   = roundUpPow2( capacity );
+        ring->mask = capacity - 1;
+        ring->item = calloc( capacity, sizeof( void * ) );
+        if ( ring->item == NULL )
+        {
+            free( ring );
+            return NULL;
+        }
+        atomic_init( &ring->head, 0 );
+        atomic_init( &ring->tail, 0 );
+    }
+    return ring;
+}
+
+void ringFree( tRing * ring )
+{
+    if ( ring != NULL )
+    {
+        free( ring->item );
+        free( ring );
+    }
+}
+
+/**
+ * @brief only ever called from the one producer thread
+ * @param ring
+ * @param item
+ * @return false if the ring is full
+ */
+bool ringTryPush( tRing * ring, void * item )
+{
+    size_t head = atomic_load_explicit( &ring->head, memory_order_relaxed );
+    size_t tail = atomic_load_explicit( &ring->tail, memory_order_acquire );
+
+    if ( head - tail > ring->mask )
+    {
+        return false;
+    }
+    ring->item[ head & ring->mask ] = item;
+    atomic_store_explicit( &ring->head, head + 1, memory_order_release );
+
+    return true;
+}
+
+/**
+ * @brief only ever called from the one consumer thread
+ * @param ring
+ * @param item
+ * @param counts    the consumer's own
+ * @return false if the ring is empty
+ */
+bool ringTryPop( tRing * ring, void ** item, tQueueCounts * counts )
+{
+    size_t tail = atomic_load_explicit( &ring->tail, memory_order_relaxed );
+    size_t head = atomic_load_explicit( &ring->head, memory_order_acquire );
+
+    if ( head == tail )
+    {
+        return false;
+    }
+    *item = ring->item[ tail & ring->mask ];
+    atomic_store_explicit( &ring->tail, tail + 1, memory_order_release );
+
+    sampleOccupancy( counts, head - tail );
+
+    return true;
+}
+
+void ringPush( tRing * ring, void * item, tQueueCounts * counts )
+{
+    if ( ! ringTryPush( ring, item ) )
+    {
+        counts->pushStalls++;
+        do {
+            sched_yield();
+        } while ( ! ringTryPush( ring, item ) );
+    }
+}
+
+void * ringPop( tRing * ring, tQueueCounts * counts )
+{
+    void * item;
+
+    if ( ! ringTryPop( ring, &item, counts ) )
+    {
+        counts->popStalls++;
+        do {
+            sched_yield();
+        } while ( ! ringTryPop( ring, &item, counts ) );
+    }
+    return item;
+}
+
+size_t ringCapacity( tRing * ring )
+{
+    return ring->mask + 1;
+}
+
+void ringAddCounts( tRing * ring, const tQueueCounts * counts )
+{
+    addCounts( &ring->stats, counts );
+}
+
+void ringReport( FILE * output, const char * name, tRing * ring )
+{
+    reportStats( output, name, &ring->stats, ringCapacity( ring ) );
+}
@@ -0,0 +1,83 @@
+//
+// Created by paul on 10/19/26.
+//
+
+#ifndef MUNGEM3U_QUEUE_H
+#define MUNGEM3U_QUEUE_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdatomic.h>
+
+/*
+ * Bounded, lock-free queues of pointers for passing work between pipeline stages.
+ *
+ * tQueue is multi-producer/multi-consumer (Dmitry Vyukov's bounded MPMC design),
+ * tRing is the cheaper single-producer/single-consumer case. Both spin (yielding
+ * the CPU) when full or empty, and keep occupancy statistics so the stage that
+ * is holding up the pipeline can be identified. Each thread counts into its own
+ * tQueueCounts, which are only added to the queue's totals when it's done, so
+ * pushing and popping doesn't contend on the statistics.
+ */
+
+/* kept by each thread that pushes or pops */
+typedef struct {
+    unsigned long samples;          /* number of occupancy samples taken */
+    unsigned long occupancy;        /* sum of the sampled occupancy */
+    unsigned long peak;
+    unsigned long pushStalls;       /* producer found the queue full */
+    unsigned long popStalls;        /* consumer found the queue empty */
+} tQueueCounts;
+
+/* the totals of every thread's counts, added as each one finishes */
+typedef struct {
+    atomic_ulong  samples;
+    atomic_ulong  occupancy;
+    atomic_ulong  peak;
+    atomic_ulong  pushStalls;
+    atomic_ulong  popStalls;
+} tQueueStats;
+
+typedef struct {
+    atomic_size_t sequence;
+    void *        item;
+} tQueueCell;
+
+typedef struct {
+    tQueueCell *  cell;
+    size_t        mask;
+    _Alignas(64) atomic_size_t head;    /* next slot to push into */
+    _Alignas(64) atomic_size_t tail;    /* next slot to pop from */
+    _Alignas(64) tQueueStats   stats;
+} tQueue;
+
+typedef struct {
+    void **       item;
+    size_t        mask;
+    _Alignas(64) atomic_size_t head;
+    _Alignas(64) atomic_size_t tail;
+    _Alignas(64) tQueueStats   stats;
+} tRing;
+
+tQueue * queueNew( size_t capacity );
+void queueFree( tQueue * queue );
+bool queueTryPush( tQueue * queue, void * item );
+bool queueTryPop( tQueue * queue, void ** item, tQueueCounts * counts );
+void queuePush( tQueue * queue, void * item, tQueueCounts * counts );
+void * queuePop( tQueue * queue, tQueueCounts * counts );
+size_t queueCapacity( tQueue * queue );
+void queueAddCounts( tQueue * queue, const tQueueCounts * counts );
+void queueReport( FILE * output, const char * name, tQueue * queue );
+
+tRing * ringNew( size_t capacity );
+void ringFree( tRing * ring );
+bool ringTryPush( tRing * ring, void * item );
+bool ringTryPop( tRing * ring, void ** item, tQueueCounts * counts );
+void ringPush( tRing * ring, void * item, tQueueCounts * counts );
+void * ringPop( tRing * ring, tQueueCounts * counts );
+size_t ringCapacity( tRing * ring );
+void ringAddCounts( tRing * ring, const tQueueCounts * counts );
+void ringReport( FILE * output, const char * name, tRing * ring );
+
+#endif //MUNGEM3U_QUEUE_H
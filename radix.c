@@ -0,0 +1,140 @@
+//
+// Created by paul on 10/19/26.
+//
+#include <stdlib.h>
+#include <string.h>
+
+#include "radix.h"
+
+/* buckets smaller than this are finished off with an insertion sort */
+#define kRadixCutoff    32
+
+typedef struct {
+    tSortKey *      scratch;
+    tSortTieBreak   tie;
+    void *          udata;
+} tRadixSort;
+
+static inline int compareKeys( tRadixSort * sort, const tSortKey * l, const tSortKey * r, size_t depth )
+{
+    int result = memcmp( l->key + depth, r->key + depth, kSortKeyBytes - depth );
+    if ( result == 0 && sort->tie != NULL )
+    {
+        result = sort->tie( l->index, r->index, sort->udata );
+    }
+    return result;
+}
+
+static void insertionSort( tRadixSort * sort, tSortKey * keys, size_t count, size_t depth )
+{
+    for ( size_t i = 1; i < count; ++i )
+    {
+        tSortKey key = keys[ i ];
+        size_t   j   = i;
+        while ( j > 0 && compareKeys( sort, &keys[ j - 1 ], &key, depth ) > 0 )
+        {
+            keys[ j ] = keys[ j - 1 ];
+            --j;
+        }
+        keys[ j ] = key;
+    }
+}
+
+/* used for long runs of keys that are identical, so only the tie-break can order them */
+static void mergeSort( tRadixSort * sort, tSortKey * keys, size_t count )
+{
+    if ( count <= kRadixCutoff )
+    {
+        insertionSort( sort, keys, count, kSortKeyBytes );
+        return;
+    }
+
+    size_t half = count / 2;
+    mergeSort( sort, keys, half );
+    mergeSort( sort, keys + half, count - half );
+
+    tSortKey * out = sort->scratch;
+    size_t     l = 0, r = half, o = 0;
+    while ( l < half && r < count )
+    {
+        out[ o++ ] = ( sort->tie( keys[ r ].index, keys[ l ].index, sort->udata ) < 0 ) ? keys[ r++ ] : keys[ l++ ];
+    }
+    while ( l < half )  { out[ o++ ] = keys[ l++ ]; }
+    while ( r < count ) { out[ o++ ] = keys[ r++ ]; }
+    memcpy( keys, out, count * sizeof( tSortKey ) );
+}
+
+static void msdSort( tRadixSort * sort, tSortKey * keys, size_t count, size_t depth )
+{
+    size_t bucket[ 256 ];
+    size_t start[ 257 ];
+
+    if ( count <= kRadixCutoff )
+    {
+        insertionSort( sort, keys, count, depth );
+        return;
+    }
+    if ( depth == kSortKeyBytes )
+    {
+        if ( sort->tie != NULL )
+        {
+            mergeSort( sort, keys, count );
+        }
+        return;
+    }
+
+    memset( bucket, 0, sizeof( bucket ) );
+    for ( size_t i = 0; i < count; ++i )
+    {
+        bucket[ keys[ i ].key[ depth ] ]++;
+    }
+
+    start[ 0 ] = 0;
+    for ( unsigned int b = 0; b < 256; ++b )
+    {
+        start[ b + 1 ] = start[ b ] + bucket[ b ];
+    }
+
+    /* scatter into the scratch buffer, then copy back */
+    memcpy( bucket, start, sizeof( bucket ) );
+    for ( size_t i = 0; i < count; ++i )
+    {
+        sort->scratch[ bucket[ keys[ i ].key[ depth ] ]++ ] = keys[ i ];
+    }
+    memcpy( keys, sort->scratch, count * sizeof( tSortKey ) );
+
+    for ( unsigned int b = 0; b < 256; ++b )
+    {
+        size_t n = start[ b + 1 ] - start[ b ];
+        if ( n > 1 )
+        {
+            msdSort( sort, keys + start[ b ], n, depth + 1 );
+        }
+    }
+}
+
+/**
+ * @brief sort the keys into ascending order
+ * @param keys
+ * @param count
+ * @param tie    orders items whose keys are identical. May be NULL.
+ * @param udata  passed to 'tie'
+ * @return false if out of memory
+ */
+bool radixSort( tSortKey * keys, size_t count, tSortTieBreak tie, void * udata )
+{
+    tRadixSort sort;
+
+    sort.tie     = tie;
+    sort.udata   = udata;
+    sort.scratch = malloc( count * sizeof( tSortKey ) + 1 );
+    if ( sort.scratch == NULL )
+    {
+        return false;
+    }
+
+    msdSort( &sort, keys, count, 0 );
+
+    free( sort.scratch );
+    return true;
+}
@@ -0,0 +1,31 @@
+//
+// Created by paul on 10/19/26.
+//
+
+#ifndef MUNGEM3U_RADIX_H
+#define MUNGEM3U_RADIX_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Most-significant-digit radix sort over short, fixed-length binary keys.
+ * Keys are compared as unsigned bytes, like memcmp(). Keys that are equal
+ * over their whole length are put in order by a caller-supplied comparison
+ * of the items they were made from, so a key only needs to be a prefix of
+ * the full ordering.
+ */
+
+#define kSortKeyBytes   16
+
+typedef struct {
+    uint8_t     key[ kSortKeyBytes ];
+    uint32_t    index;      /* of the item the key was made from */
+} tSortKey;
+
+typedef int (*tSortTieBreak)( uint32_t left, uint32_t right, void * udata );
+
+bool radixSort( tSortKey * keys, size_t count, tSortTieBreak tie, void * udata );
+
+#endif //MUNGEM3U_RADIX_H
@@ -0,0 +1,354 @@
+//
+// Created by paul on 10/19/26.
+//
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "shard.h"
+
+typedef struct {
+    pthread_mutex_t  lock;
+
+    char *           items;     /* in the order they were inserted */
+    uint64_t *       hashes;    /* of each item, so the table can grow without re-hashing */
+    size_t           count;
+    size_t           size;
+
+    uint32_t *       slot;      /* 1 + the item number, or 0 if empty */
+    size_t           mask;      /* slot count is always a power of two */
+} tShard;
+
+struct sShardIndex {
+    tShard *         shard;
+    unsigned int     count;     /* always a power of two */
+    size_t           elsize;
+    tShardCompare    compare;
+    tShardHash       hash;
+    tShardKey        key;
+};
+
+static inline uint64_t foldHash( uint64_t h )
+{
+    /* fold the high bits down, in case the hash is weak in the low bits */
+    return h ^ (h >> 32);
+}
+
+static inline tShard * shardFor( tShardIndex * index, uint64_t h )
+{
+    return &index->shard[ h & (index->count - 1) ];
+}
+
+static inline size_t slotFor( tShard * shard, uint64_t h )
+{
+    /* the low bits picked the shard, so use different ones here */
+    return (size_t)(h >> 16) & shard->mask;
+}
+
+static inline void * itemAt( tShardIndex * index, tShard * shard, size_t i )
+{
+    return shard->items + i * index->elsize;
+}
+
+/**
+ * @brief
+ * @param shards   rounded up to a power of two
+ * @param elsize   size of an item, as stored in the shards
+ * @param compare  defines the sort order, and equality
+ * @param hash     must return the same value for items that compare as equal
+ * @param key      makes the radix sort key for an item; must agree with 'compare'. May be NULL.
+ * @return
+ */
+tShardIndex * shardNew( unsigned int shards, size_t elsize, tShardCompare compare, tShardHash hash, tShardKey key )
+{
+    tShardIndex * index = calloc( 1, sizeof( tShardIndex ) );
+
+    if ( index != NULL )
+    {
+        unsigned int count = 1;
+        while ( count < shards )
+        {
+            count <<= 1;
+        }
+        index->count   = count;
+        index->elsize  = elsize;
+        index->compare = compare;
+        index->hash    = hash;
+        index->key     = key;
+        index->shard   = calloc( count, sizeof( tShard ) );
+        if ( index->shard == NULL )
+        {
+            free( index );
+            return NULL;
+        }
+        for ( unsigned int i = 0; i < count; ++i )
+        {
+            pthread_mutex_init( &index->shard[ i ].lock, NULL );
+        }
+    }
+    return index;
+}
+
+/**
+ * @brief
+ * @param index
+ */
+void shardFree( tShardIndex * index )
+{
+    if ( index != NULL )
+    {
+        for ( unsigned int i = 0; i < index->count; ++i )
+        {
+            free( index->shard[ i ].items );
+            free( index->shard[ i ].hashes );
+            free( index->shard[ i ].slot );
+            pthread_mutex_destroy( &index->shard[ i ].lock );
+        }
+        free( index->shard );
+        free( index );
+    }
+}
+
+static bool growItems( tShardIndex * index, tShard * shard )
+{
+    size_t size = shard->size ? shard->size * 2 : 64;
+
+    char * items = realloc( shard->items, size * index->elsize );
+    if ( items == NULL )
+    {
+        return false;
+    }
+    shard->items = items;
+
+    uint64_t * hashes = realloc( shard->hashes, size * sizeof( uint64_t ) );
+    if ( hashes == NULL )
+    {
+        return false;
+    }
+    shard->hashes = hashes;
+    shard->size   = size;
+
+    return true;
+}
+
+static bool growSlots( tShard * shard )
+{
+    size_t     mask = shard->mask ? shard->mask * 2 + 1 : 127;
+    uint32_t * slot = calloc( mask + 1, sizeof( uint32_t ) );
+
+    if ( slot == NULL )
+    {
+        return false;
+    }
+    free( shard->slot );
+    shard->slot = slot;
+    shard->mask = mask;
+
+    for ( size_t i = 0; i < shard->count; ++i )
+    {
+        size_t s = slotFor( shard, shard->hashes[ i ] );
+        while ( slot[ s ] != 0 )
+        {
+            s = (s + 1) & mask;
+        }
+        slot[ s ] = (uint32_t)(i + 1);
+    }
+    return true;
+}
+
+/* call with the shard locked */
+static void * findItem( tShardIndex * index, tShard * shard, const void * item, uint64_t h )
+{
+    if ( shard->slot == NULL )
+    {
+        return NULL;
+    }
+    for ( size_t s = slotFor( shard, h ); shard->slot[ s ] != 0; s = (s + 1) & shard->mask )
+    {
+        size_t i = shard->slot[ s ] - 1;
+        if ( shard->hashes[ i ] == h && index->compare( itemAt( index, shard, i ), item, NULL ) == 0 )
+        {
+            return itemAt( index, shard, i );
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief find the item matching 'item', inserting a copy of 'item' if there isn't one
+ *
+ * The shard's storage moves as it grows, so nothing points into it once the
+ * lock is released: 'item' is overwritten with a copy of the stored item
+ * instead, and any change to the stored item is made by 'merge', while the
+ * shard is still locked.
+ *
+ * @param index
+ * @param item      in: the item to find or insert. out: the stored item
+ * @param merge     called with the stored item, unless out of memory. May be NULL.
+ * @param udata     passed to 'merge'
+ * @param inserted  set to true if the item was added
+ * @return false if out of memory
+ */
+bool shardGetOrInsert( tShardIndex * index, void * item, tShardMerge merge, void * udata, bool * inserted )
+{
+    uint64_t h      = foldHash( index->hash( item ) );
+    tShard * shard  = shardFor( index, h );
+    void *   stored;
+
+    *inserted = false;
+
+    pthread_mutex_lock( &shard->lock );
+    stored = findItem( index, shard, item, h );
+    if ( stored == NULL
+      && ( shard->count < shard->size || growItems( index, shard ) )
+      /* keep the table no more than half full */
+      && ( 2 * (shard->count + 1) <= shard->mask || growSlots( shard ) ) )
+    {
+        size_t i = shard->count++;
+
+        stored = itemAt( index, shard, i );
+        memcpy( stored, item, index->elsize );
+        shard->hashes[ i ] = h;
+
+        size_t s = slotFor( shard, h );
+        while ( shard->slot[ s ] != 0 )
+        {
+            s = (s + 1) & shard->mask;
+        }
+        shard->slot[ s ] = (uint32_t)(i + 1);
+
+        *inserted = true;
+    }
+    if ( stored != NULL )
+    {
+        if ( merge != NULL )
+        {
+            merge( stored, item, *inserted, udata );
+        }
+        memcpy( item, stored, index->elsize );
+    }
+    pthread_mutex_unlock( &shard->lock );
+
+    return stored != NULL;
+}
+
+/**
+ * @brief
+ * @param index
+ * @param key
+ * @param found     set to a copy of the stored item
+ * @return false if there isn't one
+ */
+bool shardGet( tShardIndex * index, const void * key, void * found )
+{
+    uint64_t h     = foldHash( index->hash( key ) );
+    tShard * shard = shardFor( index, h );
+    void *   stored;
+
+    pthread_mutex_lock( &shard->lock );
+    stored = findItem( index, shard, key, h );
+    if ( stored != NULL )
+    {
+        memcpy( found, stored, index->elsize );
+    }
+    pthread_mutex_unlock( &shard->lock );
+
+    return stored != NULL;
+}
+
+/**
+ * @brief
+ * @param index
+ * @return the total number of items across all the shards
+ */
+size_t shardCount( tShardIndex * index )
+{
+    size_t result = 0;
+
+    for ( unsigned int i = 0; i < index->count; ++i )
+    {
+        pthread_mutex_lock( &index->shard[ i ].lock );
+        result += index->shard[ i ].count;
+        pthread_mutex_unlock( &index->shard[ i ].lock );
+    }
+    return result;
+}
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+typedef struct {
+    tShardIndex *  index;
+    const char *   items;
+} tTieBreak;
+
+static int tieBreak( uint32_t left, uint32_t right, void * udata )
+{
+    tTieBreak *   tie   = udata;
+    tShardIndex * index = tie->index;
+
+    return index->compare( tie->items + left * index->elsize, tie->items + right * index->elsize, NULL );
+}
+
+/**
+ * @brief visit every item in sorted order. The shards are gathered into one
+ * array, and sorted by radix key, then by the compare function.
+ * Must not be called while other threads are inserting.
+ * @param index
+ * @param iter   return false to stop early
+ * @param udata
+ * @return false if the iteration was stopped early, or there wasn't enough memory to sort
+ */
+bool shardAscend( tShardIndex * index, tShardIter iter, void * udata )
+{
+    bool       result = true;
+    size_t     count  = shardCount( index );
+    char *     items  = malloc( count * index->elsize + 1 );
+    tSortKey * keys   = malloc( count * sizeof( tSortKey ) + 1 );
+
+    if ( items == NULL || keys == NULL )
+    {
+        free( items );
+        free( keys );
+        return false;
+    }
+
+    size_t n = 0;
+    for ( unsigned int i = 0; i < index->count; ++i )
+    {
+        tShard * shard = &index->shard[ i ];
+
+        pthread_mutex_lock( &shard->lock );
+        memcpy( items + n * index->elsize, shard->items, shard->count * index->elsize );
+        n += shard->count;
+        pthread_mutex_unlock( &shard->lock );
+    }
+
+    for ( size_t i = 0; i < n; ++i )
+    {
+        if ( index->key != NULL )
+        {
+            index->key( items + i * index->elsize, keys[ i ].key );
+        }
+        else
+        {
+            memset( keys[ i ].key, 0, kSortKeyBytes );
+        }
+        keys[ i ].index = (uint32_t)i;
+    }
+
+    tTieBreak tie = { index, items };
+    if ( ! radixSort( keys, n, tieBreak, &tie ) )
+    {
+        result = false;
+    }
+
+    for ( size_t i = 0; i < n && result; ++i )
+    {
+        result = iter( items + keys[ i ].index * index->elsize, udata );
+    }
+
+    free( items );
+    free( keys );
+
+    return result;
+}
@@ -0,0 +1,42 @@
+//
+// Created by paul on 10/19/26.
+//
+
+#ifndef MUNGEM3U_SHARD_H
+#define MUNGEM3U_SHARD_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "radix.h"
+
+/*
+ * An index split into independently-locked shards, so that several threads
+ * can look up and insert items at once. Items are assigned to a shard by a
+ * hash of their key; each shard is a flat array of items in insertion order,
+ * with an open-addressing hash table over it, so an insert costs O(1).
+ * Sorted order is only needed once, at export, so it is recovered then by a
+ * radix sort over a fixed-length key prefix, with the compare function
+ * breaking ties.
+ */
+
+typedef int      (*tShardCompare)( const void * left, const void * right, void * udata );
+typedef uint64_t (*tShardHash)( const void * item );
+typedef bool     (*tShardIter)( const void * item, void * udata );
+typedef void     (*tShardKey)( const void * item, uint8_t key[ kSortKeyBytes ] );
+/* called with the shard locked, with the item as stored, whether it was just inserted or was already there */
+typedef void     (*tShardMerge)( void * stored, const void * item, bool inserted, void * udata );
+
+typedef struct sShardIndex tShardIndex;
+
+tShardIndex * shardNew( unsigned int shards, size_t elsize, tShardCompare compare, tShardHash hash, tShardKey key );
+void shardFree( tShardIndex * index );
+
+bool shardGetOrInsert( tShardIndex * index, void * item, tShardMerge merge, void * udata, bool * inserted );
+bool shardGet( tShardIndex * index, const void * key, void * found );
+size_t shardCount( tShardIndex * index );
+
+bool shardAscend( tShardIndex * index, tShardIter iter, void * udata );
+
+#endif //MUNGEM3U_SHARD_H
@@ -0,0 +1,420 @@
+//
+// Created by paul on 10/19/26.
+//
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "radix.h"
+#include "snapshot.h"
+
+#define kSnapshotMagic      "mungeSNP"
+#define kSnapshotVersion    1
+
+typedef struct {
+    char           magic[ 8 ];
+    uint32_t       version;
+    uint32_t       count;
+    uint64_t       order;       /* of the fingerprints, in the order they were written */
+} tSnapshotHeader;
+
+typedef struct {
+    tFingerprint   key;
+    uint64_t       attributes;  /* hash of the #EXTINF line */
+    uint64_t       stream;      /* hash of the stream URL */
+    uint32_t       nameOffset;
+    uint32_t       nameLength;
+} tSnapshotRecord;
+
+struct sSnapshot {
+    const char *            data;       /* the mapped file, or NULL */
+    size_t                  size;
+
+    /* either the mapped file's, or the ones added */
+    const tSnapshotRecord * view;
+    const char *            viewNames;
+    size_t                  count;
+    uint64_t                order;
+    bool                    sorted;
+
+    tSnapshotRecord *       record;
+    size_t                  capacity;
+    char *                  names;
+    size_t                  namesLength;
+    size_t                  namesCapacity;
+};
+
+/**
+ * @brief
+ * @return an empty snapshot
+ */
+tSnapshot * snapshotNew( void )
+{
+    tSnapshot * snapshot = calloc( 1, sizeof( tSnapshot ) );
+
+    if ( snapshot != NULL )
+    {
+        snapshot->sorted = true;
+    }
+    return snapshot;
+}
+
+/**
+ * @brief
+ * @param snapshot
+ */
+void snapshotFree( tSnapshot * snapshot )
+{
+    if ( snapshot != NULL )
+    {
+        if ( snapshot->data != NULL )
+        {
+            munmap( (void *)snapshot->data, snapshot->size );
+        }
+        free( snapshot->record );
+        free( snapshot->names );
+        free( snapshot );
+    }
+}
+
+static bool validSnapshot( const char * data, size_t size )
+{
+    const tSnapshotHeader * header = (const tSnapshotHeader *)data;
+
+    if ( size < sizeof( tSnapshotHeader )
+      || memcmp( header->magic, kSnapshotMagic, sizeof( header->magic ) ) != 0
+      || header->version != kSnapshotVersion
+      || (size - sizeof( tSnapshotHeader )) / sizeof( tSnapshotRecord ) < header->count )
+    {
+        return false;
+    }
+
+    const tSnapshotRecord * record = (const tSnapshotRecord *)(data + sizeof( tSnapshotHeader ));
+    size_t namesLength = size - sizeof( tSnapshotHeader ) - header->count * sizeof( tSnapshotRecord );
+
+    for ( uint32_t i = 0; i < header->count; ++i )
+    {
+        if ( record[ i ].nameOffset > namesLength || record[ i ].nameLength > namesLength - record[ i ].nameOffset
+          || ( i > 0 && record[ i ].key < record[ i - 1 ].key ) )
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief map a snapshot saved by an earlier run. A missing file is the same as an empty snapshot.
+ * @param snapshot  must be empty
+ * @param path
+ * @return 0, or a negative errno
+ */
+int snapshotLoad( tSnapshot * snapshot, const char * path )
+{
+    int         result = 0;
+    struct stat st;
+
+    int fd = open( path, O_RDONLY );
+    if ( fd < 0 && errno == ENOENT )
+    {
+        /* the first run */
+        return 0;
+    }
+    if ( fd < 0 || fstat( fd, &st ) != 0 )
+    {
+        result = -errno;
+        fprintf( stderr, "### unable to open \'%s\' (%d: %s)\n", path, errno, strerror(errno) );
+        if ( fd >= 0 ) close( fd );
+        return result;
+    }
+    if ( st.st_size == 0 )
+    {
+        close( fd );
+        return 0;
+    }
+
+    const char * data = mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    close( fd );
+    if ( data == MAP_FAILED )
+    {
+        result = -errno;
+        fprintf( stderr, "### unable to map \'%s\' (%d: %s)\n", path, errno, strerror(errno) );
+        return result;
+    }
+    if ( ! validSnapshot( data, st.st_size ) )
+    {
+        /* treat it as a first run, and it'll be replaced */
+        fprintf( stderr, "### ignoring \'%s\': not a snapshot\n", path );
+        munmap( (void *)data, st.st_size );
+        return 0;
+    }
+
+    const tSnapshotHeader * header = (const tSnapshotHeader *)data;
+
+    snapshot->data      = data;
+    snapshot->size      = st.st_size;
+    snapshot->view      = (const tSnapshotRecord *)(data + sizeof( tSnapshotHeader ));
+    snapshot->viewNames = (const char *)(snapshot->view + header->count);
+    snapshot->count     = header->count;
+    snapshot->order     = header->order;
+    snapshot->sorted    = true;
+
+    return 0;
+}
+
+/**
+ * @brief record a channel that was written
+ * @param snapshot
+ * @param key           the channel's fingerprint
+ * @param attributes    hash of its #EXTINF line
+ * @param stream        hash of its stream URL
+ * @param name          for reporting changes
+ * @param nameLength
+ * @return false if out of memory
+ */
+bool snapshotAdd( tSnapshot * snapshot, tFingerprint key, uint64_t attributes, uint64_t stream,
+                  const char * name, size_t nameLength )
+{
+    if ( snapshot->count == snapshot->capacity )
+    {
+        size_t capacity = snapshot->capacity > 0 ? snapshot->capacity * 2 : 1024;
+        tSnapshotRecord * record = realloc( snapshot->record, capacity * sizeof( tSnapshotRecord ) );
+        if ( record == NULL )
+        {
+            return false;
+        }
+        snapshot->record   = record;
+        snapshot->capacity = capacity;
+    }
+    if ( snapshot->namesLength + nameLength > snapshot->namesCapacity )
+    {
+        size_t capacity = snapshot->namesCapacity > 0 ? snapshot->namesCapacity * 2 : 16384;
+        while ( capacity < snapshot->namesLength + nameLength )
+        {
+            capacity *= 2;
+        }
+        char * names = realloc( snapshot->names, capacity );
+        if ( names == NULL )
+        {
+            return false;
+        }
+        snapshot->names         = names;
+        snapshot->namesCapacity = capacity;
+    }
+
+    tSnapshotRecord * record = &snapshot->record[ snapshot->count++ ];
+    record->key        = key;
+    record->attributes = attributes;
+    record->stream     = stream;
+    record->nameOffset = (uint32_t)snapshot->namesLength;
+    record->nameLength = (uint32_t)nameLength;
+    memcpy( snapshot->names + snapshot->namesLength, name, nameLength );
+    snapshot->namesLength += nameLength;
+
+    snapshot->order     = fingerprint( &key, sizeof( key ), snapshot->order );
+    snapshot->view      = snapshot->record;
+    snapshot->viewNames = snapshot->names;
+    snapshot->sorted    = false;
+
+    return true;
+}
+
+/**
+ * @brief
+ * @param snapshot
+ * @return the number of channels in the snapshot
+ */
+size_t snapshotCount( const tSnapshot * snapshot )
+{
+    return snapshot->count;
+}
+
+/* put the records added in fingerprint order, keeping the order they were added when they're the same */
+static bool sortSnapshot( tSnapshot * snapshot )
+{
+    if ( snapshot->sorted )
+    {
+        return true;
+    }
+
+    tSortKey *        keys   = malloc( snapshot->count * sizeof( tSortKey ) + 1 );
+    tSnapshotRecord * sorted = malloc( snapshot->count * sizeof( tSnapshotRecord ) + 1 );
+
+    if ( keys == NULL || sorted == NULL )
+    {
+        free( keys );
+        free( sorted );
+        return false;
+    }
+
+    for ( size_t i = 0; i < snapshot->count; ++i )
+    {
+        tFingerprint key = snapshot->record[ i ].key;
+
+        memset( keys[ i ].key, 0, kSortKeyBytes );
+        for ( int b = 0; b < 8; ++b )
+        {
+            keys[ i ].key[ b ] = (uint8_t)(key >> (56 - 8 * b));
+        }
+        keys[ i ].index = (uint32_t)i;
+    }
+
+    bool result = radixSort( keys, snapshot->count, NULL, NULL );
+    if ( result )
+    {
+        for ( size_t i = 0; i < snapshot->count; ++i )
+        {
+            sorted[ i ] = snapshot->record[ keys[ i ].index ];
+        }
+        free( snapshot->record );
+        snapshot->record   = sorted;
+        snapshot->capacity = snapshot->count;
+        snapshot->view     = sorted;
+        snapshot->sorted   = true;
+    }
+    else
+    {
+        free( sorted );
+    }
+    free( keys );
+
+    return result;
+}
+
+/**
+ * @brief save the channels added, replacing the file only once it's been written in full
+ * @param snapshot
+ * @param path
+ * @return 0, or a negative errno
+ */
+int snapshotSave( tSnapshot * snapshot, const char * path )
+{
+    int result = 0;
+
+    if ( ! sortSnapshot( snapshot ) )
+    {
+        return -ENOMEM;
+    }
+
+    size_t length    = strlen( path );
+    char * temporary = malloc( length + sizeof( ".new" ) );
+    if ( temporary == NULL )
+    {
+        return -ENOMEM;
+    }
+    memcpy( temporary, path, length );
+    memcpy( temporary + length, ".new", sizeof( ".new" ) );
+
+    tSnapshotHeader header;
+    memset( &header, 0, sizeof( header ) );
+    memcpy( header.magic, kSnapshotMagic, sizeof( header.magic ) );
+    header.version = kSnapshotVersion;
+    header.count   = (uint32_t)snapshot->count;
+    header.order   = snapshot->order;
+
+    FILE * file = fopen( temporary, "w" );
+    if ( file == NULL )
+    {
+        result = -errno;
+        fprintf( stderr, "### unable to open \'%s\' (%d: %s)\n", temporary, errno, strerror(errno) );
+        free( temporary );
+        return result;
+    }
+    fwrite( &header, sizeof( header ), 1, file );
+    fwrite( snapshot->view, sizeof( tSnapshotRecord ), snapshot->count, file );
+    fwrite( snapshot->viewNames, 1, snapshot->namesLength, file );
+
+    if ( ferror( file ) | fclose( file ) )
+    {
+        result = -errno;
+        fprintf( stderr, "### unable to write \'%s\' (%d: %s)\n", temporary, errno, strerror(errno) );
+        unlink( temporary );
+    }
+    else if ( rename( temporary, path ) != 0 )
+    {
+        result = -errno;
+        fprintf( stderr, "### unable to replace \'%s\' (%d: %s)\n", path, errno, strerror(errno) );
+        unlink( temporary );
+    }
+    free( temporary );
+
+    return result;
+}
+
+static void report( tSnapshotIter iter, tSnapshotChange change,
+                    const tSnapshot * snapshot, const tSnapshotRecord * record, void * udata )
+{
+    if ( iter != NULL )
+    {
+        iter( change, snapshot->viewNames + record->nameOffset, record->nameLength, udata );
+    }
+}
+
+/**
+ * @brief match the channels of two snapshots by fingerprint
+ * @param previous  from an earlier run
+ * @param current   the channels just written
+ * @param delta     set to the number of each kind of change
+ * @param iter      called for each channel that was added, removed or changed. May be NULL.
+ * @param udata
+ * @return false if out of memory
+ */
+bool snapshotCompare( const tSnapshot * previous, tSnapshot * current, tSnapshotDelta * delta,
+                      tSnapshotIter iter, void * udata )
+{
+    memset( delta, 0, sizeof( tSnapshotDelta ) );
+    if ( ! previous->sorted || ! sortSnapshot( current ) )
+    {
+        return false;
+    }
+
+    const tSnapshotRecord * before = previous->view;
+    const tSnapshotRecord * after  = current->view;
+    size_t b = 0;
+    size_t a = 0;
+
+    while ( b < previous->count || a < current->count )
+    {
+        if ( a == current->count || ( b < previous->count && before[ b ].key < after[ a ].key ) )
+        {
+            delta->removed++;
+            report( iter, kSnapshotRemoved, previous, &before[ b++ ], udata );
+        }
+        else if ( b == previous->count || after[ a ].key < before[ b ].key )
+        {
+            delta->added++;
+            report( iter, kSnapshotAdded, current, &after[ a++ ], udata );
+        }
+        else
+        {
+            if ( before[ b ].attributes != after[ a ].attributes )
+            {
+                delta->changed++;
+                report( iter, kSnapshotChanged, current, &after[ a ], udata );
+            }
+            else if ( before[ b ].stream != after[ a ].stream )
+            {
+                delta->streams++;
+                report( iter, kSnapshotStream, current, &after[ a ], udata );
+            }
+            else
+            {
+                delta->unchanged++;
+            }
+            ++a;
+            ++b;
+        }
+    }
+    delta->reordered = ( delta->added == 0 && delta->removed == 0 && previous->order != current->order );
+
+    return true;
+}
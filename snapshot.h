@@ -0,0 +1,57 @@
+//
+// Created by paul on 10/19/26.
+//
+
+#ifndef MUNGEM3U_SNAPSHOT_H
+#define MUNGEM3U_SNAPSHOT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "fingerprint.h"
+
+/*
+ * A record of the channels written by a run, so the next run can tell what
+ * changed. Each channel is kept as its fingerprint, a hash of its #EXTINF
+ * line, a hash of its stream URL and its name. The file is the records
+ * sorted by fingerprint followed by the names, and is mapped rather than
+ * read. It's in the machine's byte order: it's a cache, not an interchange
+ * format.
+ */
+
+typedef struct sSnapshot tSnapshot;
+
+typedef enum {
+    kSnapshotAdded,
+    kSnapshotRemoved,
+    kSnapshotChanged,       /* the #EXTINF line changed, and maybe the stream too */
+    kSnapshotStream         /* only the stream changed */
+} tSnapshotChange;
+
+typedef struct {
+    size_t         added;
+    size_t         removed;
+    size_t         changed;
+    size_t         streams;
+    size_t         unchanged;
+    bool           reordered;   /* the same channels, but written in a different order */
+} tSnapshotDelta;
+
+typedef void (*tSnapshotIter)( tSnapshotChange change, const char * name, size_t nameLength, void * udata );
+
+tSnapshot * snapshotNew( void );
+void snapshotFree( tSnapshot * snapshot );
+
+int snapshotLoad( tSnapshot * snapshot, const char * path );
+int snapshotSave( tSnapshot * snapshot, const char * path );
+
+bool snapshotAdd( tSnapshot * snapshot, tFingerprint key, uint64_t attributes, uint64_t stream,
+                  const char * name, size_t nameLength );
+size_t snapshotCount( const tSnapshot * snapshot );
+
+bool snapshotCompare( const tSnapshot * previous, tSnapshot * current, tSnapshotDelta * delta,
+                      tSnapshotIter iter, void * udata );
+
+#endif //MUNGEM3U_SNAPSHOT_H
@@ -0,0 +1,307 @@
+//
+// Created by paul on 10/19/26.
+//
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+
+#include "split.h"
+
+#define kSplitMaxLabel  64
+
+typedef struct {
+    FILE *         file;
+    char *         label;       /* as used in the file name */
+    unsigned int   count;       /* channels written to the current file */
+    unsigned int   total;       /* channels written to all the files for the slot */
+    unsigned int   part;        /* number of files opened for the slot */
+} tSplitSlot;
+
+struct sSplit {
+    char *         prefix;
+    char *         extension;
+    unsigned int   cap;         /* most channels in a file, or 0 for no limit */
+
+    tSplitSlot *   slot;
+    unsigned int   slotCount;
+
+    int            error;       /* the first one, as a negative errno */
+};
+
+static char * copyString( const char * s )
+{
+    size_t length = strlen( s );
+    char * copy   = malloc( length + 1 );
+
+    if ( copy != NULL )
+    {
+        memcpy( copy, s, length + 1 );
+    }
+    return copy;
+}
+
+/**
+ * @brief
+ * @param prefix     prepended to every file name, may include a directory
+ * @param extension  without the leading '.'
+ * @param cap        the most channels to write to one file, or 0 for no limit
+ * @return
+ */
+tSplit * splitNew( const char * prefix, const char * extension, unsigned int cap )
+{
+    tSplit * split = calloc( 1, sizeof( tSplit ) );
+
+    if ( split != NULL )
+    {
+        split->prefix    = copyString( prefix );
+        split->extension = copyString( extension );
+        split->cap       = cap;
+        if ( split->prefix == NULL || split->extension == NULL )
+        {
+            splitFree( split );
+            return NULL;
+        }
+    }
+    return split;
+}
+
+static int closeSlot( tSplit * split, tSplitSlot * slot )
+{
+    int result = 0;
+
+    if ( slot->file != NULL )
+    {
+        if ( fclose( slot->file ) != 0 )
+        {
+            result = -errno;
+            fprintf( stderr, "### unable to write \'%s%s\' (%d: %s)\n",
+                     split->prefix, slot->label, errno, strerror(errno) );
+        }
+        slot->file = NULL;
+    }
+    return result;
+}
+
+/**
+ * @brief close all the files
+ * @param split
+ * @return 0, or the first error (as a negative errno) hit while writing any of them
+ */
+int splitFree( tSplit * split )
+{
+    int result = 0;
+
+    if ( split != NULL )
+    {
+        result = split->error;
+        for ( unsigned int i = 0; i < split->slotCount; ++i )
+        {
+            int r = closeSlot( split, &split->slot[ i ] );
+            if ( result == 0 )
+            {
+                result = r;
+            }
+            free( split->slot[ i ].label );
+        }
+        free( split->slot );
+        free( split->prefix );
+        free( split->extension );
+        free( split );
+    }
+    return result;
+}
+
+/* keep letters, digits, '-', '+' and '.', and turn any run of anything else into one '_' */
+static char * safeLabel( const char * label )
+{
+    char   buffer[ kSplitMaxLabel ];
+    size_t length = 0;
+
+    for ( const char * p = label != NULL ? label : ""; *p != '\0' && length < sizeof( buffer ) - 1; ++p )
+    {
+        char c = *p;
+        if ( ( c >= 'a' && c <= 'z' ) || ( c >= 'A' && c <= 'Z' ) || ( c >= '0' && c <= '9' )
+          || c == '-' || c == '+' || ( c == '.' && length > 0 ) )
+        {
+            buffer[ length++ ] = c;
+        }
+        else if ( length > 0 && buffer[ length - 1 ] != '_' )
+        {
+            buffer[ length++ ] = '_';
+        }
+    }
+    while ( length > 0 && buffer[ length - 1 ] == '_' )
+    {
+        --length;
+    }
+    if ( length == 0 )
+    {
+        memcpy( buffer, "unknown", 7 );
+        length = 7;
+    }
+    buffer[ length ] = '\0';
+
+    return copyString( buffer );
+}
+
+static bool labelInUse( const tSplit * split, const char * label )
+{
+    for ( unsigned int i = 0; i < split->slotCount; ++i )
+    {
+        if ( split->slot[ i ].label != NULL && strcmp( split->slot[ i ].label, label ) == 0 )
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* the label for a new slot, made different from the other slots' labels if need be */
+static char * uniqueLabel( const tSplit * split, unsigned int slot, const char * label )
+{
+    char * safe = safeLabel( label );
+
+    if ( safe == NULL || ! labelInUse( split, safe ) )
+    {
+        return safe;
+    }
+
+    size_t length = strlen( safe ) + 32;
+    char * unique = malloc( length );
+    if ( unique != NULL )
+    {
+        snprintf( unique, length, "%s_%u", safe, slot );
+        for ( unsigned int n = 2; labelInUse( split, unique ); ++n )
+        {
+            snprintf( unique, length, "%s_%u_%u", safe, slot, n );
+        }
+    }
+    free( safe );
+
+    return unique;
+}
+
+static FILE * openPart( tSplit * split, tSplitSlot * slot )
+{
+    size_t length = strlen( split->prefix ) + strlen( slot->label ) + strlen( split->extension ) + 16;
+    char * path   = malloc( length );
+
+    if ( path == NULL )
+    {
+        split->error = -ENOMEM;
+        return NULL;
+    }
+
+    slot->part++;
+    if ( slot->part == 1 )
+    {
+        snprintf( path, length, "%s%s.%s", split->prefix, slot->label, split->extension );
+    }
+    else
+    {
+        snprintf( path, length, "%s%s-%u.%s", split->prefix, slot->label, slot->part, split->extension );
+    }
+
+    slot->file  = fopen( path, "w" );
+    slot->count = 0;
+    if ( slot->file == NULL )
+    {
+        if ( split->error == 0 )
+        {
+            split->error = -errno;
+            fprintf( stderr, "### unable to open \'%s\' (%d: %s)\n", path, errno, strerror(errno) );
+        }
+    }
+    else
+    {
+        fprintf( slot->file, "#EXTM3U\n" );
+    }
+    free( path );
+
+    return slot->file;
+}
+
+/**
+ * @brief get the file to write the next channel in the slot to, opening it if need be
+ * @param split
+ * @param slot   chosen by the caller, and expected to be small - e.g. an enum
+ * @param label  names the slot's files. Only used the first time the slot is seen
+ * @return NULL if the file couldn't be opened
+ */
+FILE * splitOutput( tSplit * split, unsigned int slot, const char * label )
+{
+    if ( slot >= split->slotCount )
+    {
+        unsigned int count = slot + 1;
+        tSplitSlot * s     = realloc( split->slot, count * sizeof( tSplitSlot ) );
+        if ( s == NULL )
+        {
+            split->error = -ENOMEM;
+            return NULL;
+        }
+        memset( &s[ split->slotCount ], 0, (count - split->slotCount) * sizeof( tSplitSlot ) );
+        split->slot      = s;
+        split->slotCount = count;
+    }
+
+    tSplitSlot * s = &split->slot[ slot ];
+
+    if ( s->label == NULL )
+    {
+        s->label = uniqueLabel( split, slot, label );
+        if ( s->label == NULL )
+        {
+            split->error = -ENOMEM;
+            return NULL;
+        }
+    }
+
+    if ( s->file != NULL && split->cap > 0 && s->count >= split->cap )
+    {
+        int r = closeSlot( split, s );
+        if ( split->error == 0 )
+        {
+            split->error = r;
+        }
+    }
+    if ( s->file == NULL && ( s->part == 0 || ( split->cap > 0 && s->count >= split->cap ) ) )
+    {
+        openPart( split, s );
+    }
+    if ( s->file != NULL )
+    {
+        s->count++;
+        s->total++;
+    }
+    return s->file;
+}
+
+/**
+ * @brief
+ * @param output
+ * @param split
+ */
+void splitReport( FILE * output, tSplit * split )
+{
+    unsigned int files = 0;
+    unsigned int slots = 0;
+
+    for ( unsigned int i = 0; i < split->slotCount; ++i )
+    {
+        const tSplitSlot * s = &split->slot[ i ];
+        if ( s->part > 0 )
+        {
+            slots++;
+            files += s->part;
+            fprintf( output, "split: %-32s %6u channels in %u file%s\n",
+                     s->label, s->total, s->part, s->part == 1 ? "" : "s" );
+        }
+    }
+    fprintf( output, "split: %u outputs written to %u files", slots, files );
+    if ( split->cap > 0 )
+    {
+        fprintf( output, ", at most %u channels each", split->cap );
+    }
+    fprintf( output, "\n" );
+}
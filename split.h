@@ -0,0 +1,31 @@
+//
+// Created by paul on 10/19/26.
+//
+
+#ifndef MUNGEM3U_SPLIT_H
+#define MUNGEM3U_SPLIT_H
+
+#include <stdio.h>
+
+/*
+ * Splits the output across several M3U files at once. Each channel is
+ * assigned a slot by the caller (a country, a genre...) and the slot's
+ * file is opened the first time it's used, so a single pass over the
+ * channels writes every file. Files are named '<prefix><label>.<extension>',
+ * with the label reduced to characters that are safe in a file name. If that
+ * leaves two slots with the same label, the later one has '_<slot>' added, so
+ * they never write to the same file. If a
+ * file reaches the channel cap, it's closed and the slot continues in
+ * '<prefix><label>-2.<extension>', and so on.
+ */
+
+typedef struct sSplit tSplit;
+
+tSplit * splitNew( const char * prefix, const char * extension, unsigned int cap );
+int splitFree( tSplit * split );
+
+FILE * splitOutput( tSplit * split, unsigned int slot, const char * label );
+
+void splitReport( FILE * output, tSplit * split );
+
+#endif //MUNGEM3U_SPLIT_H
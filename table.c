@@ -0,0 +1,180 @@
+//
+// Created by paul on 10/19/26.
+//
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "table.h"
+
+struct sTable {
+    size_t          elsize;
+    atomic_uint     count;
+    _Atomic(char *) chunk[ kTableMaxChunks ];
+
+    /* released records, reused before any more are appended */
+    pthread_mutex_t lock;
+    atomic_uint     releasedCount;  /* so appends needn't lock when there are none */
+    uint32_t *      released;
+    uint32_t        releasedCapacity;
+};
+
+/**
+ * @brief
+ * @param elsize
+ * @return
+ */
+tTable * tableNew( size_t elsize )
+{
+    tTable * table = calloc( 1, sizeof( tTable ) );
+
+    if ( table != NULL )
+    {
+        table->elsize = elsize;
+        atomic_init( &table->count, 0 );
+        atomic_init( &table->releasedCount, 0 );
+        pthread_mutex_init( &table->lock, NULL );
+        /* reserve index zero */
+        if ( tableAppend( table ) != 0 )
+        {
+            tableFree( table );
+            return NULL;
+        }
+    }
+    return table;
+}
+
+/**
+ * @brief
+ * @param table
+ */
+void tableFree( tTable * table )
+{
+    if ( table != NULL )
+    {
+        for ( unsigned int i = 0; i < kTableMaxChunks; ++i )
+        {
+            free( atomic_load( &table->chunk[ i ] ) );
+        }
+        free( table->released );
+        pthread_mutex_destroy( &table->lock );
+        free( table );
+    }
+}
+
+/**
+ * @brief reserve a record, reusing a released one if there is one. Safe to call from several threads at once.
+ * @param table
+ * @return the index of the new, zeroed, record - or kTableError if out of memory
+ */
+uint32_t tableAppend( tTable * table )
+{
+    uint32_t index = 0;
+
+    if ( atomic_load_explicit( &table->releasedCount, memory_order_relaxed ) > 0 )
+    {
+        pthread_mutex_lock( &table->lock );
+        uint32_t count = atomic_load_explicit( &table->releasedCount, memory_order_relaxed );
+        if ( count > 0 )
+        {
+            index = table->released[ count - 1 ];
+            atomic_store_explicit( &table->releasedCount, count - 1, memory_order_relaxed );
+        }
+        pthread_mutex_unlock( &table->lock );
+        if ( index != 0 )
+        {
+            return index;
+        }
+    }
+
+    index = atomic_fetch_add( &table->count, 1 );
+    unsigned int c = index >> kTableChunkBits;
+
+    if ( c >= kTableMaxChunks )
+    {
+        return kTableError;
+    }
+
+    if ( atomic_load_explicit( &table->chunk[ c ], memory_order_acquire ) == NULL )
+    {
+        char * chunk = calloc( kTableChunkSize, table->elsize );
+        char * expected = NULL;
+
+        if ( chunk == NULL )
+        {
+            return kTableError;
+        }
+        /* another thread may have beaten us to it */
+        if ( ! atomic_compare_exchange_strong( &table->chunk[ c ], &expected, chunk ) )
+        {
+            free( chunk );
+        }
+    }
+    return index;
+}
+
+/**
+ * @brief zero a record that's no longer needed, and keep it for the next append to reuse.
+ *        Safe to call from several threads at once.
+ * @param table
+ * @param index     of a record that nothing refers to any more
+ */
+void tableRelease( tTable * table, uint32_t index )
+{
+    if ( index == 0 || index == kTableError )
+    {
+        return;
+    }
+    memset( tableGet( table, index, table->elsize ), 0, table->elsize );
+
+    pthread_mutex_lock( &table->lock );
+    uint32_t count = atomic_load_explicit( &table->releasedCount, memory_order_relaxed );
+    if ( count == table->releasedCapacity )
+    {
+        uint32_t   capacity = count > 0 ? count * 2 : 1024;
+        uint32_t * released = realloc( table->released, capacity * sizeof( uint32_t ) );
+        if ( released != NULL )
+        {
+            table->released         = released;
+            table->releasedCapacity = capacity;
+        }
+    }
+    if ( count < table->releasedCapacity )
+    {
+        /* if there's no room to note it, it's just not reused */
+        table->released[ count ] = index;
+        atomic_store_explicit( &table->releasedCount, count + 1, memory_order_relaxed );
+    }
+    pthread_mutex_unlock( &table->lock );
+}
+
+/**
+ * @brief
+ * @param table
+ * @return the number of records, including the reserved one and any that were released
+ */
+uint32_t tableCount( tTable * table )
+{
+    return atomic_load( &table->count );
+}
+
+/**
+ * @brief
+ * @param table
+ * @return bytes allocated for records
+ */
+size_t tableMemory( tTable * table )
+{
+    size_t result = 0;
+    for ( unsigned int i = 0; i < kTableMaxChunks && atomic_load( &table->chunk[ i ] ) != NULL; ++i )
+    {
+        result += kTableChunkSize * table->elsize;
+    }
+    return result;
+}
+
+void * tableGetChunk( tTable * table, uint32_t index )
+{
+    return atomic_load_explicit( &table->chunk[ index >> kTableChunkBits ], memory_order_acquire );
+}
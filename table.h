@@ -0,0 +1,43 @@
+//
+// Created by paul on 10/19/26.
+//
+
+#ifndef MUNGEM3U_TABLE_H
+#define MUNGEM3U_TABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * A table of fixed-size records, addressed by a 32-bit index. Storage is
+ * allocated in chunks that never move, so records can be appended from
+ * several threads at once while others are being read. A record that's no
+ * longer needed can be released, and is then reused by a later append.
+ * Index zero is reserved, and always refers to an all-zero record.
+ */
+
+#define kTableError     UINT32_MAX  /* returned by tableAppend() if out of memory */
+
+typedef struct sTable tTable;
+
+tTable * tableNew( size_t elsize );
+void tableFree( tTable * table );
+
+uint32_t tableAppend( tTable * table );
+void tableRelease( tTable * table, uint32_t index );
+uint32_t tableCount( tTable * table );
+size_t tableMemory( tTable * table );
+
+void * tableGetChunk( tTable * table, uint32_t index );
+
+/* the chunk size is fixed, so this is just a shift and a mask */
+#define kTableChunkBits     12
+#define kTableChunkSize     (1u << kTableChunkBits)
+#define kTableMaxChunks     (1u << 16)
+
+static inline void * tableGet( tTable * table, uint32_t index, size_t elsize )
+{
+    return (char *)tableGetChunk( table, index ) + (index & (kTableChunkSize - 1)) * elsize;
+}
+
+#endif //MUNGEM3U_TABLE_H
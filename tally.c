@@ -0,0 +1,185 @@
+//
+// Created by paul on 10/19/26.
+//
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "fingerprint.h"
+#include "tally.h"
+
+/* examples are only there to be read, so long ones are cut short */
+#define kTallyMaxExample    256
+
+typedef struct {
+    char *          key;
+    char *          example;    /* may be NULL */
+    uint64_t        hash;
+    uint64_t        count;
+} tTallyEntry;
+
+struct sTally {
+    pthread_mutex_t lock;
+
+    tTallyEntry *   entry;      /* in the order they were first seen */
+    unsigned int    count;
+    unsigned int    limit;
+
+    uint32_t *      slot;       /* 1 + the entry number, or 0 if empty */
+    size_t          mask;
+
+    uint64_t        overflow;   /* occurrences of keys that didn't fit */
+};
+
+static char * copySpan( const char * s, size_t length )
+{
+    char * copy = malloc( length + 1 );
+
+    if ( copy != NULL )
+    {
+        memcpy( copy, s, length );
+        copy[ length ] = '\0';
+    }
+    return copy;
+}
+
+/**
+ * @brief
+ * @param limit     the most distinct keys to keep
+ * @return
+ */
+tTally * tallyNew( unsigned int limit )
+{
+    tTally * tally = calloc( 1, sizeof( tTally ) );
+
+    if ( tally != NULL )
+    {
+        size_t slots = 16;
+        while ( slots < 2 * (size_t)limit )
+        {
+            slots *= 2;
+        }
+        tally->limit = limit;
+        tally->mask  = slots - 1;
+        tally->entry = calloc( limit + 1, sizeof( tTallyEntry ) );
+        tally->slot  = calloc( slots, sizeof( uint32_t ) );
+        if ( tally->entry == NULL || tally->slot == NULL )
+        {
+            free( tally->entry );
+            free( tally->slot );
+            free( tally );
+            return NULL;
+        }
+        pthread_mutex_init( &tally->lock, NULL );
+    }
+    return tally;
+}
+
+/**
+ * @brief
+ * @param tally
+ */
+void tallyFree( tTally * tally )
+{
+    if ( tally != NULL )
+    {
+        for ( unsigned int i = 0; i < tally->count; ++i )
+        {
+            free( tally->entry[ i ].key );
+            free( tally->entry[ i ].example );
+        }
+        pthread_mutex_destroy( &tally->lock );
+        free( tally->entry );
+        free( tally->slot );
+        free( tally );
+    }
+}
+
+/**
+ * @brief count one occurrence of a key
+ * @param tally
+ * @param key
+ * @param keyLength
+ * @param example       kept if this is the first time the key has been seen. May be NULL.
+ * @param exampleLength
+ */
+void tallyAdd( tTally * tally, const char * key, size_t keyLength, const char * example, size_t exampleLength )
+{
+    uint64_t hash = fingerprint( key, keyLength, 0 );
+
+    pthread_mutex_lock( &tally->lock );
+
+    size_t s = hash & tally->mask;
+    while ( tally->slot[ s ] != 0 )
+    {
+        tTallyEntry * entry = &tally->entry[ tally->slot[ s ] - 1 ];
+        if ( entry->hash == hash && strncmp( entry->key, key, keyLength ) == 0 && entry->key[ keyLength ] == '\0' )
+        {
+            break;
+        }
+        s = (s + 1) & tally->mask;
+    }
+
+    if ( tally->slot[ s ] != 0 )
+    {
+        tally->entry[ tally->slot[ s ] - 1 ].count++;
+    }
+    else if ( tally->count == tally->limit )
+    {
+        tally->overflow++;
+    }
+    else
+    {
+        tTallyEntry * entry = &tally->entry[ tally->count ];
+
+        entry->key     = copySpan( key, keyLength );
+        entry->example = NULL;
+        if ( example != NULL )
+        {
+            entry->example = copySpan( example, exampleLength < kTallyMaxExample ? exampleLength : kTallyMaxExample );
+        }
+        entry->hash  = hash;
+        entry->count = 1;
+        if ( entry->key == NULL )
+        {
+            free( entry->example );
+            tally->overflow++;
+        }
+        else
+        {
+            tally->slot[ s ] = ++tally->count;
+        }
+    }
+
+    pthread_mutex_unlock( &tally->lock );
+}
+
+/**
+ * @brief visit each key, in the order they were first seen
+ * @param tally
+ * @param iter
+ * @param udata
+ */
+void tallyForEach( tTally * tally, tTallyIter iter, void * udata )
+{
+    pthread_mutex_lock( &tally->lock );
+    for ( unsigned int i = 0; i < tally->count; ++i )
+    {
+        const tTallyEntry * entry = &tally->entry[ i ];
+        if ( ! iter( entry->key, entry->count, entry->example, udata ) )
+        {
+            break;
+        }
+    }
+    pthread_mutex_unlock( &tally->lock );
+}
+
+/**
+ * @brief
+ * @param tally
+ * @return how many occurrences there were of keys that didn't fit in the table
+ */
+uint64_t tallyOverflow( tTally * tally )
+{
+    return tally->overflow;
+}
@@ -0,0 +1,33 @@
+//
+// Created by paul on 10/19/26.
+//
+
+#ifndef MUNGEM3U_TALLY_H
+#define MUNGEM3U_TALLY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Counts how often each distinct key turns up, keeping the first example
+ * seen of each, so a diagnostic can be reported once per key rather than
+ * once per occurrence. The number of distinct keys is bounded: once the
+ * table is full, occurrences of new keys are only counted in total. Safe to
+ * add to from several threads at once.
+ */
+
+typedef struct sTally tTally;
+
+/* return false to stop early */
+typedef bool (*tTallyIter)( const char * key, uint64_t count, const char * example, void * udata );
+
+tTally * tallyNew( unsigned int limit );
+void tallyFree( tTally * tally );
+
+void tallyAdd( tTally * tally, const char * key, size_t keyLength, const char * example, size_t exampleLength );
+
+void tallyForEach( tTally * tally, tTallyIter iter, void * udata );
+uint64_t tallyOverflow( tTally * tally );
+
+#endif //MUNGEM3U_TALLY_H
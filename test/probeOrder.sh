@@ -0,0 +1,52 @@
+#!/bin/sh
+#
+# Created by paul on 10/19/26.
+#
+# Check that a channel's streams are ordered by their probed startup latency:
+# the fastest stream that started is written, ahead of the one seen first, and
+# a stream whose probe failed is never preferred. The same for the pipeline.
+#
+# usage: probeOrder.sh <path to mungeM3U>
+
+mungeM3U="$1"
+work=$(mktemp -d) || exit 1
+trap 'rm -rf "$work"' EXIT
+
+cat > "$work/in.m3u" <<'EOF'
+#EXTM3U
+#EXTINF:-1 tvg-id="bbc.one.uk" tvg-name="UK: BBC One HD" group-title="UK| General",UK: BBC One HD
+http://a.example/1/slow.ts
+#EXTINF:-1 tvg-id="bbc.one.uk" tvg-name="UK: BBC One HD" group-title="UK| General",UK: BBC One HD
+http://b.example/1/fast.ts
+#EXTINF:-1 tvg-id="bbc.one.uk" tvg-name="UK: BBC One HD" group-title="UK| General",UK: BBC One HD
+http://c.example/1/failed.ts
+EOF
+
+printf 'url\tms\tkbps\n'                         >  "$work/probes.tsv"
+printf 'http://a.example/1/slow.ts\t2400\t5000\n' >> "$work/probes.tsv"
+printf 'http://b.example/1/fast.ts\t310.5\t4800\n' >> "$work/probes.tsv"
+printf 'http://c.example/1/failed.ts\t-\t0\n'     >> "$work/probes.tsv"
+
+# the stream written for the one channel in the output
+head_stream()
+{
+    "$mungeM3U" "$@" "$work/in.m3u" 2>/dev/null | grep -v '^#'
+}
+
+failed=0
+expect()
+{
+    if [ "$1" != "$2" ]; then
+        echo "### $3: expected '$2', got '$1'"
+        failed=1
+    fi
+}
+
+expect "$(head_stream)"                                 "http://a.example/1/slow.ts" "unprobed"
+expect "$(head_stream --probes "$work/probes.tsv")"     "http://b.example/1/fast.ts" "probed"
+expect "$(head_stream --probes "$work/probes.tsv" -j2)" "http://b.example/1/fast.ts" "probed, pipelined"
+
+printf 'http://b.example/1/fast.ts\t-\n' > "$work/failed.tsv"
+expect "$(head_stream --probes "$work/failed.tsv")"     "http://a.example/1/slow.ts" "fastest failed"
+
+exit $failed
@@ -0,0 +1,206 @@
+//
+// Created by paul on 10/19/26.
+//
+#include <stdlib.h>
+#include <string.h>
+
+#include "topk.h"
+
+typedef struct {
+    int64_t        score;
+    size_t         order;       /* when it was offered */
+    void *         item;
+} tTopKEntry;
+
+struct sTopK {
+    tTopKEntry *   heap;        /* heap[0] is the entry that goes first */
+    size_t         count;
+    size_t         k;
+    size_t         offered;
+    bool           visited;     /* heap[] is in offer order, and no longer a heap */
+};
+
+/* a goes before b: it has a lower score, or the same score but was offered later */
+static inline bool worse( const tTopKEntry * a, const tTopKEntry * b )
+{
+    return a->score < b->score || ( a->score == b->score && a->order > b->order );
+}
+
+static void siftUp( tTopKEntry * heap, size_t i )
+{
+    tTopKEntry entry = heap[ i ];
+
+    while ( i > 0 )
+    {
+        size_t parent = (i - 1) / 2;
+        if ( ! worse( &entry, &heap[ parent ] ) )
+        {
+            break;
+        }
+        heap[ i ] = heap[ parent ];
+        i = parent;
+    }
+    heap[ i ] = entry;
+}
+
+static void siftDown( tTopKEntry * heap, size_t count, size_t i )
+{
+    tTopKEntry entry = heap[ i ];
+
+    for (;;)
+    {
+        size_t child = 2 * i + 1;
+        if ( child >= count )
+        {
+            break;
+        }
+        if ( child + 1 < count && worse( &heap[ child + 1 ], &heap[ child ] ) )
+        {
+            child++;
+        }
+        if ( ! worse( &heap[ child ], &entry ) )
+        {
+            break;
+        }
+        heap[ i ] = heap[ child ];
+        i = child;
+    }
+    heap[ i ] = entry;
+}
+
+/**
+ * @brief
+ * @param k     how many items to keep
+ * @return
+ */
+tTopK * topkNew( size_t k )
+{
+    tTopK * topk = calloc( 1, sizeof( tTopK ) );
+
+    if ( topk != NULL )
+    {
+        topk->k    = k;
+        topk->heap = calloc( k > 0 ? k : 1, sizeof( tTopKEntry ) );
+        if ( topk->heap == NULL )
+        {
+            free( topk );
+            return NULL;
+        }
+    }
+    return topk;
+}
+
+/**
+ * @brief
+ * @param topk
+ */
+void topkFree( tTopK * topk )
+{
+    if ( topk != NULL )
+    {
+        free( topk->heap );
+        free( topk );
+    }
+}
+
+/**
+ * @brief
+ * @param topk
+ * @param score
+ * @param item
+ * @return true if the item is one of the top K offered so far
+ */
+bool topkOffer( tTopK * topk, int64_t score, void * item )
+{
+    tTopKEntry entry = { score, topk->offered++, item };
+
+    if ( topk->visited )
+    {
+        return false;
+    }
+
+    if ( topk->count < topk->k )
+    {
+        topk->heap[ topk->count ] = entry;
+        siftUp( topk->heap, topk->count++ );
+        return true;
+    }
+    if ( topk->count == 0 || ! worse( &topk->heap[ 0 ], &entry ) )
+    {
+        return false;
+    }
+    topk->heap[ 0 ] = entry;
+    siftDown( topk->heap, topk->count, 0 );
+    return true;
+}
+
+static int compareOrder( const void * left, const void * right )
+{
+    const tTopKEntry * l = left;
+    const tTopKEntry * r = right;
+
+    return ( l->order > r->order ) - ( l->order < r->order );
+}
+
+/**
+ * @brief visit the items kept, in the order they were offered. They can be visited
+ *        again, but once they have been, no more items can be offered.
+ * @param topk
+ * @param iter      return false to stop early
+ * @param udata
+ */
+void topkForEach( tTopK * topk, tTopKIter iter, void * udata )
+{
+    if ( ! topk->visited )
+    {
+        qsort( topk->heap, topk->count, sizeof( tTopKEntry ), compareOrder );
+        topk->visited = true;
+    }
+
+    for ( size_t i = 0; i < topk->count; ++i )
+    {
+        if ( ! iter( topk->heap[ i ].item, topk->heap[ i ].score, udata ) )
+        {
+            break;
+        }
+    }
+}
+
+/**
+ * @brief
+ * @param topk
+ * @return the number of items kept
+ */
+size_t topkCount( tTopK * topk )
+{
+    return topk->count;
+}
+
+/**
+ * @brief
+ * @param topk
+ * @return the number of items offered
+ */
+size_t topkOffered( tTopK * topk )
+{
+    return topk->offered;
+}
+
+/**
+ * @brief
+ * @param topk
+ * @return the lowest score kept, or 0 if nothing is
+ */
+int64_t topkThreshold( tTopK * topk )
+{
+    int64_t threshold = topk->count > 0 ? topk->heap[ 0 ].score : 0;
+
+    for ( size_t i = 1; topk->visited && i < topk->count; ++i )
+    {
+        if ( topk->heap[ i ].score < threshold )
+        {
+            threshold = topk->heap[ i ].score;
+        }
+    }
+    return threshold;
+}
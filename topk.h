@@ -0,0 +1,33 @@
+//
+// Created by paul on 10/19/26.
+//
+
+#ifndef MUNGEM3U_TOPK_H
+#define MUNGEM3U_TOPK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Keeps the K highest scoring items offered to it, in a bounded min-heap,
+ * so memory is O(K) however many items are offered. Ties go to the item
+ * offered first. Once all the items have been offered, the survivors can
+ * be visited in the order they were offered, as many times as need be.
+ */
+
+typedef struct sTopK tTopK;
+
+typedef bool (*tTopKIter)( void * item, int64_t score, void * udata );
+
+tTopK * topkNew( size_t k );
+void topkFree( tTopK * topk );
+
+bool topkOffer( tTopK * topk, int64_t score, void * item );
+void topkForEach( tTopK * topk, tTopKIter iter, void * udata );
+
+size_t topkCount( tTopK * topk );
+size_t topkOffered( tTopK * topk );
+int64_t topkThreshold( tTopK * topk );
+
+#endif //MUNGEM3U_TOPK_H
@@ -0,0 +1,483 @@
+//
+// Created by paul on 10/19/26.
+//
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "fingerprint.h"
+#include "url.h"
+
+/* host names are at most 253 characters, so anything longer isn't one */
+#define kHostMaxName    256
+/* host numbers are 16 bits, and 0 means 'no host' */
+#define kHostMaxCount   65535
+
+/* the hosts are allocated a block at a time */
+#define kHostBlockSize  256
+#define kHostBlocks     ( (kHostMaxCount + kHostBlockSize) / kHostBlockSize )
+
+/* a tHostStats that streams can be counted in from several threads at once */
+typedef struct {
+    atomic_ulong    streams;
+    atomic_ulong    channels;
+    atomic_ulong    vip;
+    atomic_ulong    tier[ kHostMaxTiers ];
+} tHostCounters;
+
+typedef struct {
+    char *          name;       /* in lower case */
+    uint64_t        hash;
+    tHostCounters   counters;
+} tHost;
+
+struct sHostTable {
+    pthread_mutex_t lock;       /* held while adding a host */
+
+    /* a block is never moved once it's allocated, so a host that's been
+     * added can be read and counted without taking the lock */
+    tHost *         block[ kHostBlocks ];   /* host 0 is kHostUnset */
+    atomic_uint     count;
+
+    uint32_t *      slot;       /* the host number, or 0 if empty */
+    size_t          mask;
+};
+
+static inline tHost * hostAt( tHostTable * table, unsigned int host )
+{
+    return &table->block[ host / kHostBlockSize ][ host % kHostBlockSize ];
+}
+
+static inline bool isSchemeChar( char c )
+{
+    return ( c >= 'a' && c <= 'z' ) || ( c >= 'A' && c <= 'Z' ) || ( c >= '0' && c <= '9' )
+        || c == '+' || c == '-' || c == '.';
+}
+
+/**
+ * @brief find the parts of a URL
+ * @param url
+ * @param length
+ * @param result    set to the spans of each part
+ * @return false if the URL doesn't have a host
+ */
+bool urlParse( const char * url, size_t length, tURL * result )
+{
+    size_t i = 0;
+
+    memset( result, 0, sizeof( tURL ) );
+
+    while ( i < length && isSchemeChar( url[ i ] ) )
+    {
+        ++i;
+    }
+    if ( i == 0 || i + 3 > length || memcmp( &url[ i ], "://", 3 ) != 0 )
+    {
+        /* no scheme, so no host either: all path */
+        i = 0;
+        while ( i < length && url[ i ] != '?' && url[ i ] != '#' )
+        {
+            ++i;
+        }
+        result->pathLength = (uint32_t)i;
+        return false;
+    }
+    result->schemeLength = (uint32_t)i;
+
+    /* the authority runs to the start of the path, query or fragment */
+    size_t authority = i + 3;
+    size_t end       = authority;
+    while ( end < length && url[ end ] != '/' && url[ end ] != '?' && url[ end ] != '#' )
+    {
+        ++end;
+    }
+
+    /* skip over any credentials */
+    size_t host = authority;
+    for ( size_t j = authority; j < end; ++j )
+    {
+        if ( url[ j ] == '@' )
+        {
+            host = j + 1;
+        }
+    }
+
+    size_t hostEnd = host;
+    if ( hostEnd < end && url[ hostEnd ] == '[' )
+    {
+        /* an IPv6 address, brackets and all */
+        while ( hostEnd < end && url[ hostEnd ] != ']' )
+        {
+            ++hostEnd;
+        }
+        if ( hostEnd < end )
+        {
+            ++hostEnd;
+        }
+    }
+    else
+    {
+        while ( hostEnd < end && url[ hostEnd ] != ':' )
+        {
+            ++hostEnd;
+        }
+    }
+    result->hostStart  = (uint32_t)host;
+    result->hostLength = (uint32_t)(hostEnd - host);
+
+    if ( hostEnd < end && url[ hostEnd ] == ':' )
+    {
+        uint32_t port = 0;
+        for ( size_t j = hostEnd + 1; j < end && url[ j ] >= '0' && url[ j ] <= '9' && port <= 65535; ++j )
+        {
+            port = port * 10 + (url[ j ] - '0');
+        }
+        result->port = port <= 65535 ? port : 0;
+    }
+
+    size_t path = end;
+    while ( end < length && url[ end ] != '?' && url[ end ] != '#' )
+    {
+        ++end;
+    }
+    result->pathStart  = (uint32_t)path;
+    result->pathLength = (uint32_t)(end - path);
+
+    return result->hostLength > 0;
+}
+
+/**
+ * @brief
+ * @return an empty table
+ */
+tHostTable * hostNew( void )
+{
+    tHostTable * table = calloc( 1, sizeof( tHostTable ) );
+
+    if ( table != NULL )
+    {
+        atomic_init( &table->count, 1 );    /* kHostUnset */
+        table->mask     = 127;
+        table->block[0] = calloc( kHostBlockSize, sizeof( tHost ) );
+        table->slot     = calloc( table->mask + 1, sizeof( uint32_t ) );
+        if ( table->block[0] == NULL || table->slot == NULL )
+        {
+            free( table->block[0] );
+            free( table->slot );
+            free( table );
+            return NULL;
+        }
+        pthread_mutex_init( &table->lock, NULL );
+    }
+    return table;
+}
+
+/**
+ * @brief
+ * @param table
+ */
+void hostFree( tHostTable * table )
+{
+    if ( table != NULL )
+    {
+        unsigned int count = atomic_load( &table->count );
+        for ( unsigned int i = 1; i < count; ++i )
+        {
+            free( hostAt( table, i )->name );
+        }
+        pthread_mutex_destroy( &table->lock );
+        for ( unsigned int b = 0; b < kHostBlocks; ++b )
+        {
+            free( table->block[ b ] );
+        }
+        free( table->slot );
+        free( table );
+    }
+}
+
+/* host names aren't case sensitive */
+static size_t lowerCase( const char * host, size_t length, char * buffer )
+{
+    for ( size_t i = 0; i < length; ++i )
+    {
+        char c = host[ i ];
+        buffer[ i ] = ( c >= 'A' && c <= 'Z' ) ? (char)(c - 'A' + 'a') : c;
+    }
+    buffer[ length ] = '\0';
+    return length;
+}
+
+static bool growSlots( tHostTable * table )
+{
+    size_t     mask = table->mask * 2 + 1;
+    uint32_t * slot = calloc( mask + 1, sizeof( uint32_t ) );
+
+    if ( slot == NULL )
+    {
+        return false;
+    }
+    for ( size_t i = 0; i <= table->mask; ++i )
+    {
+        if ( table->slot[ i ] != 0 )
+        {
+            size_t s = hostAt( table, table->slot[ i ] )->hash & mask;
+            while ( slot[ s ] != 0 )
+            {
+                s = (s + 1) & mask;
+            }
+            slot[ s ] = table->slot[ i ];
+        }
+    }
+    free( table->slot );
+    table->slot = slot;
+    table->mask = mask;
+
+    return true;
+}
+
+static uint32_t * findSlot( tHostTable * table, const char * name, size_t length, uint64_t hash )
+{
+    size_t s = hash & table->mask;
+
+    while ( table->slot[ s ] != 0 )
+    {
+        const tHost * host = hostAt( table, table->slot[ s ] );
+        if ( host->hash == hash && strncmp( host->name, name, length ) == 0 && host->name[ length ] == '\0' )
+        {
+            break;
+        }
+        s = (s + 1) & table->mask;
+    }
+    return &table->slot[ s ];
+}
+
+/* the name is in lower case */
+static tHostIndex internName( tHostTable * table, const char * name, size_t length, uint64_t hash )
+{
+    pthread_mutex_lock( &table->lock );
+
+    uint32_t *   slot  = findSlot( table, name, length, hash );
+    unsigned int count = atomic_load_explicit( &table->count, memory_order_relaxed );
+    if ( *slot == 0 && count < kHostMaxCount )
+    {
+        bool      room  = true;
+        tHost **  block = &table->block[ count / kHostBlockSize ];
+
+        if ( 2 * (count + 1) > table->mask )
+        {
+            room = growSlots( table );
+            slot = findSlot( table, name, length, hash );
+        }
+        if ( room && *block == NULL )
+        {
+            *block = calloc( kHostBlockSize, sizeof( tHost ) );
+            room   = ( *block != NULL );
+        }
+        char * copy = room ? malloc( length + 1 ) : NULL;
+        if ( copy != NULL )
+        {
+            memcpy( copy, name, length + 1 );
+
+            tHost * entry = hostAt( table, count );
+            entry->name = copy;
+            entry->hash = hash;
+            atomic_init( &entry->counters.streams, 0 );
+            atomic_init( &entry->counters.channels, 0 );
+            atomic_init( &entry->counters.vip, 0 );
+            for ( unsigned int t = 0; t < kHostMaxTiers; ++t )
+            {
+                atomic_init( &entry->counters.tier[ t ], 0 );
+            }
+            *slot = count;
+
+            /* published last, so a thread that sees the new count sees the host too */
+            atomic_store_explicit( &table->count, count + 1, memory_order_release );
+        }
+    }
+    tHostIndex result = (tHostIndex)*slot;
+
+    pthread_mutex_unlock( &table->lock );
+
+    return result;
+}
+
+/**
+ * @brief the number of a host, adding it to the table if it's new. Safe to call from several threads.
+ * @param table
+ * @param host
+ * @param length
+ * @return the host's number, or kHostUnset if it isn't valid or the table is full
+ */
+tHostIndex hostIntern( tHostTable * table, const char * host, size_t length )
+{
+    char name[ kHostMaxName ];
+
+    if ( length == 0 || length >= kHostMaxName )
+    {
+        return kHostUnset;
+    }
+    lowerCase( host, length, name );
+
+    return internName( table, name, length, fingerprint( name, length, 0 ) );
+}
+
+/**
+ * @brief as hostIntern, but looking in the calling thread's cache first, and
+ *        only locking the table for a host the thread hasn't seen lately
+ * @param table
+ * @param cache     the calling thread's own, zeroed before first use
+ * @param host
+ * @param length
+ * @return the host's number, or kHostUnset if it isn't valid or the table is full
+ */
+tHostIndex hostInternCached( tHostTable * table, tHostCache * cache, const char * host, size_t length )
+{
+    char name[ kHostMaxName ];
+
+    if ( length == 0 || length >= kHostMaxName )
+    {
+        return kHostUnset;
+    }
+    lowerCase( host, length, name );
+
+    uint64_t hash = fingerprint( name, length, 0 );
+    size_t   i    = hash & (kHostCacheSize - 1);
+
+    if ( cache->host[ i ] == kHostUnset || cache->hash[ i ] != hash )
+    {
+        cache->host[ i ] = internName( table, name, length, hash );
+        cache->hash[ i ] = hash;
+    }
+    return cache->host[ i ];
+}
+
+/**
+ * @brief
+ * @param table
+ * @param host
+ * @param length
+ * @return the host's number, or kHostUnset if it's not in the table
+ */
+tHostIndex hostFind( tHostTable * table, const char * host, size_t length )
+{
+    char name[ kHostMaxName ];
+
+    if ( length == 0 || length >= kHostMaxName )
+    {
+        return kHostUnset;
+    }
+    lowerCase( host, length, name );
+
+    pthread_mutex_lock( &table->lock );
+    tHostIndex result = (tHostIndex)*findSlot( table, name, length, fingerprint( name, length, 0 ) );
+    pthread_mutex_unlock( &table->lock );
+
+    return result;
+}
+
+/**
+ * @brief safe to call while other threads add hosts
+ * @param table
+ * @param host
+ * @return the host's name, in lower case, or NULL for kHostUnset
+ */
+const char * hostName( tHostTable * table, tHostIndex host )
+{
+    unsigned int count = atomic_load_explicit( &table->count, memory_order_acquire );
+
+    return ( host != kHostUnset && host < count ) ? hostAt( table, host )->name : NULL;
+}
+
+/**
+ * @brief
+ * @param table
+ * @return the number of hosts in the table
+ */
+unsigned int hostCount( tHostTable * table )
+{
+    return atomic_load_explicit( &table->count, memory_order_acquire ) - 1;
+}
+
+/**
+ * @brief count a stream served from the host. Safe to call from several threads,
+ *        and doesn't take the table's lock.
+ * @param table
+ * @param host
+ * @param newChannel    the channel doesn't have another stream from the same host
+ * @param vip
+ * @param tier          the stream's resolution
+ */
+void hostTally( tHostTable * table, tHostIndex host, bool newChannel, bool vip, unsigned int tier )
+{
+    if ( host == kHostUnset || host >= atomic_load_explicit( &table->count, memory_order_acquire ) )
+    {
+        return;
+    }
+
+    tHostCounters * counters = &hostAt( table, host )->counters;
+
+    atomic_fetch_add_explicit( &counters->streams, 1, memory_order_relaxed );
+    if ( newChannel )
+    {
+        atomic_fetch_add_explicit( &counters->channels, 1, memory_order_relaxed );
+    }
+    if ( vip )
+    {
+        atomic_fetch_add_explicit( &counters->vip, 1, memory_order_relaxed );
+    }
+    atomic_fetch_add_explicit( &counters->tier[ tier < kHostMaxTiers ? tier : kHostMaxTiers - 1 ], 1,
+                               memory_order_relaxed );
+}
+
+static void readCounters( const tHostCounters * counters, tHostStats * stats )
+{
+    stats->streams  = atomic_load_explicit( &counters->streams, memory_order_relaxed );
+    stats->channels = atomic_load_explicit( &counters->channels, memory_order_relaxed );
+    stats->vip      = atomic_load_explicit( &counters->vip, memory_order_relaxed );
+    for ( unsigned int t = 0; t < kHostMaxTiers; ++t )
+    {
+        stats->tier[ t ] = atomic_load_explicit( &counters->tier[ t ], memory_order_relaxed );
+    }
+}
+
+/**
+ * @brief
+ * @param table
+ * @param host
+ * @param stats     set to a copy of the host's counters
+ * @return false if there's no such host
+ */
+bool hostStats( tHostTable * table, tHostIndex host, tHostStats * stats )
+{
+    if ( host == kHostUnset || host >= atomic_load_explicit( &table->count, memory_order_acquire ) )
+    {
+        return false;
+    }
+    readCounters( &hostAt( table, host )->counters, stats );
+
+    return true;
+}
+
+/**
+ * @brief visit every host, in the order they were first seen. Hosts added meanwhile may be missed.
+ * @param table
+ * @param iter      return false to stop early
+ * @param udata
+ */
+void hostForEach( tHostTable * table, tHostIter iter, void * udata )
+{
+    unsigned int count = atomic_load_explicit( &table->count, memory_order_acquire );
+
+    for ( unsigned int i = 1; i < count; ++i )
+    {
+        const tHost * host = hostAt( table, i );
+        tHostStats    stats;
+
+        readCounters( &host->counters, &stats );
+        if ( ! iter( (tHostIndex)i, host->name, &stats, udata ) )
+        {
+            break;
+        }
+    }
+}
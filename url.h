@@ -0,0 +1,71 @@
+//
+// Created by paul on 10/19/26.
+//
+
+#ifndef MUNGEM3U_URL_H
+#define MUNGEM3U_URL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Stream URLs, parsed once into the spans of their parts, and the hosts
+ * they're served from. Each distinct host is interned into a small table
+ * and known by its number from then on, so comparing hosts is comparing
+ * integers. The table also keeps a few counters for each host, to show how
+ * the streams are spread across a provider's servers. Only adding a host
+ * locks the table: looking a host's name up and counting its streams don't.
+ */
+
+/* offsets into the URL. A part that isn't there has a length of zero */
+typedef struct {
+    uint32_t       schemeLength;    /* starts at 0 */
+    uint32_t       hostStart;
+    uint32_t       hostLength;      /* without any credentials or port */
+    uint32_t       port;            /* 0 if not given */
+    uint32_t       pathStart;
+    uint32_t       pathLength;      /* up to any '?' or '#' */
+} tURL;
+
+bool urlParse( const char * url, size_t length, tURL * result );
+
+#define kHostUnset      0
+#define kHostMaxTiers   8   /* resolutions counted separately; any higher are counted as the highest */
+
+typedef uint16_t tHostIndex;
+
+typedef struct {
+    uint64_t       streams;
+    uint64_t       channels;        /* with at least one stream from the host */
+    uint64_t       vip;
+    uint64_t       tier[ kHostMaxTiers ];
+} tHostStats;
+
+typedef struct sHostTable tHostTable;
+
+#define kHostCacheSize  64  /* power of two */
+
+/* the hosts one thread has interned recently. A provider only has a few, so
+ * most streams find theirs here, without locking the table */
+typedef struct {
+    uint64_t       hash[ kHostCacheSize ];
+    tHostIndex     host[ kHostCacheSize ];  /* kHostUnset if the entry is empty */
+} tHostCache;
+
+typedef bool (*tHostIter)( tHostIndex host, const char * name, const tHostStats * stats, void * udata );
+
+tHostTable * hostNew( void );
+void hostFree( tHostTable * table );
+
+tHostIndex hostIntern( tHostTable * table, const char * host, size_t length );
+tHostIndex hostInternCached( tHostTable * table, tHostCache * cache, const char * host, size_t length );
+tHostIndex hostFind( tHostTable * table, const char * host, size_t length );
+const char * hostName( tHostTable * table, tHostIndex host );
+unsigned int hostCount( tHostTable * table );
+
+void hostTally( tHostTable * table, tHostIndex host, bool newChannel, bool vip, unsigned int tier );
+bool hostStats( tHostTable * table, tHostIndex host, tHostStats * stats );
+void hostForEach( tHostTable * table, tHostIter iter, void * udata );
+
+#endif //MUNGEM3U_URL_H
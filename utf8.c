@@ -0,0 +1,428 @@
+//
+// Created by paul on 10/19/26.
+//
+#include <stdint.h>
+
+#include "utf8.h"
+
+/*
+ * Case mapping and diacritic stripping for the Latin-1 Supplement and
+ * Latin Extended-A blocks (U+00C0 to U+017F), which covers the western &
+ * central european languages that turn up in channel names.
+ */
+#define kLatinFirst     0x00C0
+#define kLatinLast      0x017F
+
+static const struct {
+    uint16_t  lower;
+    uint16_t  upper;
+    char      base;     /* unaccented lower-case ASCII equivalent, or 0 if there isn't one */
+} latinMap[ kLatinLast - kLatinFirst + 1 ] =
+{
+    /* U+00C0 */ { 0x00e0, 0x00c0, 'a' },
+    /* U+00C1 */ { 0x00e1, 0x00c1, 'a' },
+    /* U+00C2 */ { 0x00e2, 0x00c2, 'a' },
+    /* U+00C3 */ { 0x00e3, 0x00c3, 'a' },
+    /* U+00C4 */ { 0x00e4, 0x00c4, 'a' },
+    /* U+00C5 */ { 0x00e5, 0x00c5, 'a' },
+    /* U+00C6 */ { 0x00e6, 0x00c6, 0   },
+    /* U+00C7 */ { 0x00e7, 0x00c7, 'c' },
+    /* U+00C8 */ { 0x00e8, 0x00c8, 'e' },
+    /* U+00C9 */ { 0x00e9, 0x00c9, 'e' },
+    /* U+00CA */ { 0x00ea, 0x00ca, 'e' },
+    /* U+00CB */ { 0x00eb, 0x00cb, 'e' },
+    /* U+00CC */ { 0x00ec, 0x00cc, 'i' },
+    /* U+00CD */ { 0x00ed, 0x00cd, 'i' },
+    /* U+00CE */ { 0x00ee, 0x00ce, 'i' },
+    /* U+00CF */ { 0x00ef, 0x00cf, 'i' },
+    /* U+00D0 */ { 0x00f0, 0x00d0, 0   },
+    /* U+00D1 */ { 0x00f1, 0x00d1, 'n' },
+    /* U+00D2 */ { 0x00f2, 0x00d2, 'o' },
+    /* U+00D3 */ { 0x00f3, 0x00d3, 'o' },
+    /* U+00D4 */ { 0x00f4, 0x00d4, 'o' },
+    /* U+00D5 */ { 0x00f5, 0x00d5, 'o' },
+    /* U+00D6 */ { 0x00f6, 0x00d6, 'o' },
+    /* U+00D7 */ { 0x00d7, 0x00d7, 0   },
+    /* U+00D8 */ { 0x00f8, 0x00d8, 'o' },
+    /* U+00D9 */ { 0x00f9, 0x00d9, 'u' },
+    /* U+00DA */ { 0x00fa, 0x00da, 'u' },
+    /* U+00DB */ { 0x00fb, 0x00db, 'u' },
+    /* U+00DC */ { 0x00fc, 0x00dc, 'u' },
+    /* U+00DD */ { 0x00fd, 0x00dd, 'y' },
+    /* U+00DE */ { 0x00fe, 0x00de, 0   },
+    /* U+00DF */ { 0x00df, 0x00df, 0   },
+    /* U+00E0 */ { 0x00e0, 0x00c0, 'a' },
+    /* U+00E1 */ { 0x00e1, 0x00c1, 'a' },
+    /* U+00E2 */ { 0x00e2, 0x00c2, 'a' },
+    /* U+00E3 */ { 0x00e3, 0x00c3, 'a' },
+    /* U+00E4 */ { 0x00e4, 0x00c4, 'a' },
+    /* U+00E5 */ { 0x00e5, 0x00c5, 'a' },
+    /* U+00E6 */ { 0x00e6, 0x00c6, 0   },
+    /* U+00E7 */ { 0x00e7, 0x00c7, 'c' },
+    /* U+00E8 */ { 0x00e8, 0x00c8, 'e' },
+    /* U+00E9 */ { 0x00e9, 0x00c9, 'e' },
+    /* U+00EA */ { 0x00ea, 0x00ca, 'e' },
+    /* U+00EB */ { 0x00eb, 0x00cb, 'e' },
+    /* U+00EC */ { 0x00ec, 0x00cc, 'i' },
+    /* U+00ED */ { 0x00ed, 0x00cd, 'i' },
+    /* U+00EE */ { 0x00ee, 0x00ce, 'i' },
+    /* U+00EF */ { 0x00ef, 0x00cf, 'i' },
+    /* U+00F0 */ { 0x00f0, 0x00d0, 0   },
+    /* U+00F1 */ { 0x00f1, 0x00d1, 'n' },
+    /* U+00F2 */ { 0x00f2, 0x00d2, 'o' },
+    /* U+00F3 */ { 0x00f3, 0x00d3, 'o' },
+    /* U+00F4 */ { 0x00f4, 0x00d4, 'o' },
+    /* U+00F5 */ { 0x00f5, 0x00d5, 'o' },
+    /* U+00F6 */ { 0x00f6, 0x00d6, 'o' },
+    /* U+00F7 */ { 0x00f7, 0x00f7, 0   },
+    /* U+00F8 */ { 0x00f8, 0x00d8, 'o' },
+    /* U+00F9 */ { 0x00f9, 0x00d9, 'u' },
+    /* U+00FA */ { 0x00fa, 0x00da, 'u' },
+    /* U+00FB */ { 0x00fb, 0x00db, 'u' },
+    /* U+00FC */ { 0x00fc, 0x00dc, 'u' },
+    /* U+00FD */ { 0x00fd, 0x00dd, 'y' },
+    /* U+00FE */ { 0x00fe, 0x00de, 0   },
+    /* U+00FF */ { 0x00ff, 0x0178, 'y' },
+    /* U+0100 */ { 0x0101, 0x0100, 'a' },
+    /* U+0101 */ { 0x0101, 0x0100, 'a' },
+    /* U+0102 */ { 0x0103, 0x0102, 'a' },
+    /* U+0103 */ { 0x0103, 0x0102, 'a' },
+    /* U+0104 */ { 0x0105, 0x0104, 'a' },
+    /* U+0105 */ { 0x0105, 0x0104, 'a' },
+    /* U+0106 */ { 0x0107, 0x0106, 'c' },
+    /* U+0107 */ { 0x0107, 0x0106, 'c' },
+    /* U+0108 */ { 0x0109, 0x0108, 'c' },
+    /* U+0109 */ { 0x0109, 0x0108, 'c' },
+    /* U+010A */ { 0x010b, 0x010a, 'c' },
+    /* U+010B */ { 0x010b, 0x010a, 'c' },
+    /* U+010C */ { 0x010d, 0x010c, 'c' },
+    /* U+010D */ { 0x010d, 0x010c, 'c' },
+    /* U+010E */ { 0x010f, 0x010e, 'd' },
+    /* U+010F */ { 0x010f, 0x010e, 'd' },
+    /* U+0110 */ { 0x0111, 0x0110, 'd' },
+    /* U+0111 */ { 0x0111, 0x0110, 'd' },
+    /* U+0112 */ { 0x0113, 0x0112, 'e' },
+    /* U+0113 */ { 0x0113, 0x0112, 'e' },
+    /* U+0114 */ { 0x0115, 0x0114, 'e' },
+    /* U+0115 */ { 0x0115, 0x0114, 'e' },
+    /* U+0116 */ { 0x0117, 0x0116, 'e' },
+    /* U+0117 */ { 0x0117, 0x0116, 'e' },
+    /* U+0118 */ { 0x0119, 0x0118, 'e' },
+    /* U+0119 */ { 0x0119, 0x0118, 'e' },
+    /* U+011A */ { 0x011b, 0x011a, 'e' },
+    /* U+011B */ { 0x011b, 0x011a, 'e' },
+    /* U+011C */ { 0x011d, 0x011c, 'g' },
+    /* U+011D */ { 0x011d, 0x011c, 'g' },
+    /* U+011E */ { 0x011f, 0x011e, 'g' },
+    /* U+011F */ { 0x011f, 0x011e, 'g' },
+    /* U+0120 */ { 0x0121, 0x0120, 'g' },
+    /* U+0121 */ { 0x0121, 0x0120, 'g' },
+    /* U+0122 */ { 0x0123, 0x0122, 'g' },
+    /* U+0123 */ { 0x0123, 0x0122, 'g' },
+    /* U+0124 */ { 0x0125, 0x0124, 'h' },
+    /* U+0125 */ { 0x0125, 0x0124, 'h' },
+    /* U+0126 */ { 0x0127, 0x0126, 'h' },
+    /* U+0127 */ { 0x0127, 0x0126, 'h' },
+    /* U+0128 */ { 0x0129, 0x0128, 'i' },
+    /* U+0129 */ { 0x0129, 0x0128, 'i' },
+    /* U+012A */ { 0x012b, 0x012a, 'i' },
+    /* U+012B */ { 0x012b, 0x012a, 'i' },
+    /* U+012C */ { 0x012d, 0x012c, 'i' },
+    /* U+012D */ { 0x012d, 0x012c, 'i' },
+    /* U+012E */ { 0x012f, 0x012e, 'i' },
+    /* U+012F */ { 0x012f, 0x012e, 'i' },
+    /* U+0130 */ { 0x0130, 0x0130, 'i' },
+    /* U+0131 */ { 0x0131, 0x0049, 'i' },
+    /* U+0132 */ { 0x0133, 0x0132, 0   },
+    /* U+0133 */ { 0x0133, 0x0132, 0   },
+    /* U+0134 */ { 0x0135, 0x0134, 'j' },
+    /* U+0135 */ { 0x0135, 0x0134, 'j' },
+    /* U+0136 */ { 0x0137, 0x0136, 'k' },
+    /* U+0137 */ { 0x0137, 0x0136, 'k' },
+    /* U+0138 */ { 0x0138, 0x0138, 0   },
+    /* U+0139 */ { 0x013a, 0x0139, 'l' },
+    /* U+013A */ { 0x013a, 0x0139, 'l' },
+    /* U+013B */ { 0x013c, 0x013b, 'l' },
+    /* U+013C */ { 0x013c, 0x013b, 'l' },
+    /* U+013D */ { 0x013e, 0x013d, 'l' },
+    /* U+013E */ { 0x013e, 0x013d, 'l' },
+    /* U+013F */ { 0x0140, 0x013f, 0   },
+    /* U+0140 */ { 0x0140, 0x013f, 0   },
+    /* U+0141 */ { 0x0142, 0x0141, 'l' },
+    /* U+0142 */ { 0x0142, 0x0141, 'l' },
+    /* U+0143 */ { 0x0144, 0x0143, 'n' },
+    /* U+0144 */ { 0x0144, 0x0143, 'n' },
+    /* U+0145 */ { 0x0146, 0x0145, 'n' },
+    /* U+0146 */ { 0x0146, 0x0145, 'n' },
+    /* U+0147 */ { 0x0148, 0x0147, 'n' },
+    /* U+0148 */ { 0x0148, 0x0147, 'n' },
+    /* U+0149 */ { 0x0149, 0x0149, 0   },
+    /* U+014A */ { 0x014b, 0x014a, 0   },
+    /* U+014B */ { 0x014b, 0x014a, 0   },
+    /* U+014C */ { 0x014d, 0x014c, 'o' },
+    /* U+014D */ { 0x014d, 0x014c, 'o' },
+    /* U+014E */ { 0x014f, 0x014e, 'o' },
+    /* U+014F */ { 0x014f, 0x014e, 'o' },
+    /* U+0150 */ { 0x0151, 0x0150, 'o' },
+    /* U+0151 */ { 0x0151, 0x0150, 'o' },
+    /* U+0152 */ { 0x0153, 0x0152, 0   },
+    /* U+0153 */ { 0x0153, 0x0152, 0   },
+    /* U+0154 */ { 0x0155, 0x0154, 'r' },
+    /* U+0155 */ { 0x0155, 0x0154, 'r' },
+    /* U+0156 */ { 0x0157, 0x0156, 'r' },
+    /* U+0157 */ { 0x0157, 0x0156, 'r' },
+    /* U+0158 */ { 0x0159, 0x0158, 'r' },
+    /* U+0159 */ { 0x0159, 0x0158, 'r' },
+    /* U+015A */ { 0x015b, 0x015a, 's' },
+    /* U+015B */ { 0x015b, 0x015a, 's' },
+    /* U+015C */ { 0x015d, 0x015c, 's' },
+    /* U+015D */ { 0x015d, 0x015c, 's' },
+    /* U+015E */ { 0x015f, 0x015e, 's' },
+    /* U+015F */ { 0x015f, 0x015e, 's' },
+    /* U+0160 */ { 0x0161, 0x0160, 's' },
+    /* U+0161 */ { 0x0161, 0x0160, 's' },
+    /* U+0162 */ { 0x0163, 0x0162, 't' },
+    /* U+0163 */ { 0x0163, 0x0162, 't' },
+    /* U+0164 */ { 0x0165, 0x0164, 't' },
+    /* U+0165 */ { 0x0165, 0x0164, 't' },
+    /* U+0166 */ { 0x0167, 0x0166, 't' },
+    /* U+0167 */ { 0x0167, 0x0166, 't' },
+    /* U+0168 */ { 0x0169, 0x0168, 'u' },
+    /* U+0169 */ { 0x0169, 0x0168, 'u' },
+    /* U+016A */ { 0x016b, 0x016a, 'u' },
+    /* U+016B */ { 0x016b, 0x016a, 'u' },
+    /* U+016C */ { 0x016d, 0x016c, 'u' },
+    /* U+016D */ { 0x016d, 0x016c, 'u' },
+    /* U+016E */ { 0x016f, 0x016e, 'u' },
+    /* U+016F */ { 0x016f, 0x016e, 'u' },
+    /* U+0170 */ { 0x0171, 0x0170, 'u' },
+    /* U+0171 */ { 0x0171, 0x0170, 'u' },
+    /* U+0172 */ { 0x0173, 0x0172, 'u' },
+    /* U+0173 */ { 0x0173, 0x0172, 'u' },
+    /* U+0174 */ { 0x0175, 0x0174, 'w' },
+    /* U+0175 */ { 0x0175, 0x0174, 'w' },
+    /* U+0176 */ { 0x0177, 0x0176, 'y' },
+    /* U+0177 */ { 0x0177, 0x0176, 'y' },
+    /* U+0178 */ { 0x00ff, 0x0178, 'y' },
+    /* U+0179 */ { 0x017a, 0x0179, 'z' },
+    /* U+017A */ { 0x017a, 0x0179, 'z' },
+    /* U+017B */ { 0x017c, 0x017b, 'z' },
+    /* U+017C */ { 0x017c, 0x017b, 'z' },
+    /* U+017D */ { 0x017e, 0x017d, 'z' },
+    /* U+017E */ { 0x017e, 0x017d, 'z' },
+    /* U+017F */ { 0x017f, 0x0053, 's' }
+};
+
+/**
+ * @brief decode one code point, checking that it's well-formed UTF-8 as it goes
+ *        (no overlong encodings, surrogates, or values past U+10FFFF)
+ * @param s     null-terminated, which ends a truncated sequence
+ * @param codePoint
+ * @return the number of bytes consumed, or 0 if s doesn't start with a well-formed sequence
+ */
+unsigned int utf8DecodeChecked( const char * s, tCodePoint * codePoint )
+{
+    const unsigned char * p = (const unsigned char *)s;
+
+    if ( p[0] < 0x80 )
+    {
+        *codePoint = p[0];
+        return 1;
+    }
+
+    unsigned int  count;
+    unsigned char lower = 0x80;
+    unsigned char upper = 0xBF;
+    switch ( p[0] )
+    {
+    case 0xC2 ... 0xDF: count = 1;                 break;
+    case 0xE0:          count = 2; lower = 0xA0;   break;
+    case 0xED:          count = 2; upper = 0x9F;   break;
+    case 0xE1 ... 0xEC:
+    case 0xEE ... 0xEF: count = 2;                 break;
+    case 0xF0:          count = 3; lower = 0x90;   break;
+    case 0xF1 ... 0xF3: count = 3;                 break;
+    case 0xF4:          count = 3; upper = 0x8F;   break;
+    default:
+        return 0;
+    }
+
+    /* only the first continuation byte has a restricted range. The terminating
+     * null isn't a continuation byte, so these never read past the end */
+    if ( p[1] < lower || p[1] > upper )
+    {
+        return 0;
+    }
+    for ( unsigned int i = 2; i <= count; ++i )
+    {
+        if ( (p[ i ] & 0xC0) != 0x80 )
+        {
+            return 0;
+        }
+    }
+    return utf8Decode( s, codePoint );
+}
+
+/**
+ * @brief decode one code point from a string already known to be well-formed
+ * @param s
+ * @param codePoint
+ * @return the number of bytes consumed
+ */
+unsigned int utf8Decode( const char * s, tCodePoint * codePoint )
+{
+    const unsigned char * p = (const unsigned char *)s;
+
+    if ( p[0] < 0x80 )
+    {
+        *codePoint = p[0];
+        return 1;
+    }
+    if ( p[0] < 0xE0 )
+    {
+        *codePoint = ((p[0] & 0x1F) << 6) | (p[1] & 0x3F);
+        return 2;
+    }
+    if ( p[0] < 0xF0 )
+    {
+        *codePoint = ((p[0] & 0x0F) << 12) | ((p[1] & 0x3F) << 6) | (p[2] & 0x3F);
+        return 3;
+    }
+    *codePoint = ((p[0] & 0x07) << 18) | ((p[1] & 0x3F) << 12) | ((p[2] & 0x3F) << 6) | (p[3] & 0x3F);
+    return 4;
+}
+
+/**
+ * @brief
+ * @param codePoint
+ * @param d  must have room for four bytes
+ * @return the number of bytes written
+ */
+unsigned int utf8Encode( tCodePoint codePoint, char * d )
+{
+    if ( codePoint < 0x80 )
+    {
+        d[0] = (char)codePoint;
+        return 1;
+    }
+    if ( codePoint < 0x800 )
+    {
+        d[0] = (char)(0xC0 | (codePoint >> 6));
+        d[1] = (char)(0x80 | (codePoint & 0x3F));
+        return 2;
+    }
+    if ( codePoint < 0x10000 )
+    {
+        d[0] = (char)(0xE0 | (codePoint >> 12));
+        d[1] = (char)(0x80 | ((codePoint >> 6) & 0x3F));
+        d[2] = (char)(0x80 | (codePoint & 0x3F));
+        return 3;
+    }
+    d[0] = (char)(0xF0 | (codePoint >> 18));
+    d[1] = (char)(0x80 | ((codePoint >> 12) & 0x3F));
+    d[2] = (char)(0x80 | ((codePoint >> 6) & 0x3F));
+    d[3] = (char)(0x80 | (codePoint & 0x3F));
+    return 4;
+}
+
+/**
+ * @brief
+ * @param codePoint
+ * @return
+ */
+tCodePoint utf8ToLower( tCodePoint codePoint )
+{
+    if ( codePoint < 0x80 )
+    {
+        return ( codePoint >= 'A' && codePoint <= 'Z' ) ? codePoint + ('a' - 'A') : codePoint;
+    }
+    if ( codePoint >= kLatinFirst && codePoint <= kLatinLast )
+    {
+        return latinMap[ codePoint - kLatinFirst ].lower;
+    }
+    /* Greek */
+    if ( (codePoint >= 0x0391 && codePoint <= 0x03A1) || (codePoint >= 0x03A3 && codePoint <= 0x03AB) )
+    {
+        return codePoint + 0x20;
+    }
+    /* Cyrillic */
+    if ( codePoint >= 0x0400 && codePoint <= 0x040F )
+    {
+        return codePoint + 0x50;
+    }
+    if ( codePoint >= 0x0410 && codePoint <= 0x042F )
+    {
+        return codePoint + 0x20;
+    }
+    return codePoint;
+}
+
+/**
+ * @brief
+ * @param codePoint
+ * @return
+ */
+tCodePoint utf8ToUpper( tCodePoint codePoint )
+{
+    if ( codePoint < 0x80 )
+    {
+        return ( codePoint >= 'a' && codePoint <= 'z' ) ? codePoint - ('a' - 'A') : codePoint;
+    }
+    if ( codePoint >= kLatinFirst && codePoint <= kLatinLast )
+    {
+        return latinMap[ codePoint - kLatinFirst ].upper;
+    }
+    /* Greek (leaving the final sigma alone) */
+    if ( (codePoint >= 0x03B1 && codePoint <= 0x03C1) || (codePoint >= 0x03C3 && codePoint <= 0x03CB) )
+    {
+        return codePoint - 0x20;
+    }
+    /* Cyrillic */
+    if ( codePoint >= 0x0430 && codePoint <= 0x044F )
+    {
+        return codePoint - 0x20;
+    }
+    if ( codePoint >= 0x0450 && codePoint <= 0x045F )
+    {
+        return codePoint - 0x50;
+    }
+    return codePoint;
+}
+
+/**
+ * @brief strip any diacritics from a latin letter
+ * @param codePoint
+ * @return the lower-case ASCII letter, or '\0' if it isn't a latin letter
+ */
+char utf8BaseLetter( tCodePoint codePoint )
+{
+    if ( codePoint < 0x80 )
+    {
+        return asciiIsAlpha( (char)codePoint ) ? (char)utf8ToLower( codePoint ) : '\0';
+    }
+    if ( codePoint >= kLatinFirst && codePoint <= kLatinLast )
+    {
+        return latinMap[ codePoint - kLatinFirst ].base;
+    }
+    return '\0';
+}
+
+/**
+ * @brief
+ * @param codePoint
+ * @return true if the code point is a letter in one of the scripts we expect in channel names
+ */
+bool utf8IsAlpha( tCodePoint codePoint )
+{
+    if ( codePoint < 0x80 )
+    {
+        return asciiIsAlpha( (char)codePoint );
+    }
+    return ( codePoint >= kLatinFirst && codePoint <= kLatinLast && codePoint != 0x00D7 && codePoint != 0x00F7 )
+        || ( codePoint >= 0x0370 && codePoint <= 0x03FF )   /* Greek */
+        || ( codePoint >= 0x0400 && codePoint <= 0x04FF )   /* Cyrillic */
+        || ( codePoint >= 0x05D0 && codePoint <= 0x05EA )   /* Hebrew */
+        || ( codePoint >= 0x0620 && codePoint <= 0x064A )   /* Arabic */
+        || ( codePoint >= 0x0900 && codePoint <= 0x097F )   /* Devanagari */
+        || ( codePoint >= 0x4E00 && codePoint <= 0x9FFF );  /* CJK Unified Ideographs */
+}
@@ -0,0 +1,93 @@
+//
+// Created by paul on 10/19/26.
+//
+
+#ifndef MUNGEM3U_UTF8_H
+#define MUNGEM3U_UTF8_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+typedef unsigned int tCodePoint;
+
+unsigned int utf8DecodeChecked( const char * s, tCodePoint * codePoint );
+unsigned int utf8Decode( const char * s, tCodePoint * codePoint );
+unsigned int utf8Encode( tCodePoint codePoint, char * d );
+
+tCodePoint utf8ToLower( tCodePoint codePoint );
+tCodePoint utf8ToUpper( tCodePoint codePoint );
+char utf8BaseLetter( tCodePoint codePoint );
+bool utf8IsAlpha( tCodePoint codePoint );
+
+/* locale-independent equivalents of toupper() & isalpha() for the ASCII range */
+static inline char asciiToUpper( char c )
+{
+    return ( c >= 'a' && c <= 'z' ) ? (char)(c - 'a' + 'A') : c;
+}
+
+static inline bool asciiIsAlpha( char c )
+{
+    return ( c >= 'a' && c <= 'z' ) || ( c >= 'A' && c <= 'Z' );
+}
+
+/**
+ * @brief check whether a string is all ASCII, i.e. has no multi-byte sequences,
+ *        a vector at a time. The tail is checked with a load that overlaps the
+ *        last whole vector, rather than a byte at a time, so a short name
+ *        costs a load or two and no loop to mispredict
+ * @param s
+ * @param len
+ * @return
+ */
+static inline bool utf8IsAscii( const char * s, size_t len )
+{
+    const unsigned char * p = (const unsigned char *)s;
+
+#ifdef __SSE2__
+    if ( len >= 16 )
+    {
+        __m128i any = _mm_loadu_si128( (const __m128i *)( p + len - 16 ) );
+        for ( size_t i = 0; i + 16 < len; i += 16 )
+        {
+            any = _mm_or_si128( any, _mm_loadu_si128( (const __m128i *)( p + i ) ) );
+        }
+        return _mm_movemask_epi8( any ) == 0;
+    }
+#endif
+
+    uint64_t any = 0;
+    if ( len >= 8 )
+    {
+        uint64_t word;
+        for ( size_t i = 0; i + 8 < len; i += 8 )
+        {
+            memcpy( &word, p + i, 8 );
+            any |= word;
+        }
+        memcpy( &word, p + len - 8, 8 );
+        any |= word;
+    }
+    else if ( len >= 4 )
+    {
+        uint32_t head, tail;
+        memcpy( &head, p, 4 );
+        memcpy( &tail, p + len - 4, 4 );
+        any = head | tail;
+    }
+    else
+    {
+        for ( size_t i = 0; i < len; ++i )
+        {
+            any |= p[ i ];
+        }
+    }
+    return ( any & 0x8080808080808080ULL ) == 0;
+}
+
+#endif //MUNGEM3U_UTF8_H
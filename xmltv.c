@@ -0,0 +1,785 @@
+//
+// Created by paul on 10/19/26.
+//
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "fingerprint.h"
+#include "utf8.h"
+#include "xmltv.h"
+
+/* release the pages behind the scan every time it advances this far */
+#define kXMLTVWindow    (64UL * 1024 * 1024)
+/* ids are decoded into a buffer on the stack, so longer ones are ignored */
+#define kXMLTVMaxId     256
+
+typedef enum {
+    kElementOther,
+    kElementChannel,
+    kElementProgramme
+} tElementKind;
+
+typedef struct {
+    tElementKind   kind;
+    const char *   start;       /* the '<' of the start tag */
+    const char *   end;         /* just past the end tag */
+    bool           truncated;   /* the guide ends before the end tag */
+    const char *   id;          /* the value of the id or channel attribute, still escaped */
+    size_t         idLength;
+} tElement;
+
+typedef struct {
+    const char *   id;          /* points into the mapped file, still escaped */
+    uint32_t       idLength;
+    uint32_t       programmes;
+    uint64_t       hash;        /* of the unescaped id */
+    size_t         channelStart;    /* byte range of the first <channel> element */
+    size_t         channelEnd;      /* zero if the guide doesn't have one */
+    uint64_t       programmeBytes;
+    bool           selected;
+} tGuideChannel;
+
+struct sXMLTV {
+    const char *    data;
+    size_t          size;
+
+    tGuideChannel * channel;
+    size_t          count;
+    size_t          capacity;
+
+    uint32_t *      slot;       /* 1 + the channel number, or 0 if empty */
+    size_t          mask;       /* slot count is always a power of two */
+
+    uint64_t        programmes;
+    uint64_t        orphans;    /* programmes without a channel id */
+};
+
+/**
+ * @brief
+ * @return
+ */
+tXMLTV * xmltvNew( void )
+{
+    return calloc( 1, sizeof( tXMLTV ) );
+}
+
+/**
+ * @brief
+ * @param xmltv
+ */
+void xmltvFree( tXMLTV * xmltv )
+{
+    if ( xmltv != NULL )
+    {
+        if ( xmltv->data != NULL )
+        {
+            munmap( (void *)xmltv->data, xmltv->size );
+        }
+        free( xmltv->channel );
+        free( xmltv->slot );
+        free( xmltv );
+    }
+}
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+static inline bool isSpace( char c )
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+/**
+ * @brief parse a numeric character reference, '&#NNN;' or '&#xHH;', from just past the '#'
+ * @return the length parsed, up to and including the ';', or 0 if it isn't a valid one
+ */
+static size_t characterReference( const char * p, const char * end, tCodePoint * codePoint )
+{
+    const char * start = p;
+    unsigned int base  = 10;
+    tCodePoint   code  = 0;
+
+    if ( p < end && ( *p == 'x' || *p == 'X' ) )
+    {
+        base = 16;
+        ++p;
+    }
+    const char * digits = p;
+    for ( ; p < end && *p != ';'; ++p )
+    {
+        unsigned int digit;
+        char         c = *p;
+
+        if ( c >= '0' && c <= '9' )                        digit = c - '0';
+        else if ( base == 16 && c >= 'a' && c <= 'f' )     digit = c - 'a' + 10;
+        else if ( base == 16 && c >= 'A' && c <= 'F' )     digit = c - 'A' + 10;
+        else return 0;
+
+        code = code * base + digit;
+        if ( code > 0x10FFFF )
+        {
+            return 0;
+        }
+    }
+    /* the null character and the UTF-16 surrogates aren't characters XML allows */
+    if ( p == end || p == digits || code == 0 || ( code >= 0xD800 && code <= 0xDFFF ) )
+    {
+        return 0;
+    }
+    *codePoint = code;
+    return p + 1 - start;
+}
+
+/**
+ * @brief replace the predefined XML entities and numeric character references,
+ *        so ids compare the same as the tvg-id they came from
+ * @return the length of the unescaped id, or 0 if it is empty or too long
+ */
+static size_t unescapeId( const char * id, size_t length, char buffer[ kXMLTVMaxId ] )
+{
+    static const struct { const char * entity; size_t length; char c; } entities[] =
+    {
+        { "&amp;",  5, '&'  },
+        { "&lt;",   4, '<'  },
+        { "&gt;",   4, '>'  },
+        { "&quot;", 6, '"'  },
+        { "&apos;", 6, '\'' }
+    };
+    const char * end = id + length;
+    size_t       len = 0;
+
+    while ( id < end && len < kXMLTVMaxId )
+    {
+        char c = *id++;
+        if ( c == '&' && id < end && *id == '#' )
+        {
+            tCodePoint codePoint;
+            size_t     n = characterReference( id + 1, end, &codePoint );
+            if ( n != 0 )
+            {
+                char utf8[ 4 ];
+                unsigned int bytes = utf8Encode( codePoint, utf8 );
+                if ( len + bytes > kXMLTVMaxId )
+                {
+                    return 0;
+                }
+                memcpy( &buffer[ len ], utf8, bytes );
+                len += bytes;
+                id  += 1 + n;
+                continue;
+            }
+        }
+        else if ( c == '&' )
+        {
+            for ( unsigned int i = 0; i < sizeof( entities ) / sizeof( entities[0] ); ++i )
+            {
+                size_t n = entities[ i ].length - 1;
+                if ( (size_t)(end - id) >= n && memcmp( id, entities[ i ].entity + 1, n ) == 0 )
+                {
+                    c   = entities[ i ].c;
+                    id += n;
+                    break;
+                }
+            }
+        }
+        buffer[ len++ ] = c;
+    }
+    return id == end ? len : 0;
+}
+
+/**
+ * @brief find the closing '>' of a tag, skipping over any quoted attribute values
+ * @return the '>', or NULL if the tag isn't closed
+ */
+static const char * tagEnd( const char * p, const char * end )
+{
+    while ( p < end )
+    {
+        char c = *p;
+        if ( c == '>' )
+        {
+            return p;
+        }
+        if ( c == '"' || c == '\'' )
+        {
+            p = memchr( p + 1, c, end - (p + 1) );
+            if ( p == NULL )
+            {
+                return NULL;
+            }
+        }
+        ++p;
+    }
+    return NULL;
+}
+
+/**
+ * @brief find the value of an attribute in a start tag
+ * @return false if the tag doesn't have the attribute
+ */
+static bool findAttribute( const char * tag, const char * end, const char * name, size_t nameLength,
+                           const char ** value, size_t * valueLength )
+{
+    const char * p = tag;
+
+    while ( p < end )
+    {
+        /* skip to the start of the next attribute */
+        while ( p < end && ! isSpace( *p ) )
+        {
+            if ( *p == '"' || *p == '\'' )
+            {
+                const char * q = memchr( p + 1, *p, end - (p + 1) );
+                p = q != NULL ? q : end;
+            }
+            ++p;
+        }
+        while ( p < end && isSpace( *p ) ) { ++p; }
+
+        const char * attr = p;
+        while ( p < end && *p != '=' && ! isSpace( *p ) ) { ++p; }
+        bool match = (size_t)(p - attr) == nameLength && memcmp( attr, name, nameLength ) == 0;
+
+        while ( p < end && isSpace( *p ) ) { ++p; }
+        if ( p >= end || *p != '=' )
+        {
+            continue;
+        }
+        ++p;
+        while ( p < end && isSpace( *p ) ) { ++p; }
+        if ( p >= end || ( *p != '"' && *p != '\'' ) )
+        {
+            continue;
+        }
+        const char * q = memchr( p + 1, *p, end - (p + 1) );
+        if ( q == NULL )
+        {
+            return false;
+        }
+        if ( match )
+        {
+            *value       = p + 1;
+            *valueLength = q - (p + 1);
+            return true;
+        }
+        p = q + 1;
+    }
+    return false;
+}
+
+static inline bool isElement( const char * p, const char * end, const char * name, size_t length )
+{
+    return (size_t)(end - p) > length && memcmp( p, name, length ) == 0
+        && ( isSpace( p[ length ] ) || p[ length ] == '>' || p[ length ] == '/' );
+}
+
+/**
+ * @brief parse the element starting at p, which must point at a '<'
+ * @return the position to continue scanning from
+ */
+static const char * nextElement( const char * p, const char * end, tElement * element )
+{
+    element->kind      = kElementOther;
+    element->start     = p;
+    element->id        = NULL;
+    element->truncated = false;
+
+    const char * name = p + 1;
+
+    if ( (size_t)(end - name) >= 3 && memcmp( name, "!--", 3 ) == 0 )
+    {
+        const char * close = memmem( name + 3, end - (name + 3), "-->", 3 );
+        element->end = close != NULL ? close + 3 : end;
+        return element->end;
+    }
+
+    const char * gt = tagEnd( name, end );
+    if ( gt == NULL )
+    {
+        element->end = end;
+        return end;
+    }
+    element->end = gt + 1;
+
+    const char * closeTag;
+    size_t       closeLength;
+    const char * attr;
+    size_t       attrLength;
+
+    if ( isElement( name, end, "channel", 7 ) )
+    {
+        element->kind = kElementChannel;
+        closeTag = "</channel>";   closeLength = 10;
+        attr     = "id";           attrLength  = 2;
+    }
+    else if ( isElement( name, end, "programme", 9 ) )
+    {
+        element->kind = kElementProgramme;
+        closeTag = "</programme>"; closeLength = 12;
+        attr     = "channel";      attrLength  = 7;
+    }
+    else
+    {
+        /* <?xml>, <!DOCTYPE>, <tv> and anything we don't care about: step inside */
+        return element->end;
+    }
+
+    findAttribute( name, gt, attr, attrLength, &element->id, &element->idLength );
+
+    /* jump over the content to the end tag, unless the element is empty */
+    if ( gt[ -1 ] != '/' )
+    {
+        const char * close = memmem( gt + 1, end - (gt + 1), closeTag, closeLength );
+        element->end       = close != NULL ? close + closeLength : end;
+        element->truncated = ( close == NULL );
+    }
+    return element->end;
+}
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+static bool growSlots( tXMLTV * xmltv )
+{
+    size_t     mask = xmltv->mask ? xmltv->mask * 2 + 1 : 1023;
+    uint32_t * slot = calloc( mask + 1, sizeof( uint32_t ) );
+
+    if ( slot == NULL )
+    {
+        return false;
+    }
+    for ( size_t i = 0; i <= xmltv->mask && xmltv->slot != NULL; ++i )
+    {
+        if ( xmltv->slot[ i ] != 0 )
+        {
+            size_t s = xmltv->channel[ xmltv->slot[ i ] - 1 ].hash & mask;
+            while ( slot[ s ] != 0 )
+            {
+                s = (s + 1) & mask;
+            }
+            slot[ s ] = xmltv->slot[ i ];
+        }
+    }
+    free( xmltv->slot );
+    xmltv->slot = slot;
+    xmltv->mask = mask;
+
+    return true;
+}
+
+/* id must already be unescaped */
+static uint32_t * findSlot( tXMLTV * xmltv, const char * id, size_t length, uint64_t hash )
+{
+    size_t s = hash & xmltv->mask;
+
+    while ( xmltv->slot[ s ] != 0 )
+    {
+        const tGuideChannel * channel = &xmltv->channel[ xmltv->slot[ s ] - 1 ];
+        if ( channel->hash == hash )
+        {
+            char   buffer[ kXMLTVMaxId ];
+            size_t len = unescapeId( channel->id, channel->idLength, buffer );
+            if ( len == length && memcmp( buffer, id, length ) == 0 )
+            {
+                break;
+            }
+        }
+        s = (s + 1) & xmltv->mask;
+    }
+    return &xmltv->slot[ s ];
+}
+
+/**
+ * @brief find the guide channel for an escaped id, adding it if it's new
+ * @return NULL if the id is unusable, or if out of memory
+ */
+static tGuideChannel * guideChannel( tXMLTV * xmltv, const char * id, size_t idLength, bool * oom )
+{
+    char   buffer[ kXMLTVMaxId ];
+    size_t length = unescapeId( id, idLength, buffer );
+
+    if ( length == 0 )
+    {
+        return NULL;
+    }
+
+    /* keep the table no more than half full */
+    if ( 2 * (xmltv->count + 1) > xmltv->mask && ! growSlots( xmltv ) )
+    {
+        *oom = true;
+        return NULL;
+    }
+
+    uint64_t   hash = fingerprint( buffer, length, 0 );
+    uint32_t * slot = findSlot( xmltv, buffer, length, hash );
+
+    if ( *slot == 0 )
+    {
+        if ( xmltv->count == xmltv->capacity )
+        {
+            size_t          capacity = xmltv->capacity ? xmltv->capacity * 2 : 1024;
+            tGuideChannel * channel  = realloc( xmltv->channel, capacity * sizeof( tGuideChannel ) );
+            if ( channel == NULL )
+            {
+                *oom = true;
+                return NULL;
+            }
+            xmltv->channel  = channel;
+            xmltv->capacity = capacity;
+        }
+        tGuideChannel * channel = &xmltv->channel[ xmltv->count++ ];
+        memset( channel, 0, sizeof( tGuideChannel ) );
+        channel->id       = id;
+        channel->idLength = (uint32_t)idLength;
+        channel->hash     = hash;
+        *slot = (uint32_t)xmltv->count;
+    }
+    return &xmltv->channel[ *slot - 1 ];
+}
+
+typedef bool (*tElementVisitor)( tXMLTV * xmltv, const tElement * element, void * udata );
+
+/**
+ * @brief visit each top-level element of the mapped guide, in order
+ * @return false if the visitor stopped the scan
+ */
+static bool scanElements( tXMLTV * xmltv, tElementVisitor visitor, void * udata )
+{
+    const char * end     = xmltv->data + xmltv->size;
+    const char * p       = xmltv->data;
+    const char * release = xmltv->data;
+
+    while ( (p = memchr( p, '<', end - p )) != NULL )
+    {
+        tElement element;
+        p = nextElement( p, end, &element );
+
+        if ( ! visitor( xmltv, &element, udata ) )
+        {
+            return false;
+        }
+
+        /* the scan never looks back, so don't let what it has passed stay resident */
+        if ( (size_t)(p - release) >= kXMLTVWindow )
+        {
+            size_t length = (size_t)(p - release) & ~(kXMLTVWindow - 1);
+            madvise( (void *)release, length, MADV_DONTNEED );
+            release += length;
+        }
+    }
+    return true;
+}
+
+static bool indexElement( tXMLTV * xmltv, const tElement * element, void * udata )
+{
+    bool *          oom     = udata;
+    tGuideChannel * channel = NULL;
+
+    if ( element->kind == kElementOther )
+    {
+        return true;
+    }
+    if ( element->id != NULL )
+    {
+        channel = guideChannel( xmltv, element->id, element->idLength, oom );
+    }
+
+    if ( element->kind == kElementChannel )
+    {
+        if ( channel != NULL && channel->channelEnd == 0 )
+        {
+            channel->channelStart = element->start - xmltv->data;
+            channel->channelEnd   = element->end   - xmltv->data;
+        }
+    }
+    else
+    {
+        xmltv->programmes++;
+        if ( channel != NULL )
+        {
+            channel->programmes++;
+            channel->programmeBytes += element->end - element->start;
+        }
+        else
+        {
+            xmltv->orphans++;
+        }
+    }
+    return ! *oom;
+}
+
+/**
+ * @brief map an XMLTV file into memory, and index its channels and programmes in a single pass
+ * @param xmltv
+ * @param path
+ * @return 0, or a negative errno
+ */
+int xmltvLoad( tXMLTV * xmltv, const char * path )
+{
+    int         result = 0;
+    struct stat st;
+
+    int fd = open( path, O_RDONLY );
+    if ( fd < 0 || fstat( fd, &st ) != 0 )
+    {
+        result = -errno;
+        fprintf( stderr, "### unable to open \'%s\' (%d: %s)\n", path, errno, strerror(errno) );
+        if ( fd >= 0 ) close( fd );
+        return result;
+    }
+    if ( xmltv->data != NULL || st.st_size == 0 )
+    {
+        close( fd );
+        return 0;
+    }
+
+    const char * data = mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    close( fd );
+    if ( data == MAP_FAILED )
+    {
+        result = -errno;
+        fprintf( stderr, "### unable to map \'%s\' (%d: %s)\n", path, errno, strerror(errno) );
+        return result;
+    }
+    madvise( (void *)data, st.st_size, MADV_SEQUENTIAL );
+    xmltv->data = data;
+    xmltv->size = st.st_size;
+
+    bool oom = false;
+    if ( ! scanElements( xmltv, indexElement, &oom ) )
+    {
+        fprintf( stderr, "### out of memory loading \'%s\'\n", path );
+        result = -ENOMEM;
+    }
+    return result;
+}
+
+/**
+ * @brief mark the guide channel with the given id as one that's being kept
+ * @param xmltv     may be NULL
+ * @param id        the tvg-id of a channel
+ * @param length
+ * @return the number of programmes for the channel, or -1 if the guide doesn't have it
+ */
+long xmltvSelect( tXMLTV * xmltv, const char * id, size_t length )
+{
+    if ( xmltv == NULL || xmltv->slot == NULL || length == 0 || length > kXMLTVMaxId )
+    {
+        return -1;
+    }
+
+    uint32_t * slot = findSlot( xmltv, id, length, fingerprint( id, length, 0 ) );
+    if ( *slot == 0 )
+    {
+        return -1;
+    }
+    tGuideChannel * channel = &xmltv->channel[ *slot - 1 ];
+    channel->selected = true;
+    return channel->programmes;
+}
+
+typedef struct {
+    FILE *         output;
+    const char *   prevEnd;     /* end of the previous element, kept or not */
+    bool           prolog;      /* seen the <tv> start tag */
+    bool           closed;      /* written the </tv> end tag */
+    uint64_t       written;
+    uint64_t       channels;
+    uint64_t       programmes;
+} tGuideExport;
+
+static bool isBlank( const char * p, const char * end )
+{
+    while ( p < end && isSpace( *p ) ) { ++p; }
+    return p == end;
+}
+
+/* copy an element straight from the mapped guide, with the whitespace in front of it */
+static void copyElement( tGuideExport * trim, const tElement * element )
+{
+    const char * start = element->start;
+
+    if ( trim->prevEnd != NULL && isBlank( trim->prevEnd, start ) )
+    {
+        start = trim->prevEnd;
+    }
+    else
+    {
+        fputc( '\n', trim->output );
+        trim->written++;
+    }
+    fwrite( start, 1, element->end - start, trim->output );
+    trim->written += element->end - start;
+}
+
+static bool exportElement( tXMLTV * xmltv, const tElement * element, void * udata )
+{
+    tGuideExport * trim = udata;
+    bool           keep   = false;
+
+    if ( element->kind == kElementOther )
+    {
+        const char * name = element->start + 1;
+        const char * end  = xmltv->data + xmltv->size;
+
+        if ( ! trim->prolog && isElement( name, end, "tv", 2 ) )
+        {
+            /* everything up to and including <tv>: the xml declaration, doctype, comments... */
+            fwrite( xmltv->data, 1, element->end - xmltv->data, trim->output );
+            trim->written += element->end - xmltv->data;
+            trim->prolog   = true;
+        }
+        else if ( trim->prolog && name[ 0 ] == '/' && isElement( name + 1, end, "tv", 2 ) )
+        {
+            copyElement( trim, element );
+            fputc( '\n', trim->output );
+            trim->written++;
+            trim->closed = true;
+        }
+    }
+    else if ( trim->prolog && element->id != NULL )
+    {
+        char   buffer[ kXMLTVMaxId ];
+        size_t length = unescapeId( element->id, element->idLength, buffer );
+
+        if ( length != 0 )
+        {
+            uint32_t * slot = findSlot( xmltv, buffer, length, fingerprint( buffer, length, 0 ) );
+            if ( *slot != 0 )
+            {
+                const tGuideChannel * channel = &xmltv->channel[ *slot - 1 ];
+                if ( element->kind == kElementChannel )
+                {
+                    /* only the first <channel> element for an id */
+                    keep = channel->selected && channel->channelStart == (size_t)(element->start - xmltv->data);
+                    trim->channels += keep;
+                }
+                else
+                {
+                    keep = channel->selected;
+                    trim->programmes += keep;
+                }
+            }
+        }
+        /* copying half an element would leave the trimmed guide unreadable */
+        if ( keep && ! element->truncated )
+        {
+            copyElement( trim, element );
+        }
+    }
+    trim->prevEnd = element->end;
+
+    return ! ferror( trim->output );
+}
+
+/**
+ * @brief write a copy of the guide that only has the <channel> and <programme> elements
+ *        for the channels selected by xmltvSelect(). Elements are copied byte for byte
+ *        from the mapped guide, in the order they appear in it.
+ * @param xmltv
+ * @param path
+ * @param stats     report how much of the guide was kept
+ * @return 0, or a negative errno
+ */
+int xmltvExport( tXMLTV * xmltv, const char * path, bool stats )
+{
+    int          result = 0;
+    tGuideExport trim;
+
+    memset( &trim, 0, sizeof( trim ) );
+    trim.output = fopen( path, "w" );
+    if ( trim.output == NULL )
+    {
+        result = -errno;
+        fprintf( stderr, "### unable to open \'%s\' (%d: %s)\n", path, errno, strerror(errno) );
+        return result;
+    }
+    setvbuf( trim.output, NULL, _IOFBF, 1024 * 1024 );
+
+    if ( xmltv->data != NULL )
+    {
+        madvise( (void *)xmltv->data, xmltv->size, MADV_SEQUENTIAL );
+        scanElements( xmltv, exportElement, &trim );
+    }
+    /* a guide that was cut short, or had no <tv> element, still makes a well-formed one */
+    if ( ! trim.prolog )
+    {
+        static const char header[] = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<tv>\n";
+        fputs( header, trim.output );
+        trim.written += sizeof( header ) - 1;
+    }
+    if ( ! trim.closed )
+    {
+        fputs( "\n</tv>\n", trim.output );
+        trim.written += 7;
+    }
+    if ( ferror( trim.output ) )
+    {
+        /* errno isn't reliably set by a failed stdio write */
+        result = -EIO;
+        fprintf( stderr, "### unable to write \'%s\'\n", path );
+    }
+    if ( fclose( trim.output ) != 0 && result == 0 )
+    {
+        result = -errno;
+        fprintf( stderr, "### unable to write \'%s\' (%d: %s)\n", path, errno, strerror(errno) );
+    }
+
+    if ( stats )
+    {
+        fprintf( stderr, "xmltv: wrote %lu channels and %lu programmes to \'%s\', %lu of %zu bytes (%.1f%%)\n",
+                 (unsigned long)trim.channels, (unsigned long)trim.programmes, path,
+                 (unsigned long)trim.written, xmltv->size,
+                 xmltv->size > 0 ? 100.0 * trim.written / xmltv->size : 0.0 );
+    }
+    return result;
+}
+
+/**
+ * @brief
+ * @param xmltv
+ * @return the number of distinct channel ids in the guide
+ */
+size_t xmltvCount( tXMLTV * xmltv )
+{
+    return xmltv != NULL ? xmltv->count : 0;
+}
+
+/**
+ * @brief
+ * @param output
+ * @param xmltv
+ */
+void xmltvReport( FILE * output, tXMLTV * xmltv )
+{
+    size_t   selected   = 0;
+    size_t   declared   = 0;
+    uint64_t programmes = 0;
+
+    for ( size_t i = 0; i < xmltv->count; ++i )
+    {
+        const tGuideChannel * channel = &xmltv->channel[ i ];
+        if ( channel->channelEnd != 0 )
+        {
+            declared++;
+        }
+        if ( channel->selected )
+        {
+            selected++;
+            programmes += channel->programmes;
+        }
+    }
+
+    fprintf( output, "xmltv: %zu bytes, %zu channel ids (%zu with a <channel>), %lu programmes (%lu without a channel)\n",
+             xmltv->size, xmltv->count, declared,
+             (unsigned long)xmltv->programmes, (unsigned long)xmltv->orphans );
+    fprintf( output, "xmltv: %zu channels selected, with %lu programmes\n",
+             selected, (unsigned long)programmes );
+}
@@ -0,0 +1,38 @@
+//
+// Created by paul on 10/19/26.
+//
+
+#ifndef MUNGEM3U_XMLTV_H
+#define MUNGEM3U_XMLTV_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * A streaming XMLTV reader. The guide is mmap'd and scanned once, front to
+ * back, without building a DOM: only the start tags of the top-level
+ * <channel> and <programme> elements are parsed, and everything between a
+ * start tag and its end tag is skipped over. Each channel id is indexed
+ * with the byte range of its <channel> element, and the number of
+ * programmes that refer to it. Memory is proportional to the number of
+ * channels in the guide, not its size, and pages that have already been
+ * scanned are released as the scan moves on.
+ *
+ * Once the channels being kept are selected, a trimmed guide can be written
+ * by a second pass that copies just their elements from the mapped file.
+ */
+
+typedef struct sXMLTV tXMLTV;
+
+tXMLTV * xmltvNew( void );
+void xmltvFree( tXMLTV * xmltv );
+
+int xmltvLoad( tXMLTV * xmltv, const char * path );
+long xmltvSelect( tXMLTV * xmltv, const char * id, size_t length );
+int xmltvExport( tXMLTV * xmltv, const char * path, bool stats );
+size_t xmltvCount( tXMLTV * xmltv );
+
+void xmltvReport( FILE * output, tXMLTV * xmltv );
+
+#endif //MUNGEM3U_XMLTV_H